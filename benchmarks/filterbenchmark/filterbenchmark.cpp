@@ -0,0 +1,235 @@
+/// Compares the filtering of the bookmark menu before the SIMD matcher, the loop
+/// formerly in FilterMenu::onFilterStringUpdated(), with Core::ItemFilter. Also
+/// measures filtering with the trigram index, fuzzy filtering, which runs in the
+/// threads of Utils::ThreadPool for many items, glob and regular expression
+/// filtering, how fast a filter run can be canceled and how long validating the
+/// paths of all items takes, as done for the bookmarks after loading.
+///
+/// Usage: filterbenchmark [item count, default 1000000]
+
+#include "core/itemfilter.h"
+#include "core/itemstore.h"
+#include "core/pathvalidator.h"
+
+#include "utils/substringfinder.h"
+#include "utils/threadpool.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <poll.h>
+
+using namespace Core;
+using Utils::StringUtils::StringRef;
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+double millisecondsSince(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+void createItems(ItemStore &items, uint32_t count, const std::string &homePath)
+{
+    static const char *const words[] = {
+        "src", "build", "projects", "Documents", "music", "goto", "kernel", "notes",
+        "Photos", "work", "tmp", "usr", "share", "include", "lib", "config"
+    };
+    std::mt19937 generator(1);
+    for (uint32_t i = 0; i < count; ++i) {
+        std::string identifier = words[generator() % 16] + std::to_string(i);
+        std::string path = generator() % 4 ? homePath : std::string("/opt");
+        for (unsigned depth = 2 + generator() % 4; depth; --depth)
+            path += std::string("/") + words[generator() % 16];
+        std::string pathDisplayed = path.compare(0, homePath.size(), homePath) == 0
+            ? '~' + path.substr(homePath.size()) : path;
+        items.append(StringRef(identifier.data(), identifier.size()),
+                     StringRef(path.data(), path.size()),
+                     StringRef(pathDisplayed.data(), pathDisplayed.size()));
+    }
+}
+
+/// The former loop: Strings are copied, the displayed path is created per item.
+std::size_t filterWithFind(const ItemStore &items, const std::string &filterInput)
+{
+    std::vector<uint32_t> rows;
+    for (uint32_t row = 0; row < items.size(); ++row) {
+        const std::string identifier = items.identifier(row).toString();
+        const std::string homePath = std::getenv("HOME");
+        std::string pathDisplayed = items.path(row).toString();
+        if (pathDisplayed.compare(0, homePath.size(), homePath) == 0)
+            pathDisplayed.replace(0, homePath.size(), "~");
+        const bool identifierMatches = identifier.find(filterInput) != std::string::npos;
+        const bool pathMatches = pathDisplayed.find(filterInput) != std::string::npos;
+        if (identifierMatches || pathMatches)
+            rows.push_back(row);
+    }
+    return rows.size();
+}
+
+} // anonymous
+
+int main(int argc, char *argv[])
+{
+    const uint32_t count = argc > 1 ? std::strtoul(argv[1], 0, 10) : 1000000;
+    const std::string homePath = std::getenv("HOME") ? std::getenv("HOME") : "/home/user";
+    setenv("HOME", homePath.c_str(), 1);
+
+    ItemStore items;
+    createItems(items, count, homePath);
+
+    std::cout << count << " items, matcher uses " << Utils::SubstringFinder::instructionSet()
+              << ", " << Utils::ThreadPool::globalInstance().threadCount() + 1 << " threads"
+              << std::endl;
+
+    // The haystack is built on first use.
+    Clock::time_point start = Clock::now();
+    ItemFilter filter(ItemFilter::CaseSensitive);
+    filter.reset(items);
+    filter.setFilterString("nomatch");
+    std::cout << "First filtering, building the haystack: " << millisecondsSince(start) << " ms"
+              << std::endl;
+    ItemFilter smartCaseFilter(ItemFilter::SmartCase);
+    smartCaseFilter.reset(items);
+    smartCaseFilter.setFilterString("nomatch");
+
+    // Most of the generated paths do not exist, like dead bookmarks.
+    start = Clock::now();
+    {
+        PathValidator validator;
+        validator.validate(0, items, 0, count);
+        uint32_t validatedCount = 0;
+        uint32_t missingCount = 0;
+        while (validatedCount < count) {
+            pollfd notification = { validator.notificationDescriptor(), POLLIN, 0 };
+            poll(&notification, 1, -1);
+            for (const PathValidator::Result &result : validator.takeResults()) {
+                validatedCount += result.infos.size();
+                missingCount += std::count_if(result.infos.begin(), result.infos.end(),
+                    [](const Utils::FileUtils::FileInfo &info) { return info.error == ENOENT; });
+            }
+        }
+        std::cout << "Validating the paths: " << millisecondsSince(start) << " ms, "
+                  << missingCount << " do not exist" << std::endl;
+    }
+
+    const char *const needles[] = { "o", "src", "kernel9", "Documents/goto", "nomatch" };
+    std::cout << std::left << std::setw(16) << "Filter" << std::setw(10) << "Matches"
+              << std::setw(14) << "find() ms" << std::setw(14) << "Scan ms"
+              << std::setw(14) << "Smart case ms" << std::endl;
+    for (const char *needle : needles) {
+        start = Clock::now();
+        const std::size_t expected = filterWithFind(items, needle);
+        const double findTime = millisecondsSince(start);
+
+        // Filter from scratch, no narrowing from previous results.
+        filter.setFilterString(std::string());
+        start = Clock::now();
+        filter.setFilterString(needle);
+        const double scanTime = millisecondsSince(start);
+        const std::size_t matches = filter.rows().size();
+
+        smartCaseFilter.setFilterString(std::string());
+        start = Clock::now();
+        smartCaseFilter.setFilterString(needle);
+        const double smartCaseTime = millisecondsSince(start);
+
+        std::cout << std::setw(16) << needle << std::setw(10) << matches
+                  << std::setw(14) << findTime << std::setw(14) << scanTime
+                  << std::setw(14) << smartCaseTime
+                  << (matches == expected ? "" : "  MISMATCH") << std::endl;
+    }
+
+    // Typing character by character narrows the previous result.
+    const std::string typed = "projects/goto";
+    filter.setFilterString(std::string());
+    start = Clock::now();
+    for (std::size_t length = 1; length <= typed.size(); ++length)
+        filter.setFilterString(typed.substr(0, length));
+    std::cout << "Typing \"" << typed << "\": " << millisecondsSince(start) << " ms, "
+              << filter.rows().size() << " matches" << std::endl;
+
+    // The trigram index makes the cost depend on the matches, not on the items.
+    // It is only built for many items, fewer are scanned.
+    ItemFilter indexedFilter(ItemFilter::CaseSensitive);
+    indexedFilter.reset(items);
+    if (! indexedFilter.canIndexMore()) {
+        std::cout << "No trigram index built, too few items" << std::endl;
+    } else {
+        start = Clock::now();
+        indexedFilter.updateIndex();
+        std::cout << "Building the trigram index: " << millisecondsSince(start) << " ms" << std::endl;
+        indexedFilter.setFilterString("nomatch");
+        for (const char *needle : needles) {
+            indexedFilter.setFilterString(std::string());
+            start = Clock::now();
+            indexedFilter.setFilterString(needle);
+            std::cout << "Indexed \"" << needle << "\": " << millisecondsSince(start) << " ms, "
+                      << indexedFilter.rows().size() << " matches" << std::endl;
+        }
+    }
+
+    // Fuzzy matching ranks the matches, only the first page is sorted.
+    ItemFilter fuzzyFilter;
+    fuzzyFilter.setMode(ItemFilter::FuzzyMode);
+    fuzzyFilter.reset(items);
+    fuzzyFilter.setFilterString("nomatch");
+    const char *const patterns[] = { "srcgo", "dcgt", "kernel9", "prjgoto" };
+    for (const char *pattern : patterns) {
+        fuzzyFilter.setFilterString(std::string());
+        start = Clock::now();
+        fuzzyFilter.setFilterString(pattern);
+        const double fuzzyTime = millisecondsSince(start);
+        std::cout << "Fuzzy \"" << pattern << "\": " << fuzzyTime << " ms, "
+                  << fuzzyFilter.rows().size() << " matches";
+        if (! fuzzyFilter.rows().empty()) {
+            const uint32_t best = fuzzyFilter.rows().front();
+            std::cout << ", best " << items.identifier(best).toString() << ' '
+                      << items.pathDisplayed(best).toString();
+        }
+        std::cout << std::endl;
+    }
+
+    // Patterns are compiled to a DFA and matched against all items.
+    ItemFilter patternFilter;
+    patternFilter.reset(items);
+    patternFilter.setFilterString("nomatch");
+    const std::pair<ItemFilter::Mode, const char *> expressions[] = {
+        std::make_pair(ItemFilter::GlobMode, "**/documents/*go*"),
+        std::make_pair(ItemFilter::GlobMode, "~/src/**"),
+        std::make_pair(ItemFilter::RegexMode, "kernel9[0-9]*$"),
+        std::make_pair(ItemFilter::RegexMode, "(src|lib)/.*go"),
+    };
+    for (const std::pair<ItemFilter::Mode, const char *> &pattern : expressions) {
+        patternFilter.setMode(pattern.first);
+        start = Clock::now();
+        patternFilter.setFilterString(pattern.second);
+        std::cout << (pattern.first == ItemFilter::GlobMode ? "Glob \"" : "Regex \"")
+                  << pattern.second << "\": " << millisecondsSince(start) << " ms, "
+                  << patternFilter.rows().size() << " matches" << std::endl;
+    }
+
+    // A key press cancels the filtering, measure how long until the menu is responsive.
+    fuzzyFilter.setFilterString(std::string());
+    Clock::time_point canceled;
+    unsigned checkCount = 0;
+    fuzzyFilter.setCancellationCheck([&canceled, &checkCount]() {
+        canceled = Clock::now();
+        return ++checkCount == 2;
+    });
+    const bool isCompleted = fuzzyFilter.setFilterString("srcgo");
+    const double cancelTime = millisecondsSince(canceled);
+    std::cout << "Canceling fuzzy \"srcgo\": " << (isCompleted ? "not canceled" : "canceled")
+              << " after " << cancelTime << " ms" << std::endl;
+
+    return EXIT_SUCCESS;
+}
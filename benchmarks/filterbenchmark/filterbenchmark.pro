@@ -0,0 +1,15 @@
+TEMPLATE = app
+CONFIG += console
+CONFIG -= app_bundle
+CONFIG -= qt
+CONFIG += thread
+
+QMAKE_CXXFLAGS += -pedantic -std=c++11
+
+INCLUDEPATH += $$PWD/../..
+
+include(../../core/core.pri)
+include(../../utils/utils.pri)
+
+SOURCES += \
+    filterbenchmark.cpp
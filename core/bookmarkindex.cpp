@@ -0,0 +1,270 @@
+#include "bookmarkindex.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace Core {
+namespace BookmarkIndex {
+
+namespace {
+
+const char Magic[8] = { 'G', 'O', 'T', 'O', 'I', 'D', 'X', '\0' };
+const uint32_t Version = 5;
+
+struct Header
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t itemCount;
+    uint64_t sourceDevice;
+    uint64_t sourceInode;
+    uint64_t sourceSize;
+    int64_t sourceModificationSeconds;
+    int64_t sourceModificationNanoseconds;
+    uint64_t homePathHash;
+    uint32_t identifierColumnWidth;
+    uint32_t stringsSize;
+    uint32_t sectionCount;
+    uint32_t headerCount;
+};
+
+static_assert(sizeof(Header) % sizeof(uint64_t) == 0, "Arrays following the header are misaligned");
+static_assert(sizeof(BookmarkSection) % sizeof(uint32_t) == 0, "Sections are misaligned");
+
+// sourceOffsets, offsets and lengths
+const unsigned ArrayCount = 1 + 2 * ItemStore::ColumnCount;
+
+// FNV-1a
+uint64_t hash(const std::string &text)
+{
+    uint64_t result = 14695981039346656037ULL;
+    for (const char c : text) {
+        result ^= static_cast<unsigned char>(c);
+        result *= 1099511628211ULL;
+    }
+    return result;
+}
+
+bool isInside(uint64_t offset, uint64_t length, uint64_t size)
+{
+    return offset <= size && length <= size - offset;
+}
+
+} // anonymous
+
+std::string build(const Utils::FileUtils::FileStamp &sourceStamp,
+                  const std::string &homePath,
+                  Utils::StringUtils::StringRef source,
+                  std::vector<BookmarkRecord> &records) throw(std::runtime_error)
+{
+    std::string strings(source.begin(), source.end());
+    unsigned identifierColumnWidth = 0;
+    std::string pathDisplayed;
+    std::vector<BookmarkSection> sections;
+    std::vector<uint32_t> headerRows;
+    bool isInSection = false;
+    for (std::size_t row = 0; row < records.size(); ++row) {
+        BookmarkRecord &record = records[row];
+        if (record.isSectionHeader) {
+            headerRows.push_back(row);
+            if (isInSection)
+                sections.back().endRow = row;
+            const std::string scope = sectionScope(
+                Utils::StringUtils::StringRef(source.data() + record.nameOffset, record.nameLength),
+                homePath);
+            isInSection = ! scope.empty();
+            if (isInSection) {
+                BookmarkSection section;
+                section.firstRow = row;
+                section.scopeOffset = strings.size();
+                section.scopeLength = scope.size();
+                sections.push_back(section);
+                strings.append(scope);
+            }
+            record.pathDisplayedOffset = record.pathDisplayedLength = 0;
+            continue; // Headers are titles, they may stick out of the identifier column.
+        }
+        if (record.nameLength > identifierColumnWidth)
+            identifierColumnWidth = record.nameLength;
+
+        // Most paths are displayed as they are, refer to them instead of copying.
+        pathDisplayed.clear();
+        const Utils::StringUtils::StringRef path(source.data() + record.pathOffset, record.pathLength);
+        if (Utils::FileUtils::appendPathDisplayed(pathDisplayed, path, homePath)) {
+            record.pathDisplayedOffset = strings.size();
+            record.pathDisplayedLength = pathDisplayed.size();
+            strings.append(pathDisplayed);
+        } else {
+            record.pathDisplayedOffset = record.pathOffset;
+            record.pathDisplayedLength = record.pathLength;
+        }
+    }
+    if (isInSection)
+        sections.back().endRow = records.size();
+    if (strings.size() > UINT32_MAX)
+        throw std::runtime_error("Bookmarks are too large to be indexed");
+
+    Header header;
+    std::memset(&header, 0, sizeof(Header));
+    std::memcpy(header.magic, Magic, sizeof(Magic));
+    header.version = Version;
+    header.itemCount = records.size();
+    header.sourceDevice = sourceStamp.device;
+    header.sourceInode = sourceStamp.inode;
+    header.sourceSize = sourceStamp.size;
+    header.sourceModificationSeconds = sourceStamp.modificationSeconds;
+    header.sourceModificationNanoseconds = sourceStamp.modificationNanoseconds;
+    header.homePathHash = hash(homePath);
+    header.identifierColumnWidth = identifierColumnWidth;
+    header.stringsSize = strings.size();
+    header.sectionCount = sections.size();
+    header.headerCount = headerRows.size();
+
+    // Scatter the records into the arrays.
+    std::vector<uint32_t> arrays(ArrayCount * records.size());
+    uint32_t *sourceOffsets = arrays.data();
+    uint32_t *offsets = sourceOffsets + records.size();
+    uint32_t *lengths = offsets + ItemStore::ColumnCount * records.size();
+    for (std::size_t row = 0; row < records.size(); ++row) {
+        const BookmarkRecord &record = records[row];
+        sourceOffsets[row] = record.sourceOffset;
+        offsets[ItemStore::Identifier * records.size() + row] = record.nameOffset;
+        offsets[ItemStore::Path * records.size() + row] = record.pathOffset;
+        offsets[ItemStore::PathDisplayed * records.size() + row] = record.pathDisplayedOffset;
+        lengths[ItemStore::Identifier * records.size() + row] = record.nameLength;
+        lengths[ItemStore::Path * records.size() + row] = record.pathLength;
+        lengths[ItemStore::PathDisplayed * records.size() + row] = record.pathDisplayedLength;
+    }
+
+    std::string image;
+    image.reserve(sizeof(Header) + arrays.size() * sizeof(uint32_t)
+                  + sections.size() * sizeof(BookmarkSection)
+                  + headerRows.size() * sizeof(uint32_t) + strings.size());
+    image.append(reinterpret_cast<const char *>(&header), sizeof(Header));
+    image.append(reinterpret_cast<const char *>(arrays.data()), arrays.size() * sizeof(uint32_t));
+    image.append(reinterpret_cast<const char *>(sections.data()),
+                 sections.size() * sizeof(BookmarkSection));
+    image.append(reinterpret_cast<const char *>(headerRows.data()),
+                 headerRows.size() * sizeof(uint32_t));
+    image.append(strings);
+    return image;
+}
+
+BookmarkRecord Contents::record(uint32_t row) const
+{
+    BookmarkRecord record;
+    record.sourceOffset = sourceOffsets[row];
+    record.nameOffset = columns.offsets[ItemStore::Identifier][row];
+    record.nameLength = columns.lengths[ItemStore::Identifier][row];
+    record.pathOffset = columns.offsets[ItemStore::Path][row];
+    record.pathLength = columns.lengths[ItemStore::Path][row];
+    record.pathDisplayedOffset = columns.offsets[ItemStore::PathDisplayed][row];
+    record.pathDisplayedLength = columns.lengths[ItemStore::PathDisplayed][row];
+    record.isSectionHeader = std::binary_search(headerRows, headerRows + headerCount, row);
+    return record;
+}
+
+bool Contents::isWithin(uint32_t row, std::size_t begin, std::size_t end) const
+{
+    if (sourceOffsets[row] < begin || sourceOffsets[row] > end)
+        return false;
+    for (int column = ItemStore::Identifier; column <= ItemStore::Path; ++column) {
+        const uint32_t offset = columns.offsets[column][row];
+        if (offset < begin || offset > end || columns.lengths[column][row] > end - offset)
+            return false;
+    }
+    return true;
+}
+
+Utils::StringUtils::StringRef Contents::scope(uint32_t section) const
+{
+    return Utils::StringUtils::StringRef(strings + sections[section].scopeOffset,
+                                         sections[section].scopeLength);
+}
+
+std::string sectionScope(Utils::StringUtils::StringRef header, const std::string &homePath)
+{
+    header = Utils::StringUtils::trim(header);
+    if (header.size() < 2 || header.data()[0] != '[' || header.data()[header.size() - 1] != ']')
+        return std::string();
+    std::string scope = Utils::StringUtils::trim(
+        Utils::StringUtils::StringRef(header.data() + 1, header.size() - 2)).toString();
+    if (! scope.empty() && scope[0] == '~')
+        scope.replace(0, 1, homePath);
+    while (scope.size() > 1 && scope[scope.size() - 1] == '/')
+        scope.resize(scope.size() - 1);
+    return scope;
+}
+
+bool read(Utils::StringUtils::StringRef image, const std::string &homePath, Contents &contents)
+{
+    if (image.size() < sizeof(Header))
+        return false;
+
+    Header header;
+    std::memcpy(&header, image.data(), sizeof(Header));
+    if (std::memcmp(header.magic, Magic, sizeof(Magic)) != 0
+            || header.version != Version
+            || header.homePathHash != hash(homePath)
+            || header.sourceSize > header.stringsSize) {
+        return false;
+    }
+
+    const uint64_t arraysSize = uint64_t(header.itemCount) * ArrayCount * sizeof(uint32_t);
+    const uint64_t sectionsSize = uint64_t(header.sectionCount) * sizeof(BookmarkSection);
+    const uint64_t headerRowsSize = uint64_t(header.headerCount) * sizeof(uint32_t);
+    if (image.size() != sizeof(Header) + arraysSize + sectionsSize + headerRowsSize
+            + header.stringsSize) {
+        return false;
+    }
+
+    // The header has a size of a multiple of 8 and images are at least that aligned.
+    const uint32_t *sourceOffsets = reinterpret_cast<const uint32_t *>(
+        image.data() + sizeof(Header));
+    ItemStore::Columns columns;
+    for (int column = 0; column < ItemStore::ColumnCount; ++column) {
+        columns.offsets[column] = sourceOffsets + (1 + column) * header.itemCount;
+        columns.lengths[column] = sourceOffsets
+            + (1 + ItemStore::ColumnCount + column) * header.itemCount;
+    }
+    const BookmarkSection *sections = reinterpret_cast<const BookmarkSection *>(
+        image.data() + sizeof(Header) + arraysSize);
+    const uint32_t *headerRows = reinterpret_cast<const uint32_t *>(
+        image.data() + sizeof(Header) + arraysSize + sectionsSize);
+    const char *strings = image.data() + sizeof(Header) + arraysSize + sectionsSize
+        + headerRowsSize;
+
+    // Do not trust a damaged file to stay within the image. The sections are read
+    // right away, the rows only on demand.
+    if (header.headerCount > header.itemCount)
+        return false;
+    for (uint32_t section = 0; section < header.sectionCount; ++section) {
+        const BookmarkSection &s = sections[section];
+        if (s.firstRow >= s.endRow || s.endRow > header.itemCount
+                || (section > 0 && s.firstRow < sections[section - 1].endRow)
+                || ! isInside(s.scopeOffset, s.scopeLength, header.stringsSize)) {
+            return false;
+        }
+    }
+
+    contents.sourceStamp.device = header.sourceDevice;
+    contents.sourceStamp.inode = header.sourceInode;
+    contents.sourceStamp.size = header.sourceSize;
+    contents.sourceStamp.modificationSeconds = header.sourceModificationSeconds;
+    contents.sourceStamp.modificationNanoseconds = header.sourceModificationNanoseconds;
+    contents.itemCount = header.itemCount;
+    contents.sourceOffsets = sourceOffsets;
+    contents.columns = columns;
+    contents.sectionCount = header.sectionCount;
+    contents.sections = sections;
+    contents.headerCount = header.headerCount;
+    contents.headerRows = headerRows;
+    contents.strings = strings;
+    contents.stringsSize = header.stringsSize;
+    contents.source = Utils::StringUtils::StringRef(strings, header.sourceSize);
+    contents.identifierColumnWidth = header.identifierColumnWidth;
+    return true;
+}
+
+} // namespace BookmarkIndex
+} // namespace Core
@@ -0,0 +1,108 @@
+#ifndef BOOKMARKINDEX_H
+#define BOOKMARKINDEX_H
+
+#include "itemstore.h"
+
+#include "utils/fileutils.h"
+#include "utils/stringutils.h"
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace Core {
+
+/// Location of a parsed bookmark in the strings of a bookmark index.
+struct BookmarkRecord
+{
+    uint32_t sourceOffset; ///< Start of the line in the bookmark file the record was parsed from
+    uint32_t nameOffset;
+    uint32_t nameLength;
+    uint32_t pathOffset;
+    uint32_t pathLength;
+    uint32_t pathDisplayedOffset;
+    uint32_t pathDisplayedLength;
+    bool isSectionHeader; ///< A line like "[~/project]", the name is all of it, see BookmarkSection
+
+    bool isEmpty() const { return nameLength == 0 && pathLength == 0 && ! isSectionHeader; }
+};
+
+/// The bookmarks following a section header line "[directory]" are scoped to
+/// that directory, up to the next section header. The header "[]" ends scoping.
+struct BookmarkSection
+{
+    uint32_t firstRow; ///< Of the section header
+    uint32_t endRow;
+    uint32_t scopeOffset; ///< The directory, absolute, into the strings
+    uint32_t scopeLength;
+};
+
+/// Binary image of a parsed bookmark file, stored next to it (~/.goto.bookmarks.idx).
+///
+/// Layout, in native byte order:
+///   Header
+///   uint32_t sourceOffsets[itemCount]
+///   uint32_t offsets[ItemStore::ColumnCount][itemCount]
+///   uint32_t lengths[ItemStore::ColumnCount][itemCount]
+///   BookmarkSection sections[sectionCount] - The scoped ones, ordered by row
+///   uint32_t headerRows[headerCount] - Of all section headers, ascending
+///   char strings[stringsSize] - A verbatim copy of the bookmark file followed
+///                               by the displayed paths that differ from the paths
+///                               and the scopes of the sections.
+///
+/// The arrays are the columns of an ItemStore, so it can refer to a mapped image.
+/// Names and paths refer into the copy of the bookmark file. Keeping it allows to
+/// find out which lines changed on reload without trusting the old file contents.
+///
+/// An image is only valid for the source file version (see FileStamp) and the home
+/// directory (for the displayed paths) it was built from.
+namespace BookmarkIndex {
+
+struct Contents
+{
+    Contents()
+        : itemCount(0), sourceOffsets(0), sectionCount(0), sections(0), headerCount(0)
+        , headerRows(0), strings(0), stringsSize(0), identifierColumnWidth(0) {}
+
+    BookmarkRecord record(uint32_t row) const;
+    /// Whether the line of row, its name and its path are within [begin, end) of
+    /// the source. The rows are not checked by read().
+    bool isWithin(uint32_t row, std::size_t begin, std::size_t end) const;
+    Utils::StringUtils::StringRef scope(uint32_t section) const;
+
+    Utils::FileUtils::FileStamp sourceStamp;
+    uint32_t itemCount;
+    const uint32_t *sourceOffsets;
+    ItemStore::Columns columns;
+    uint32_t sectionCount;
+    const BookmarkSection *sections;
+    uint32_t headerCount;
+    const uint32_t *headerRows;
+    const char *strings;
+    uint32_t stringsSize;
+    Utils::StringUtils::StringRef source; ///< The copy of the bookmark file in strings
+    unsigned identifierColumnWidth;
+};
+
+/// Builds an image from records parsed from source. Only the source offsets, names
+/// and paths of the records need to be set, they are relative to source.
+std::string build(const Utils::FileUtils::FileStamp &sourceStamp,
+                  const std::string &homePath,
+                  Utils::StringUtils::StringRef source,
+                  std::vector<BookmarkRecord> &records) throw(std::runtime_error);
+
+/// The directory a section header like "[~/project]" scopes its bookmarks to,
+/// empty for "[]" and for anything not enclosed in brackets.
+std::string sectionScope(Utils::StringUtils::StringRef header, const std::string &homePath);
+
+/// Returns false if the image is damaged or was built for another home directory.
+/// Only the sizes and the sections are checked, so reading takes the same time for
+/// any number of bookmarks. The rows are checked where they are used, see
+/// ItemStore::string() and Contents::isWithin().
+bool read(Utils::StringUtils::StringRef image, const std::string &homePath, Contents &contents);
+
+} // namespace BookmarkIndex
+} // namespace Core
+
+#endif // BOOKMARKINDEX_H
@@ -1,19 +1,209 @@
 #include "bookmarkitemsmodel.h"
+#include "bookmarkindex.h"
 
 #include "utils/debugutils.h"
+#include "utils/fileinfocache.h"
 #include "utils/fileutils.h"
 #include "utils/stringutils.h"
 
-#include <sstream>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
 #include <stdexcept>
+#include <vector>
+
+#include <poll.h>
 
 namespace Core {
 
+/// Backing memory of the item store of BookmarkItemsModel.
+struct BookmarkItemsStorage
+{
+    Utils::FileUtils::MappedFile file; ///< Either the mapped index file...
+    std::string image;                 ///< ...or a freshly built one.
+    BookmarkIndex::Contents contents;
+};
+
+/// State of a progressive load, see BookmarkItemsModel::fetchMore().
+struct BookmarkItemsModel::Loading
+{
+    Loading(Utils::FileUtils::MappedFile &&source)
+        : source(std::move(source)), position(0), appendedCount(0), isAfterEmptyLine(false)
+        , isInSection(false), identifierColumnWidth(0) {}
+
+    Utils::FileUtils::MappedFile source;
+    std::string homePath;
+    std::string filePath;
+    std::string indexFilePath;
+    std::vector<BookmarkRecord> records;
+    std::size_t position;      ///< Start of the next line to parse
+    std::size_t appendedCount; ///< Records appended to the store
+    bool isAfterEmptyLine;     ///< The last record is empty and might absorb more empty lines
+    bool isInSection;          ///< The last section is not ended yet
+    unsigned identifierColumnWidth;
+};
+
+namespace {
+
+using Utils::StringUtils::StringRef;
+
+/// Source bytes parsed per BookmarkItemsModel::fetchMore(). Small enough to keep
+/// the menu responsive, large enough to fill a screen at once.
+const std::size_t FetchChunkSize = 64 * 1024;
+
+/// A line like "[~/project]", see BookmarkSection. Bookmark lines contain the delimiter.
+bool isSectionHeader(StringRef trimmedLine, char delimiter)
+{
+    return trimmedLine.size() >= 2 && trimmedLine.data()[0] == '['
+        && trimmedLine.data()[trimmedLine.size() - 1] == ']'
+        && ! std::memchr(trimmedLine.data(), delimiter, trimmedLine.size());
+}
+
+/// Parse the lines of source in [begin, end). begin must be the start of a line that
+/// is not preceded by an empty line.
+void parseBookmarks(StringRef source, std::size_t begin, std::size_t end,
+                    const std::string &filePath, std::vector<BookmarkRecord> &records)
+{
+    const char delimiter = ',';
+    const char *position = source.data() + begin;
+    const char *const stop = source.data() + end;
+    bool lastLineWasEmpty = false;
+    while (position != stop) {
+        const char *newline = static_cast<const char *>(std::memchr(position, '\n', stop - position));
+        const char *lineEnd = newline ? newline : stop;
+        const StringRef line(position, lineEnd - position);
+        position = newline ? newline + 1 : stop;
+
+        // Merge multiple empty lines to one entry
+        const StringRef trimmedLine = Utils::StringUtils::trim(line);
+        const bool isEmptyLine = trimmedLine.empty();
+        if (lastLineWasEmpty) {
+            if (isEmptyLine)
+                continue;
+            else
+                lastLineWasEmpty = false;
+        } else {
+            if (isEmptyLine)
+                lastLineWasEmpty = true;
+        }
+
+        // Parse line
+        StringRef bookmarkName(line.begin(), 0);
+        StringRef bookmarkPath(line.begin(), 0);
+        const bool isHeader = isSectionHeader(trimmedLine, delimiter);
+        if (isHeader) {
+            bookmarkName = trimmedLine;
+            bookmarkPath = StringRef(trimmedLine.end(), 0);
+        } else if (! isEmptyLine) {
+            // The name is everything up to the first delimiter, the path everything up to
+            // the next delimiter or the end of the line. Both must be present.
+            const char *nameEnd = static_cast<const char *>(
+                std::memchr(line.begin(), delimiter, line.size()));
+            if (! nameEnd || nameEnd + 1 == lineEnd) {
+                // Only count lines in the rare error case.
+                const unsigned lineNumber = std::count(source.begin(), line.begin(), '\n') + 1;
+                const std::string reason = "Malformed line " + std::to_string(lineNumber) + " in "
+                        + filePath;
+                throw std::runtime_error(reason);
+            }
+            const char *pathBegin = nameEnd + 1;
+            const char *pathEnd = static_cast<const char *>(
+                std::memchr(pathBegin, delimiter, lineEnd - pathBegin));
+            if (! pathEnd)
+                pathEnd = lineEnd;
+
+            // Don't trim in the beginning. User might want to indent.
+            bookmarkName = Utils::StringUtils::rtrim(StringRef(line.begin(), nameEnd - line.begin()));
+            bookmarkPath = Utils::StringUtils::trim(StringRef(pathBegin, pathEnd - pathBegin));
+        }
+
+        BookmarkRecord record;
+        record.sourceOffset = line.begin() - source.begin();
+        record.nameOffset = bookmarkName.begin() - source.begin();
+        record.nameLength = bookmarkName.size();
+        record.pathOffset = bookmarkPath.begin() - source.begin();
+        record.pathLength = bookmarkPath.size();
+        record.pathDisplayedOffset = record.pathDisplayedLength = 0; // Set by the index
+        record.isSectionHeader = isHeader;
+        records.push_back(record);
+    }
+}
+
+/// Returns the start of the first line at or after begin that is not empty.
+std::size_t skipEmptyLines(StringRef source, std::size_t begin)
+{
+    while (begin != source.size()) {
+        const char *lineBegin = source.data() + begin;
+        const char *newline = static_cast<const char *>(
+            std::memchr(lineBegin, '\n', source.size() - begin));
+        const char *lineEnd = newline ? newline : source.end();
+        if (! Utils::StringUtils::trim(StringRef(lineBegin, lineEnd - lineBegin)).empty())
+            break;
+        begin = newline ? newline + 1 - source.data() : source.size();
+    }
+    return begin;
+}
+
+void discardTrailingEmptyRecord(std::vector<BookmarkRecord> &records)
+{
+    // Discard only line or last line if it is empty.
+    if (! records.empty() && records.back().isEmpty())
+            records.pop_back();
+}
+
+const std::size_t CompareBlockSize = 4096;
+
+std::size_t commonPrefixLength(const char *a, const char *b, std::size_t size)
+{
+    // Let memcmp() skip over equal blocks, it is way faster than comparing bytes.
+    std::size_t length = 0;
+    while (length + CompareBlockSize <= size
+           && std::memcmp(a + length, b + length, CompareBlockSize) == 0) {
+        length += CompareBlockSize;
+    }
+    while (length < size && a[length] == b[length])
+        ++length;
+    return length;
+}
+
+std::size_t commonSuffixLength(const char *aEnd, const char *bEnd, std::size_t size)
+{
+    std::size_t length = 0;
+    while (length + CompareBlockSize <= size
+           && std::memcmp(aEnd - length - CompareBlockSize,
+                          bEnd - length - CompareBlockSize, CompareBlockSize) == 0) {
+        length += CompareBlockSize;
+    }
+    while (length < size && aEnd[-1 - std::ptrdiff_t(length)] == bEnd[-1 - std::ptrdiff_t(length)])
+        ++length;
+    return length;
+}
+
+} // anonymous
+
+BookmarkItem::BookmarkItem(const ItemStore &store, uint32_t row)
+    : m_name(store.identifier(row).toString())
+    , m_path(store.path(row).toString())
+{
+}
+
 BookmarkItem::HandlerHint::HandlerHint(const std::string &path)
     : hint(NoHandlerHint)
 {
     assert(!path.empty());
-    Utils::FileUtils::FileInfo fileInfo(path);
+    // Usually cached since the item was shown, otherwise the menu is closed
+    // already and waiting for stat() does no harm.
+    Utils::FileUtils::FileInfo fileInfo
+        = Utils::FileUtils::FileInfoCache::globalInstance().fileInfo(path);
+    if (! fileInfo.isProbed)
+        fileInfo = Utils::FileUtils::FileInfo(path);
+    hint = HandlerHint(fileInfo).hint;
+}
+
+BookmarkItem::HandlerHint::HandlerHint(const Utils::FileUtils::FileInfo &fileInfo)
+    : hint(NoHandlerHint)
+{
     assert(fileInfo.exists);
 
     if (fileInfo.isDirectory) {
@@ -24,85 +214,666 @@ BookmarkItem::HandlerHint::HandlerHint(const std::string &path)
     }
 }
 
-std::string BookmarkItem::pathDisplayed() const
+BookmarkItemsModel::BookmarkItemsModel(const std::string &bookmarkFilePath, bool refresh,
+                                       IndexMode indexMode, LoadMode loadMode)
+    : m_bookmarkFilePath(bookmarkFilePath)
+    , m_indexMode(indexMode)
+    , m_loadMode(loadMode)
+    , m_hasChanges(false)
+    , m_changesBaseCount(0)
+    , m_validationGeneration(0)
+    , m_pendingValidationCount(0)
+    , m_validatedCount(0)
+    , m_missingCount(0)
+    , m_hasActiveSections(false)
 {
-    const std::string homePath = std::getenv("HOME");
-    const int homePathLength = homePath.size();
-    const std::string path = this->path();
-    if (! path.compare(0, homePathLength, homePath))
-        return std::string(path).replace(0, homePathLength, "~");
-    return path;
+    if (refresh)
+        readBookmarksFromFile(m_loadMode);
 }
 
-BookmarkItemsModel::BookmarkItemsModel(const std::string &bookmarkFilePath, bool refresh)
-    : m_bookmarkFilePath(bookmarkFilePath)
+BookmarkItemsModel::~BookmarkItemsModel()
 {
-    if (refresh)
-        readBookmarksFromFile();
+    if (m_watchThread.joinable()) {
+        m_stopNotifier->notify();
+        m_watchThread.join();
+    }
 }
 
-MenuItems BookmarkItemsModel::items(bool refresh)
+const ItemStore &BookmarkItemsModel::items()
 {
-    if (refresh)
-        readBookmarksFromFile();
-    return m_items;
+    return m_store;
+}
+
+bool BookmarkItemsModel::reload(ItemsUpdate &update)
+{
+    if (! m_storage) {
+        // Not (completely) loaded yet, so just load everything now.
+        const uint32_t oldCount = m_store.size();
+        readBookmarksFromFile(LoadAtOnce);
+        update = ItemsUpdate();
+        update.removedCount = oldCount;
+        update.insertedCount = m_store.size();
+        return true;
+    }
+
+    // Reload relative to the latest storage. The watcher might have reloaded in
+    // the meantime, then the changes not taken yet are merged with ours.
+    for (;;) {
+        const std::shared_ptr<BookmarkItemsStorage> base = latestStorage();
+        std::shared_ptr<BookmarkItemsStorage> result;
+        ItemsUpdate changes;
+        if (! computeReload(base, result, changes) || offerChanges(base, result, changes))
+            return takeChanges(update);
+    }
 }
 
-void BookmarkItemsModel::readBookmarksFromFile()
+/// Only the lines that differ from the previously read file are parsed. The common
+/// beginning and end are found by comparing with the copy of the file in the index.
+bool BookmarkItemsModel::computeReload(const std::shared_ptr<BookmarkItemsStorage> &base,
+                                       std::shared_ptr<BookmarkItemsStorage> &result,
+                                       ItemsUpdate &update) const
 {
     const std::string homePath = std::getenv("HOME");
     const std::string filePath = homePath + std::string("/") + m_bookmarkFilePath;
+    const std::string indexFilePath = filePath + ".idx";
 
-    // Read file
-    std::ifstream file(filePath.c_str());
-    if (! file)
-        throw std::runtime_error("Could not open file \"" + filePath + "\"");
+    const Utils::FileUtils::MappedFile source(filePath);
+    const BookmarkIndex::Contents &old = base->contents;
+    if (source.stamp() == old.sourceStamp)
+        return false;
 
-    // Parse file
-    m_items.clear();
-    std::string line;
-    const char delimiter = ',';
-    bool lastLineWasEmpty = false;
-    for (unsigned lineNumber = 1; file && getline(file, line); ++lineNumber) {
-        // Merge multiple empty lines to one entry
-        std::string copiedLine(line);
-        const bool isEmptyLine = Utils::StringUtils::trim(copiedLine).empty();
-        if (lastLineWasEmpty) {
-            if (isEmptyLine)
+    const StringRef oldSource = old.source;
+    const StringRef newSource(source.data(), source.size());
+    const std::size_t minimumSize = std::min(oldSource.size(), newSource.size());
+    const std::size_t prefixLength = commonPrefixLength(oldSource.data(), newSource.data(),
+                                                        minimumSize);
+    const std::size_t suffixLength = commonSuffixLength(oldSource.end(), newSource.end(),
+                                                        minimumSize - prefixLength);
+
+    // Keep the records followed by another record starting within the common prefix.
+    // If the last kept one is an empty line, following empty lines must be merged
+    // into it, so reparse it.
+    const uint32_t *oldBegin = old.sourceOffsets;
+    const uint32_t *oldEnd = old.sourceOffsets + old.itemCount;
+    const std::size_t startingInPrefix = std::upper_bound(oldBegin, oldEnd, prefixLength) - oldBegin;
+    std::size_t keptBefore = startingInPrefix > 0 ? startingInPrefix - 1 : 0;
+    if (keptBefore > 0 && old.record(keptBefore - 1).isEmpty())
+        --keptBefore;
+
+    // Keep the records whose line, including the preceding line break, is within the
+    // common suffix. Empty entries might merge with changed lines, so reparse them.
+    const std::size_t suffixStart = oldSource.size() - suffixLength;
+    std::size_t keptAfterBegin = std::lower_bound(oldBegin, oldEnd, suffixStart + 1) - oldBegin;
+    while (keptAfterBegin < old.itemCount && old.record(keptAfterBegin).isEmpty())
+        ++keptAfterBegin;
+
+    const std::ptrdiff_t shift = std::ptrdiff_t(newSource.size()) - std::ptrdiff_t(oldSource.size());
+    std::size_t parseBegin = keptBefore < old.itemCount ? old.sourceOffsets[keptBefore] : 0;
+    std::size_t parseEnd = keptAfterBegin < old.itemCount
+        ? old.sourceOffsets[keptAfterBegin] + shift
+        : newSource.size();
+
+    // The rows of the index were not checked on reading. If the kept ones are not
+    // within the common beginning and end, the index is damaged, so parse all lines.
+    bool isIntact = parseBegin <= parseEnd && parseEnd <= newSource.size();
+    for (uint32_t row = 0; isIntact && row < keptBefore; ++row)
+        isIntact = old.isWithin(row, 0, prefixLength);
+    for (uint32_t row = keptAfterBegin; isIntact && row < old.itemCount; ++row)
+        isIntact = old.isWithin(row, suffixStart, oldSource.size());
+    if (! isIntact) {
+        keptBefore = 0;
+        keptAfterBegin = old.itemCount;
+        parseBegin = 0;
+        parseEnd = newSource.size();
+    }
+
+    std::vector<BookmarkRecord> records;
+    records.reserve(old.itemCount + 16);
+    for (uint32_t row = 0; row < keptBefore; ++row)
+        records.push_back(old.record(row));
+    parseBookmarks(newSource, parseBegin, parseEnd, filePath, records);
+    if (keptAfterBegin == old.itemCount)
+        discardTrailingEmptyRecord(records);
+    const std::size_t insertedCount = records.size() - keptBefore;
+    for (uint32_t row = keptAfterBegin; row < old.itemCount; ++row) {
+        BookmarkRecord shifted = old.record(row);
+        shifted.sourceOffset += shift;
+        shifted.nameOffset += shift;
+        shifted.pathOffset += shift;
+        records.push_back(shifted);
+    }
+
+    result = buildIndex(indexFilePath, homePath, source, records);
+
+    update.firstRow = keptBefore;
+    update.removedCount = keptAfterBegin - keptBefore;
+    update.insertedCount = insertedCount;
+    return true;
+}
+
+bool BookmarkItemsModel::startWatching()
+{
+    const std::string filePath = std::string(std::getenv("HOME")) + "/" + m_bookmarkFilePath;
+    try {
+        m_watcher.reset(new Utils::FileWatcher(filePath));
+        m_notifier.reset(new Utils::Notifier);
+        m_stopNotifier.reset(new Utils::Notifier);
+    } catch (const std::runtime_error &error) {
+        Utils::DebugUtils::debug() << "Could not watch bookmarks:" << error.what();
+        m_watcher.reset();
+        return false;
+    }
+
+    m_watchThread = std::thread(&BookmarkItemsModel::watch, this);
+    return true;
+}
+
+int BookmarkItemsModel::notificationDescriptor()
+{
+    return m_notifier ? m_notifier->fileDescriptor() : -1;
+}
+
+bool BookmarkItemsModel::takeChanges(ItemsUpdate &update)
+{
+    std::shared_ptr<BookmarkItemsStorage> storage;
+    {
+        std::lock_guard<std::mutex> locker(m_mutex);
+        if (m_notifier)
+            m_notifier->clear();
+        if (! m_hasChanges)
+            return false;
+        update = m_changes;
+        storage = m_latestStorage;
+        m_hasChanges = false;
+    }
+
+    setStorage(storage);
+    updateFileInfos(update);
+    return true;
+}
+
+int BookmarkItemsModel::fileInfoNotificationDescriptor()
+{
+    return m_pathValidator ? m_pathValidator->notificationDescriptor() : -1;
+}
+
+bool BookmarkItemsModel::takeFileInfos()
+{
+    if (! m_pathValidator)
+        return false;
+
+    bool changed = false;
+    for (const PathValidator::Result &result : m_pathValidator->takeResults()) {
+        if (result.generation != m_validationGeneration)
+            continue; // For rows that moved meanwhile
+        assert(result.firstRow + result.infos.size() <= m_fileInfos.size());
+        std::copy(result.infos.begin(), result.infos.end(), m_fileInfos.begin() + result.firstRow);
+        m_validatedCount += result.infos.size();
+        m_missingCount += std::count_if(result.infos.begin(), result.infos.end(),
+            [](const Utils::FileUtils::FileInfo &info) { return info.error == ENOENT; });
+        m_pendingValidationCount -= result.infos.size();
+        changed = true;
+    }
+
+    if (changed && m_pendingValidationCount == 0) {
+        using namespace std::chrono;
+        const int elapsed = duration_cast<milliseconds>(steady_clock::now() - m_validationStart).count();
+        Utils::DebugUtils::debug() << "Validated" << int(m_validatedCount) << "paths in" << elapsed
+                                   << "ms," << int(m_missingCount) << "do not exist";
+    }
+    return changed;
+}
+
+bool BookmarkItemsModel::fileInfo(uint32_t row, Utils::FileUtils::FileInfo &info)
+{
+    if (row >= m_fileInfos.size() || ! m_fileInfos[row].isProbed)
+        return false;
+    info = m_fileInfos[row];
+    return true;
+}
+
+void BookmarkItemsModel::revalidate()
+{
+    ++m_validationGeneration;
+    m_pendingValidationCount = 0;
+    validatePaths(0, m_fileInfos.size());
+}
+
+/// Keep the file infos in line with the rows of the store and validate the new rows.
+void BookmarkItemsModel::updateFileInfos(const ItemsUpdate &update)
+{
+    const bool isAppended = update.removedCount == 0 && update.firstRow == m_fileInfos.size();
+    const auto first = m_fileInfos.begin() + update.firstRow;
+    m_fileInfos.erase(first, first + update.removedCount);
+    m_fileInfos.insert(m_fileInfos.begin() + update.firstRow, update.insertedCount,
+                       Utils::FileUtils::FileInfo());
+    assert(m_fileInfos.size() == m_store.size());
+    if (isAppended) {
+        validatePaths(update.firstRow, update.firstRow + update.insertedCount);
+        return;
+    }
+
+    // Results on their way are for the old rows, so validate all that are missing again.
+    ++m_validationGeneration;
+    m_pendingValidationCount = 0;
+    for (uint32_t row = 0; row < m_fileInfos.size(); ) {
+        if (m_fileInfos[row].isProbed) {
+            ++row;
+            continue;
+        }
+        const uint32_t begin = row;
+        while (row < m_fileInfos.size() && ! m_fileInfos[row].isProbed)
+            ++row;
+        validatePaths(begin, row);
+    }
+}
+
+void BookmarkItemsModel::validatePaths(uint32_t beginRow, uint32_t endRow)
+{
+    if (beginRow == endRow)
+        return;
+    if (! m_pathValidator) {
+        try {
+            m_pathValidator.reset(new PathValidator);
+        } catch (const std::runtime_error &error) {
+            Utils::DebugUtils::debug() << "Could not validate paths:" << error.what();
+            return;
+        }
+    }
+
+    if (m_pendingValidationCount == 0) {
+        m_validationStart = std::chrono::steady_clock::now();
+        m_validatedCount = 0;
+        m_missingCount = 0;
+    }
+    m_pendingValidationCount += endRow - beginRow;
+    m_pathValidator->validate(m_validationGeneration, m_store, beginRow, endRow);
+}
+
+std::shared_ptr<BookmarkItemsStorage> BookmarkItemsModel::latestStorage()
+{
+    std::lock_guard<std::mutex> locker(m_mutex);
+    return m_latestStorage;
+}
+
+/// Returns false if base is not the latest storage anymore.
+bool BookmarkItemsModel::offerChanges(const std::shared_ptr<BookmarkItemsStorage> &base,
+                                      const std::shared_ptr<BookmarkItemsStorage> &result,
+                                      const ItemsUpdate &changes)
+{
+    std::lock_guard<std::mutex> locker(m_mutex);
+    if (m_latestStorage != base)
+        return false;
+
+    if (m_hasChanges) {
+        // Rows unchanged at the beginning and end by both updates are unchanged overall.
+        const unsigned baseCount = m_changesBaseCount;
+        const unsigned intermediateCount = baseCount - m_changes.removedCount + m_changes.insertedCount;
+        const unsigned resultCount = intermediateCount - changes.removedCount + changes.insertedCount;
+        const unsigned firstRow = std::min(m_changes.firstRow, changes.firstRow);
+        const unsigned keptAtEnd = std::min(
+            baseCount - m_changes.firstRow - m_changes.removedCount,
+            intermediateCount - changes.firstRow - changes.removedCount);
+        m_changes.firstRow = firstRow;
+        m_changes.removedCount = baseCount - firstRow - keptAtEnd;
+        m_changes.insertedCount = resultCount - firstRow - keptAtEnd;
+    } else {
+        m_changes = changes;
+        m_changesBaseCount = base->contents.itemCount;
+        m_hasChanges = true;
+    }
+    m_latestStorage = result;
+
+    if (m_notifier)
+        m_notifier->notify();
+    return true;
+}
+
+/// Runs in its own thread. Bursts of writes, e.g. by a script appending line by
+/// line, are collected to one reload.
+void BookmarkItemsModel::watch()
+{
+    using namespace std::chrono;
+    const milliseconds QuietPeriod(100);
+    const milliseconds MaximumDelay(1000);
+
+    pollfd fileDescriptors[2];
+    fileDescriptors[0].fd = m_watcher->fileDescriptor();
+    fileDescriptors[0].events = POLLIN;
+    fileDescriptors[1].fd = m_stopNotifier->fileDescriptor();
+    fileDescriptors[1].events = POLLIN;
+
+    bool isReloadPending = false;
+    steady_clock::time_point quietPeriodEnd;
+    steady_clock::time_point deadline;
+    for (;;) {
+        int timeout = -1;
+        if (isReloadPending) {
+            const steady_clock::time_point now = steady_clock::now();
+            const steady_clock::time_point wakeUp = std::min(quietPeriodEnd, deadline);
+            timeout = wakeUp > now ? duration_cast<milliseconds>(wakeUp - now).count() + 1 : 0;
+        }
+
+        const int readyCount = poll(fileDescriptors, 2, timeout);
+        if (readyCount == -1) {
+            if (errno == EINTR)
                 continue;
-            else
-                lastLineWasEmpty = false;
-        } else {
-            if (isEmptyLine)
-                lastLineWasEmpty = true;
+            Utils::DebugUtils::debug() << "Stopped watching bookmarks:" << std::strerror(errno);
+            return;
         }
+        if (fileDescriptors[1].revents)
+            return;
 
-        // Parse line
-        std::string bookmarkName;
-        std::string bookmarkPath;
-        if (! isEmptyLine) {
-            std::istringstream lineStream(line);
-            const bool gotBookmarkName = getline(lineStream, bookmarkName, delimiter);
-            const bool gotBookmarkPath = getline(lineStream, bookmarkPath, delimiter);
-            if (! gotBookmarkName || ! gotBookmarkPath) {
-                const std::string reason = "Malformed line " + std::to_string(lineNumber) + " in "
-                        + filePath;
-                throw std::runtime_error(reason);
+        if (readyCount > 0 && m_watcher->readEvents()) {
+            const steady_clock::time_point now = steady_clock::now();
+            if (! isReloadPending)
+                deadline = now + MaximumDelay;
+            quietPeriodEnd = now + QuietPeriod;
+            isReloadPending = true;
+            continue;
+        }
+
+        if (isReloadPending && steady_clock::now() >= std::min(quietPeriodEnd, deadline)) {
+            if (! latestStorage()) {
+                // Still loading progressively, reload relative to the loaded file later.
+                quietPeriodEnd = deadline = steady_clock::now() + QuietPeriod;
+                continue;
+            }
+            isReloadPending = false;
+            try {
+                for (;;) {
+                    const std::shared_ptr<BookmarkItemsStorage> base = latestStorage();
+                    std::shared_ptr<BookmarkItemsStorage> result;
+                    ItemsUpdate changes;
+                    if (! computeReload(base, result, changes) || offerChanges(base, result, changes))
+                        break;
+                }
+            } catch (const std::runtime_error &error) {
+                // E.g. a line is written only partly yet. Wait for the next change.
+                Utils::DebugUtils::debug() << "Could not reload bookmarks:" << error.what();
             }
         }
+    }
+}
+
+unsigned BookmarkItemsModel::identifierColumnWidth()
+{
+    if (m_loading)
+        return m_loading->identifierColumnWidth;
+    return m_storage ? m_storage->contents.identifierColumnWidth : 0;
+}
+
+bool BookmarkItemsModel::canFetchMore()
+{
+    return m_loading.get() != 0;
+}
 
-        // Don't trim in the beginning. User might want to indent.
-        Utils::StringUtils::rtrim(bookmarkName);
-        Utils::StringUtils::trim(bookmarkPath);
+/// Parses the next chunk of lines and appends them to the store. Once the whole
+/// file is parsed, the index is built and the store switched over to it.
+void BookmarkItemsModel::fetchMore(ItemsUpdate &update)
+{
+    update = ItemsUpdate();
+    update.firstRow = m_store.size();
+    if (! m_loading)
+        return;
 
-        m_items.push_back(BookmarkItemPointer(new BookmarkItem(bookmarkName, bookmarkPath)));
+    Loading &loading = *m_loading;
+    const StringRef source(loading.source.data(), loading.source.size());
+    std::size_t begin = loading.position;
+    if (loading.isAfterEmptyLine)
+        begin = skipEmptyLines(source, begin); // parseBookmarks() would not merge them
+    std::size_t end = std::min(begin + FetchChunkSize, source.size());
+    if (end != source.size()) {
+        const char *newline = static_cast<const char *>(
+            std::memchr(source.data() + end, '\n', source.size() - end));
+        end = newline ? newline + 1 - source.data() : source.size();
     }
+    parseBookmarks(source, begin, end, loading.filePath, loading.records);
+    loading.position = end;
+    loading.isAfterEmptyLine = ! loading.records.empty() && loading.records.back().isEmpty();
 
-    // Discard only line or last line if it is empty.
-    if (! m_items.empty() && m_items.back()->isEmpty())
-            m_items.pop_back();
+    // Hold back a trailing empty record, it is dropped if the file ends with it.
+    const std::size_t appendableCount = loading.records.size() - (loading.isAfterEmptyLine ? 1 : 0);
+    std::string pathDisplayed;
+    const std::size_t sectionCount = m_sections.size();
+    for (; loading.appendedCount < appendableCount; ++loading.appendedCount) {
+        const BookmarkRecord &record = loading.records[loading.appendedCount];
+        const StringRef name(source.data() + record.nameOffset, record.nameLength);
+        const StringRef path(source.data() + record.pathOffset, record.pathLength);
+        if (record.isSectionHeader) {
+            if (loading.isInSection)
+                m_sections.back().endRow = m_store.size();
+            const std::string scope = BookmarkIndex::sectionScope(name, loading.homePath);
+            loading.isInSection = ! scope.empty();
+            if (loading.isInSection)
+                addSection(m_store.size(), scope);
+        } else if (record.nameLength > loading.identifierColumnWidth) {
+            loading.identifierColumnWidth = record.nameLength;
+        }
+        pathDisplayed.clear();
+        Utils::FileUtils::appendPathDisplayed(pathDisplayed, path, loading.homePath);
+        m_store.append(name, path, StringRef(pathDisplayed.data(), pathDisplayed.size()));
+    }
+    if (loading.isInSection)
+        m_sections.back().endRow = m_store.size();
+    if (m_sections.size() != sectionCount)
+        activateSections();
+    update.insertedCount = m_store.size() - update.firstRow;
+    updateFileInfos(update);
+
+    if (loading.position == source.size()) {
+        discardTrailingEmptyRecord(loading.records);
+        assert(loading.records.size() == m_store.size());
+        setInitialStorage(buildIndex(loading.indexFilePath, loading.homePath, loading.source,
+                                     loading.records));
+        m_loading.reset();
+    }
+}
+
+unsigned BookmarkItemsModel::fetchProgress()
+{
+    if (! m_loading || m_loading->source.size() == 0)
+        return 100;
+    return m_loading->position * 100 / m_loading->source.size();
+}
+
+void BookmarkItemsModel::readBookmarksFromFile(LoadMode loadMode)
+{
+    const std::string homePath = std::getenv("HOME");
+    const std::string filePath = homePath + std::string("/") + m_bookmarkFilePath;
+    const std::string indexFilePath = filePath + ".idx";
+
+    m_loading.reset();
+    ItemsUpdate update; // Of the file infos, all rows are replaced
+    update.removedCount = m_fileInfos.size();
+
+    // A valid index is all that is needed, the file itself is only stat'ed then.
+    Utils::FileUtils::FileStamp sourceStamp;
+    if (m_indexMode == UseIndex && Utils::FileUtils::fileStamp(filePath, sourceStamp)) {
+        std::shared_ptr<BookmarkItemsStorage> storage = readIndex(indexFilePath, homePath);
+        if (storage && storage->contents.sourceStamp == sourceStamp) {
+            setInitialStorage(storage);
+            update.insertedCount = m_store.size();
+            updateFileInfos(update);
+            return;
+        }
+    }
+    m_indexMode = UseIndex; // A forced rebuild is done once.
+
+    // The file is only mapped for parsing. An editor might change or truncate it
+    // in place, so the items must not refer into it.
+    Utils::FileUtils::MappedFile source(filePath);
+    if (loadMode == LoadProgressively) {
+        m_store.clear();
+        m_storage.reset();
+        m_sections.clear();
+        m_scopes.clear();
+        activateSections();
+        {
+            std::lock_guard<std::mutex> locker(m_mutex);
+            m_latestStorage.reset();
+            m_hasChanges = false;
+        }
+        m_loading.reset(new Loading(std::move(source)));
+        m_loading->homePath = homePath;
+        m_loading->filePath = filePath;
+        m_loading->indexFilePath = indexFilePath;
+        updateFileInfos(update);
+
+        // Have the first screen ready right away.
+        fetchMore(update);
+        return;
+    }
+
+    const StringRef sourceText(source.data(), source.size());
+    std::vector<BookmarkRecord> records;
+    records.reserve(std::count(sourceText.begin(), sourceText.end(), '\n') + 1);
+    parseBookmarks(sourceText, 0, sourceText.size(), filePath, records);
+    discardTrailingEmptyRecord(records);
+
+    setInitialStorage(buildIndex(indexFilePath, homePath, source, records));
+    update.insertedCount = m_store.size();
+    updateFileInfos(update);
+}
+
+void BookmarkItemsModel::setInitialStorage(const std::shared_ptr<BookmarkItemsStorage> &storage)
+{
+    setStorage(storage);
+    std::lock_guard<std::mutex> locker(m_mutex);
+    m_latestStorage = storage;
+    m_hasChanges = false;
+}
+
+std::shared_ptr<BookmarkItemsStorage> BookmarkItemsModel::readIndex(
+        const std::string &indexFilePath, const std::string &homePath) const
+{
+    std::shared_ptr<BookmarkItemsStorage> storage(new BookmarkItemsStorage);
+    try {
+        storage->file = Utils::FileUtils::MappedFile(indexFilePath);
+    } catch (const std::runtime_error &) {
+        return std::shared_ptr<BookmarkItemsStorage>(); // Not built yet
+    }
+
+    const StringRef image(storage->file.data(), storage->file.size());
+    if (! BookmarkIndex::read(image, homePath, storage->contents))
+        return std::shared_ptr<BookmarkItemsStorage>();
+    return storage;
+}
+
+std::shared_ptr<BookmarkItemsStorage> BookmarkItemsModel::buildIndex(
+        const std::string &indexFilePath, const std::string &homePath,
+        const Utils::FileUtils::MappedFile &source, std::vector<BookmarkRecord> &records) const
+{
+    std::shared_ptr<BookmarkItemsStorage> storage(new BookmarkItemsStorage);
+    storage->image = BookmarkIndex::build(source.stamp(), homePath,
+                                          StringRef(source.data(), source.size()), records);
+    const bool isValid = BookmarkIndex::read(StringRef(storage->image.data(), storage->image.size()),
+                                             homePath, storage->contents);
+    assert(isValid);
+
+    // The index is just a cache, so do not bother the user if it can't be written.
+    try {
+        Utils::FileUtils::writeFileAtomically(indexFilePath, storage->image);
+    } catch (const std::runtime_error &error) {
+        Utils::DebugUtils::debug() << "Could not write bookmark index:" << error.what();
+    }
+
+    return storage;
+}
+
+void BookmarkItemsModel::setStorage(const std::shared_ptr<BookmarkItemsStorage> &storage)
+{
+    const BookmarkIndex::Contents &contents = storage->contents;
+    m_store.setExternal(storage, contents.itemCount, contents.strings, contents.stringsSize,
+                        contents.columns);
+    m_storage = storage;
+
+    // Only the sections are read, not the bookmarks.
+    m_sections.clear();
+    m_scopes.clear();
+    for (uint32_t section = 0; section < contents.sectionCount; ++section) {
+        addSection(contents.sections[section].firstRow, contents.scope(section).toString());
+        m_sections.back().endRow = contents.sections[section].endRow;
+    }
+    activateSections();
+}
+
+void BookmarkItemsModel::setCurrentDirectory(const std::string &directory)
+{
+    m_currentDirectory = directory;
+    activateSections();
+}
+
+bool BookmarkItemsModel::hasPriorities()
+{
+    return m_hasActiveSections;
+}
+
+unsigned BookmarkItemsModel::priority(uint32_t row)
+{
+    if (! m_hasActiveSections)
+        return 0;
+    const std::vector<Section>::const_iterator it = std::upper_bound(
+        m_sections.begin(), m_sections.end(), row,
+        [](uint32_t row, const Section &section) { return row < section.firstRow; });
+    if (it == m_sections.begin() || row >= (it - 1)->endRow)
+        return 0;
+    return m_sectionPriorities[it - 1 - m_sections.begin()];
+}
+
+std::vector<uint32_t> BookmarkItemsModel::activeItems(const std::string &directory) const
+{
+    std::vector<Utils::PathTrie::Match> matches;
+    m_scopes.find(StringRef(directory.data(), directory.size()), matches);
+    // Sections of the same scope in the order of the file.
+    std::stable_sort(matches.begin(), matches.end(),
+                     [](const Utils::PathTrie::Match &lhs, const Utils::PathTrie::Match &rhs) {
+        return lhs.depth != rhs.depth ? lhs.depth > rhs.depth : lhs.value < rhs.value;
+    });
+
+    std::vector<uint32_t> rows;
+    for (const Utils::PathTrie::Match &match : matches) {
+        const Section &section = m_sections[match.value];
+        for (uint32_t row = section.firstRow + 1; row < section.endRow; ++row) {
+            if (! m_store.isEmpty(row))
+                rows.push_back(row);
+        }
+    }
+    std::vector<Section>::const_iterator section = m_sections.begin();
+    for (uint32_t row = 0; row < m_store.size(); ++row) {
+        if (section != m_sections.end() && row == section->firstRow) {
+            row = section->endRow - 1;
+            ++section;
+        } else if (! m_store.isEmpty(row)) {
+            rows.push_back(row);
+        }
+    }
+    return rows;
+}
+
+void BookmarkItemsModel::addSection(uint32_t row, const std::string &scope)
+{
+    Section section;
+    section.firstRow = row;
+    section.endRow = row + 1;
+    section.scope = scope;
+    m_scopes.insert(StringRef(scope.data(), scope.size()), m_sections.size());
+    m_sections.push_back(section);
+}
+
+/// Looks up the sections scoped to the current directory, in time proportional to its depth.
+void BookmarkItemsModel::activateSections()
+{
+    m_sectionPriorities.assign(m_sections.size(), 0);
+    m_hasActiveSections = false;
+    if (m_currentDirectory.empty())
+        return;
 
-    file.close();
+    std::vector<Utils::PathTrie::Match> matches;
+    m_scopes.find(StringRef(m_currentDirectory.data(), m_currentDirectory.size()), matches);
+    for (const Utils::PathTrie::Match &match : matches)
+        m_sectionPriorities[match.value] = match.depth + 1;
+    m_hasActiveSections = ! matches.empty();
 }
 
 } // namespace Core
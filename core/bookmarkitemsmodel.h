@@ -1,19 +1,33 @@
 #ifndef BOOKMARKITEMSMODEL_H
 #define BOOKMARKITEMSMODEL_H
 
-#include "imenuitem.h"
 #include "imodel.h"
+#include "itemstore.h"
+#include "pathvalidator.h"
 
+#include "utils/fileutils.h"
+#include "utils/filewatcher.h"
+#include "utils/notifier.h"
+#include "utils/pathtrie.h"
+#include "utils/stringutils.h"
+
+#include <chrono>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <vector>
 
 namespace Core {
 
-class BookmarkItem : public IMenuItem {
+/// A bookmark, copied out of the item store of BookmarkItemsModel.
+class BookmarkItem {
 public:
     class HandlerHint
     {
     public:
         HandlerHint(const std::string &path);
+        explicit HandlerHint(const Utils::FileUtils::FileInfo &fileInfo);
 
         enum Hint {
             NoHandlerHint,
@@ -23,30 +37,132 @@ public:
         } hint;
     };
 
-    BookmarkItem(const std::string name, const std::string path) : m_name(name), m_path(path) {}
+    BookmarkItem(const ItemStore &store, uint32_t row);
     std::string identifier() const { return m_name; }
     std::string path() const { return m_path; }
-    std::string pathDisplayed() const;
 
 private:
-    const std::string m_name;
-    const std::string m_path;
+    std::string m_name;
+    std::string m_path;
 };
 
-using BookmarkItemPointer = std::shared_ptr<BookmarkItem>;
+struct BookmarkItemsStorage;
+struct BookmarkRecord;
 
+/// Reads the bookmark file relative to $HOME. A binary image of the parsed file is
+/// kept next to it (see BookmarkIndex) and used instead of parsing as long as it is
+/// up to date. The item store refers into that image.
+///
+/// Without an up to date index, the file can be loaded progressively: Then the store
+/// is filled chunk by chunk by fetchMore() and the index is built at the end.
+///
+/// Bookmarks in a section (see BookmarkSection) are scoped to its directory. The
+/// ones active in the current directory have a priority, the more specific the
+/// scope the higher. The scopes are looked up in a PathTrie.
 class BookmarkItemsModel: public IModel
 {
 public:
-    BookmarkItemsModel(const std::string &bookmarkFilePath, bool refresh = true);
+    enum IndexMode { UseIndex, RebuildIndex };
+    enum LoadMode { LoadAtOnce, LoadProgressively };
+
+    BookmarkItemsModel(const std::string &bookmarkFilePath, bool refresh = true,
+                       IndexMode indexMode = UseIndex, LoadMode loadMode = LoadAtOnce);
+    ~BookmarkItemsModel();
+
+    const ItemStore &items();
+    bool reload(ItemsUpdate &update);
+    unsigned identifierColumnWidth();
+
+    bool canFetchMore();
+    void fetchMore(ItemsUpdate &update);
+    unsigned fetchProgress();
 
-    MenuItems items(bool refresh = false);
+    /// Watch the bookmark file and reload it in a background thread on changes.
+    /// Returns false if the file cannot be watched.
+    bool startWatching();
+    int notificationDescriptor();
+    bool takeChanges(ItemsUpdate &update);
+
+    /// The paths of the items are validated in the background right after
+    /// loading them. The time it takes is logged.
+    int fileInfoNotificationDescriptor();
+    bool takeFileInfos();
+    bool fileInfo(uint32_t row, Utils::FileUtils::FileInfo &info);
+    void revalidate();
+
+    /// Activates the sections scoped to directory or to a parent of it.
+    void setCurrentDirectory(const std::string &directory);
+    bool hasPriorities();
+    unsigned priority(uint32_t row);
+    /// Rows of the bookmarks active in directory: The scoped ones, the most specific
+    /// scope first, followed by the unscoped ones. Without headers and separators.
+    std::vector<uint32_t> activeItems(const std::string &directory) const;
 
 private:
-    void readBookmarksFromFile();
+    struct Loading;
+
+    void readBookmarksFromFile(LoadMode loadMode);
+    bool computeReload(const std::shared_ptr<BookmarkItemsStorage> &base,
+                       std::shared_ptr<BookmarkItemsStorage> &result,
+                       ItemsUpdate &update) const;
+    std::shared_ptr<BookmarkItemsStorage> readIndex(const std::string &indexFilePath,
+                                                    const std::string &homePath) const;
+    std::shared_ptr<BookmarkItemsStorage> buildIndex(const std::string &indexFilePath,
+                                                     const std::string &homePath,
+                                                     const Utils::FileUtils::MappedFile &source,
+                                                     std::vector<BookmarkRecord> &records) const;
+    void setStorage(const std::shared_ptr<BookmarkItemsStorage> &storage);
+    void setInitialStorage(const std::shared_ptr<BookmarkItemsStorage> &storage);
+
+    std::shared_ptr<BookmarkItemsStorage> latestStorage();
+    bool offerChanges(const std::shared_ptr<BookmarkItemsStorage> &base,
+                      const std::shared_ptr<BookmarkItemsStorage> &result,
+                      const ItemsUpdate &changes);
+    void watch();
+    void updateFileInfos(const ItemsUpdate &update);
+    void validatePaths(uint32_t beginRow, uint32_t endRow);
+    void addSection(uint32_t row, const std::string &scope);
+    void activateSections();
 
     std::string m_bookmarkFilePath;
-    MenuItems m_items;
+    IndexMode m_indexMode;
+    LoadMode m_loadMode;
+    std::unique_ptr<Loading> m_loading; // Set while loading progressively
+    std::shared_ptr<BookmarkItemsStorage> m_storage; // The one the store refers to
+    ItemStore m_store;
+
+    // Reloads can happen in the watch thread, they are handed over by takeChanges().
+    std::mutex m_mutex;
+    std::shared_ptr<BookmarkItemsStorage> m_latestStorage; // Guarded by m_mutex
+    bool m_hasChanges;                                      // Guarded by m_mutex
+    ItemsUpdate m_changes;                                  // Guarded by m_mutex
+    unsigned m_changesBaseCount;                            // Guarded by m_mutex
+
+    std::unique_ptr<Utils::FileWatcher> m_watcher;
+    std::unique_ptr<Utils::Notifier> m_notifier;
+    std::unique_ptr<Utils::Notifier> m_stopNotifier;
+    std::thread m_watchThread;
+
+    std::unique_ptr<PathValidator> m_pathValidator;
+    std::vector<Utils::FileUtils::FileInfo> m_fileInfos; // Per row, not probed until validated
+    unsigned m_validationGeneration; // Changes when rows move, results for others are dropped
+    uint32_t m_pendingValidationCount;
+    std::chrono::steady_clock::time_point m_validationStart;
+    uint32_t m_validatedCount;
+    uint32_t m_missingCount;
+
+    struct Section
+    {
+        uint32_t firstRow;
+        uint32_t endRow;
+        std::string scope;
+    };
+
+    std::vector<Section> m_sections; // Scoped ones, by row
+    Utils::PathTrie m_scopes;        // Indices of m_sections
+    std::string m_currentDirectory;
+    std::vector<unsigned> m_sectionPriorities; // For m_currentDirectory, 0 if inactive
+    bool m_hasActiveSections;
 };
 
 } // namespace Core
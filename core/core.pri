@@ -1,7 +1,34 @@
 SOURCES += \
-    $$PWD/bookmarkitemsmodel.cpp
+    $$PWD/bookmarkindex.cpp \
+    $$PWD/bookmarkitemsmodel.cpp \
+    $$PWD/directoryitemsmodel.cpp \
+    $$PWD/filterworker.cpp \
+    $$PWD/findfilesmodel.cpp \
+    $$PWD/fuzzymatcher.cpp \
+    $$PWD/itemfilter.cpp \
+    $$PWD/itemhaystack.cpp \
+    $$PWD/itemstore.cpp \
+    $$PWD/locateindex.cpp \
+    $$PWD/locateitemsmodel.cpp \
+    $$PWD/pathvalidator.cpp \
+    $$PWD/patternmatcher.cpp \
+    $$PWD/selectionhistory.cpp \
+    $$PWD/trigramindex.cpp
 
 HEADERS += \
-    $$PWD/imenuitem.h \
+    $$PWD/bookmarkindex.h \
+    $$PWD/directoryitemsmodel.h \
+    $$PWD/filterworker.h \
+    $$PWD/findfilesmodel.h \
+    $$PWD/fuzzymatcher.h \
     $$PWD/imodel.h \
+    $$PWD/itemfilter.h \
+    $$PWD/itemhaystack.h \
+    $$PWD/itemstore.h \
+    $$PWD/locateindex.h \
+    $$PWD/locateitemsmodel.h \
+    $$PWD/pathvalidator.h \
+    $$PWD/patternmatcher.h \
+    $$PWD/selectionhistory.h \
+    $$PWD/trigramindex.h \
     $$PWD/bookmarkitemsmodel.h
@@ -0,0 +1,258 @@
+#include "directoryitemsmodel.h"
+
+#include "utils/debugutils.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace Core {
+
+using Utils::StringUtils::StringRef;
+
+namespace {
+
+/// Bytes read per getdents64(), some thousand entries.
+const std::size_t ReadSize = 256 * 1024;
+/// Directories with up to this many entries are read at once and sorted.
+const std::size_t SortedEntryCount = 8192;
+
+struct LinuxDirectoryEntry
+{
+    uint64_t inode;
+    int64_t offset;
+    unsigned short recordLength;
+    unsigned char type;
+    char name[1];
+};
+
+} // anonymous
+
+DirectoryItemsModel::DirectoryItemsModel()
+    : m_homePath(std::getenv("HOME") ? std::getenv("HOME") : "")
+    , m_listing(std::make_shared<Listing>())
+    , m_directoryDescriptor(-1)
+    , m_directorySize(0)
+    , m_readSize(0)
+{
+}
+
+DirectoryItemsModel::~DirectoryItemsModel()
+{
+    if (m_directoryDescriptor != -1)
+        close(m_directoryDescriptor);
+}
+
+bool DirectoryItemsModel::setDirectory(const std::string &path)
+{
+    const int directoryDescriptor = open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (directoryDescriptor == -1)
+        return false;
+    struct stat s;
+    if (fstat(directoryDescriptor, &s) == -1) {
+        close(directoryDescriptor);
+        return false;
+    }
+
+    finishReading(false);
+    m_directory = path.size() > 1 && path[path.size() - 1] == '/'
+        ? path.substr(0, path.size() - 1) : path;
+
+    const Utils::FileUtils::FileStamp stamp(s);
+    m_listing = cachedListing(stamp);
+    if (m_listing) {
+        close(directoryDescriptor);
+        return true;
+    }
+
+    m_listing = std::make_shared<Listing>();
+    m_listing->stamp = stamp;
+    m_directoryDescriptor = directoryDescriptor;
+    m_directorySize = s.st_size;
+    m_readSize = 0;
+
+    // Have the first screen ready right away, sorted if possible.
+    std::vector<Entry> entries;
+    while (entries.size() < SortedEntryCount && readEntries(entries)) {}
+    if (m_directoryDescriptor == -1) {
+        const char *names = m_names.data();
+        std::sort(entries.begin(), entries.end(), [names](const Entry &lhs, const Entry &rhs) {
+            const bool isLhsDirectory = lhs.type == DT_DIR;
+            if (isLhsDirectory != (rhs.type == DT_DIR))
+                return isLhsDirectory;
+            const char *lhsName = names + lhs.nameOffset;
+            const char *rhsName = names + rhs.nameOffset;
+            return std::lexicographical_compare(lhsName, lhsName + lhs.nameLength,
+                                                rhsName, rhsName + rhs.nameLength);
+        });
+    }
+    appendEntries(entries);
+    return true;
+}
+
+const ItemStore &DirectoryItemsModel::items()
+{
+    return m_listing->store;
+}
+
+bool DirectoryItemsModel::reload(ItemsUpdate &update)
+{
+    const uint32_t oldCount = m_listing->store.size();
+    const Utils::FileUtils::FileStamp oldStamp = m_listing->stamp;
+    if (m_directory.empty() || ! setDirectory(m_directory) || m_listing->stamp == oldStamp)
+        return false;
+
+    update = ItemsUpdate();
+    update.removedCount = oldCount;
+    update.insertedCount = m_listing->store.size();
+    return true;
+}
+
+unsigned DirectoryItemsModel::identifierColumnWidth()
+{
+    return m_listing->identifierColumnWidth;
+}
+
+bool DirectoryItemsModel::canFetchMore()
+{
+    return m_directoryDescriptor != -1;
+}
+
+void DirectoryItemsModel::fetchMore(ItemsUpdate &update)
+{
+    update = ItemsUpdate();
+    update.firstRow = m_listing->store.size();
+    std::vector<Entry> entries;
+    readEntries(entries);
+    appendEntries(entries);
+    update.insertedCount = m_listing->store.size() - update.firstRow;
+}
+
+unsigned DirectoryItemsModel::fetchProgress()
+{
+    // The size of a directory is just roughly proportional to its entries.
+    if (m_directoryDescriptor == -1 || m_directorySize == 0)
+        return 100;
+    return std::min<uint64_t>(99, m_readSize * 100 / m_directorySize);
+}
+
+bool DirectoryItemsModel::fileInfo(uint32_t row, Utils::FileUtils::FileInfo &info)
+{
+    if (row >= m_listing->types.size() || m_listing->types[row] != DT_DIR)
+        return false;
+    info = Utils::FileUtils::FileInfo();
+    info.isProbed = true;
+    info.exists = true;
+    info.isDirectory = true;
+    return true;
+}
+
+std::string DirectoryItemsModel::title()
+{
+    std::string title = "Browse: ";
+    Utils::FileUtils::appendPathDisplayed(title, StringRef(m_directory.data(), m_directory.size()),
+                                          m_homePath);
+    return title;
+}
+
+/// Reads the next batch of entries. Returns false once all are read.
+bool DirectoryItemsModel::readEntries(std::vector<Entry> &entries)
+{
+    if (m_directoryDescriptor == -1)
+        return false;
+
+    m_buffer.resize(ReadSize);
+    const long readSize = syscall(SYS_getdents64, m_directoryDescriptor, m_buffer.data(),
+                                  m_buffer.size());
+    if (readSize <= 0) {
+        if (readSize == -1)
+            Utils::DebugUtils::debug() << "Could not read directory" << m_directory;
+        finishReading(readSize == 0);
+        return false;
+    }
+    m_readSize += readSize;
+
+    if (entries.empty())
+        m_names.clear();
+    for (long position = 0; position < readSize; ) {
+        const LinuxDirectoryEntry *entry
+            = reinterpret_cast<const LinuxDirectoryEntry *>(m_buffer.data() + position);
+        position += entry->recordLength;
+        const std::size_t nameLength = std::strlen(entry->name);
+        if (entry->name[0] == '.' && (nameLength == 1 || (nameLength == 2 && entry->name[1] == '.')))
+            continue;
+
+        Entry result;
+        result.nameOffset = m_names.size();
+        result.nameLength = nameLength;
+        result.type = entry->type;
+        m_names.append(entry->name, nameLength);
+        entries.push_back(result);
+    }
+    return true;
+}
+
+void DirectoryItemsModel::appendEntries(const std::vector<Entry> &entries)
+{
+    Listing &listing = *m_listing;
+    const std::string separator = m_directory == "/" ? "" : "/";
+    std::string path;
+    std::string pathDisplayed;
+    std::string identifier;
+    for (const Entry &entry : entries) {
+        identifier.assign(m_names, entry.nameOffset, entry.nameLength);
+        if (entry.type == DT_DIR)
+            identifier.push_back('/');
+        path = m_directory + separator + identifier;
+        pathDisplayed.clear();
+        Utils::FileUtils::appendPathDisplayed(pathDisplayed, StringRef(path.data(), path.size()),
+                                              m_homePath);
+        if (entry.type == DT_DIR)
+            path.resize(path.size() - 1);
+        listing.store.append(StringRef(identifier.data(), identifier.size()),
+                             StringRef(path.data(), path.size()),
+                             StringRef(pathDisplayed.data(), pathDisplayed.size()));
+        listing.types.push_back(entry.type);
+        listing.identifierColumnWidth = std::max<unsigned>(listing.identifierColumnWidth,
+                                                           identifier.size());
+    }
+}
+
+/// Stops reading, a complete listing is cached.
+void DirectoryItemsModel::finishReading(bool isComplete)
+{
+    if (m_directoryDescriptor == -1)
+        return;
+    close(m_directoryDescriptor);
+    m_directoryDescriptor = -1;
+    m_buffer = std::vector<char>();
+
+    if (isComplete && ! cachedListing(m_listing->stamp)) {
+        if (m_cachedListings.size() == MaximumCachedListingCount)
+            m_cachedListings.pop_front();
+        m_cachedListings.push_back(m_listing);
+    }
+}
+
+/// Returns the cached listing of the directory in the given state, if any.
+std::shared_ptr<DirectoryItemsModel::Listing> DirectoryItemsModel::cachedListing(
+        const Utils::FileUtils::FileStamp &stamp)
+{
+    for (auto it = m_cachedListings.begin(); it != m_cachedListings.end(); ++it) {
+        if ((*it)->stamp == stamp) {
+            const std::shared_ptr<Listing> listing = *it;
+            m_cachedListings.erase(it);
+            m_cachedListings.push_back(listing);
+            return listing;
+        }
+    }
+    return std::shared_ptr<Listing>();
+}
+
+} // namespace Core
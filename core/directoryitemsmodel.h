@@ -0,0 +1,95 @@
+#ifndef DIRECTORYITEMSMODEL_H
+#define DIRECTORYITEMSMODEL_H
+
+#include "imodel.h"
+#include "itemstore.h"
+
+#include "utils/fileutils.h"
+#include "utils/stringutils.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Core {
+
+/// Lists the entries of a directory for browsing, without "." and "..".
+///
+/// The entries are read with getdents64() in large batches and handed out
+/// progressively (see canFetchMore()), so even huge directories show up at once.
+/// Directories read with the first batches are sorted, directories first.
+/// Bigger ones are listed in the order of the file system.
+///
+/// Complete listings are kept per inode and modification time, so going back
+/// to a directory does not read it again.
+class DirectoryItemsModel : public IModel
+{
+public:
+    DirectoryItemsModel();
+    ~DirectoryItemsModel();
+
+    /// Returns false if path cannot be opened as directory, then the current
+    /// directory stays.
+    bool setDirectory(const std::string &path);
+    std::string directory() const { return m_directory; }
+
+    const ItemStore &items();
+    bool reload(ItemsUpdate &update);
+    unsigned identifierColumnWidth();
+
+    bool canFetchMore();
+    void fetchMore(ItemsUpdate &update);
+    unsigned fetchProgress();
+
+    /// Known for directories, others are up to the FileInfoCache.
+    bool fileInfo(uint32_t row, Utils::FileUtils::FileInfo &info);
+    std::string title();
+
+private:
+    DirectoryItemsModel(const DirectoryItemsModel &) = delete;
+    DirectoryItemsModel &operator=(const DirectoryItemsModel &) = delete;
+
+    struct Listing
+    {
+        Listing() : identifierColumnWidth(0) {}
+
+        Utils::FileUtils::FileStamp stamp;
+        ItemStore store;
+        std::vector<uint8_t> types; ///< d_type per row
+        unsigned identifierColumnWidth;
+    };
+
+    struct Entry
+    {
+        uint32_t nameOffset; ///< Into m_names
+        uint32_t nameLength;
+        uint8_t type;
+    };
+
+    bool readEntries(std::vector<Entry> &entries);
+    void appendEntries(const std::vector<Entry> &entries);
+    void finishReading(bool isComplete);
+    std::shared_ptr<Listing> cachedListing(const Utils::FileUtils::FileStamp &stamp);
+
+    /// Complete listings kept, the most recently used last
+    static const std::size_t MaximumCachedListingCount = 16;
+
+    std::string m_directory;
+    std::string m_homePath;
+    std::shared_ptr<Listing> m_listing;
+    std::deque<std::shared_ptr<Listing>> m_cachedListings;
+
+    // While reading
+    int m_directoryDescriptor;
+    uint64_t m_directorySize;
+    uint64_t m_readSize;
+    std::vector<char> m_buffer;
+    std::string m_names;
+};
+
+} // namespace Core
+
+#endif // DIRECTORYITEMSMODEL_H
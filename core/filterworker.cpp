@@ -0,0 +1,91 @@
+#include "filterworker.h"
+
+namespace Core {
+
+FilterWorker::FilterWorker(ItemFilter &filter) throw(std::runtime_error)
+    : m_filter(filter)
+    , m_isCanceled(false)
+    , m_hasJob(false)
+    , m_isRunning(false)
+    , m_isStopping(false)
+{
+    m_filter.setCancellationCheck([this]() { return m_isCanceled.load(); });
+    m_thread = std::thread(&FilterWorker::work, this);
+}
+
+FilterWorker::~FilterWorker()
+{
+    {
+        std::lock_guard<std::mutex> locker(m_mutex);
+        m_isStopping = true;
+        m_hasJob = false;
+        m_isCanceled = true;
+    }
+    m_jobAdded.notify_one();
+    m_thread.join();
+    m_filter.setCancellationCheck(std::function<bool()>());
+}
+
+void FilterWorker::run(const Job &job)
+{
+    {
+        std::lock_guard<std::mutex> locker(m_mutex);
+        m_job = job;
+        m_hasJob = true;
+        m_isCanceled = m_isRunning;
+    }
+    m_jobAdded.notify_one();
+}
+
+bool FilterWorker::isBusy()
+{
+    std::lock_guard<std::mutex> locker(m_mutex);
+    return m_hasJob || m_isRunning;
+}
+
+void FilterWorker::wait()
+{
+    std::unique_lock<std::mutex> locker(m_mutex);
+    m_jobsDone.wait(locker, [this]() { return ! m_hasJob && ! m_isRunning; });
+}
+
+void FilterWorker::cancel()
+{
+    std::unique_lock<std::mutex> locker(m_mutex);
+    m_hasJob = false;
+    m_isCanceled = m_isRunning;
+    m_jobsDone.wait(locker, [this]() { return ! m_isRunning; });
+    m_isCanceled = false;
+}
+
+void FilterWorker::work()
+{
+    for (;;) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> locker(m_mutex);
+            m_jobAdded.wait(locker, [this]() { return m_isStopping || m_hasJob; });
+            if (m_isStopping)
+                return;
+            job = m_job;
+            m_hasJob = false;
+            m_isRunning = true;
+            m_isCanceled = false;
+        }
+
+        job(m_filter);
+
+        bool isDone;
+        {
+            std::lock_guard<std::mutex> locker(m_mutex);
+            m_isRunning = false;
+            isDone = ! m_hasJob;
+        }
+        if (isDone) {
+            m_jobsDone.notify_all();
+            m_notifier.notify();
+        }
+    }
+}
+
+} // namespace Core
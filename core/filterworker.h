@@ -0,0 +1,65 @@
+#ifndef FILTERWORKER_H
+#define FILTERWORKER_H
+
+#include "itemfilter.h"
+
+#include "utils/notifier.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+namespace Core {
+
+/// Runs jobs on an ItemFilter in a thread of its own, so the UI thread keeps on
+/// reading keys while filtering. Only the latest job matters: Running a job
+/// cancels the running one and drops a waiting one. A canceled filter is left
+/// incomplete (see ItemFilter::isComplete()), the next job resumes it.
+///
+/// While isBusy(), the worker thread owns the filter. Use it in the calling thread
+/// only after wait() or cancel().
+class FilterWorker
+{
+public:
+    using Job = std::function<void(ItemFilter &filter)>;
+
+    explicit FilterWorker(ItemFilter &filter) throw(std::runtime_error);
+    ~FilterWorker();
+
+    /// Readable once the last job is done, then call clearNotification().
+    int notificationDescriptor() const { return m_notifier.fileDescriptor(); }
+    void clearNotification() { m_notifier.clear(); }
+
+    void run(const Job &job);
+    bool isBusy();
+    /// Returns once the jobs are done.
+    void wait();
+    /// Cancels the jobs and returns once the filter is not used anymore.
+    void cancel();
+
+private:
+    FilterWorker(const FilterWorker &) = delete;
+    FilterWorker &operator=(const FilterWorker &) = delete;
+
+    void work();
+
+    ItemFilter &m_filter;
+    std::atomic<bool> m_isCanceled;
+    Utils::Notifier m_notifier;
+
+    std::mutex m_mutex;
+    std::condition_variable m_jobAdded;
+    std::condition_variable m_jobsDone;
+    Job m_job;          // Guarded by m_mutex
+    bool m_hasJob;      // Guarded by m_mutex
+    bool m_isRunning;   // Guarded by m_mutex
+    bool m_isStopping;  // Guarded by m_mutex
+    std::thread m_thread;
+};
+
+} // namespace Core
+
+#endif // FILTERWORKER_H
@@ -0,0 +1,134 @@
+#include "findfilesmodel.h"
+
+#include "utils/debugutils.h"
+#include "utils/stringutils.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+#include <dirent.h>
+
+namespace Core {
+
+using Utils::FileUtils::DirectoryWalker;
+using Utils::StringUtils::StringRef;
+
+FindFilesModel::FindFilesModel(unsigned maximumDepth, uint32_t maximumItemCount)
+    : m_maximumDepth(maximumDepth)
+    , m_maximumItemCount(maximumItemCount)
+    , m_homePath(std::getenv("HOME") ? std::getenv("HOME") : "")
+    , m_isWalking(false)
+    , m_isTruncated(false)
+    , m_identifierColumnWidth(0)
+{
+}
+
+void FindFilesModel::find(const std::string &directory)
+{
+    m_directory = directory.size() > 1 && directory[directory.size() - 1] == '/'
+        ? directory.substr(0, directory.size() - 1) : directory;
+    m_store.clear();
+    m_types.clear();
+    m_identifierColumnWidth = 0;
+    m_isTruncated = false;
+    m_walker.reset(); // Canceled
+    m_walker.reset(new DirectoryWalker(m_directory, m_maximumDepth, m_maximumItemCount));
+    m_isWalking = true;
+}
+
+void FindFilesModel::cancel()
+{
+    if (m_walker)
+        m_walker->cancel();
+    m_isWalking = false;
+}
+
+const ItemStore &FindFilesModel::items()
+{
+    return m_store;
+}
+
+bool FindFilesModel::reload(ItemsUpdate &update)
+{
+    if (m_directory.empty())
+        return false;
+    update = ItemsUpdate();
+    update.removedCount = m_store.size();
+    find(m_directory);
+    return true;
+}
+
+unsigned FindFilesModel::identifierColumnWidth()
+{
+    return m_identifierColumnWidth;
+}
+
+int FindFilesModel::notificationDescriptor()
+{
+    return m_isWalking ? m_walker->notificationDescriptor() : -1;
+}
+
+bool FindFilesModel::takeChanges(ItemsUpdate &update)
+{
+    if (! m_isWalking)
+        return false;
+
+    // Checked before taking, so no batch is left behind once finished.
+    const bool isFinished = m_walker->isFinished();
+    const std::vector<DirectoryWalker::Batch> batches = m_walker->takeBatches();
+    update = ItemsUpdate();
+    update.firstRow = m_store.size();
+
+    // The displayed paths are relative to the directory walked, which is in the title.
+    const std::size_t prefixLength = m_directory == "/" ? 1 : m_directory.size() + 1;
+    std::string identifier;
+    for (const DirectoryWalker::Batch &batch : batches) {
+        for (const DirectoryWalker::Entry &entry : batch.entries) {
+            const char *path = batch.paths.data() + entry.pathOffset;
+            identifier.assign(path + entry.pathLength - entry.nameLength, entry.nameLength);
+            if (entry.type == DT_DIR)
+                identifier.push_back('/');
+            m_store.append(StringRef(identifier.data(), identifier.size()),
+                           StringRef(path, entry.pathLength),
+                           StringRef(path + prefixLength, entry.pathLength - prefixLength));
+            m_types.push_back(entry.type);
+            m_identifierColumnWidth = std::max<unsigned>(m_identifierColumnWidth, identifier.size());
+        }
+    }
+    update.insertedCount = m_store.size() - update.firstRow;
+
+    if (isFinished) {
+        m_isWalking = false;
+        m_isTruncated = m_walker->isTruncated();
+        m_walker.reset();
+        Utils::DebugUtils::debug() << "Found" << int(m_store.size()) << "files in" << m_directory;
+    }
+    // The title changes when finished.
+    return update.insertedCount != 0 || isFinished;
+}
+
+bool FindFilesModel::fileInfo(uint32_t row, Utils::FileUtils::FileInfo &info)
+{
+    if (row >= m_types.size() || m_types[row] != DT_DIR)
+        return false;
+    info = Utils::FileUtils::FileInfo();
+    info.isProbed = true;
+    info.exists = true;
+    info.isDirectory = true;
+    return true;
+}
+
+std::string FindFilesModel::title()
+{
+    std::string title = "Find Files: ";
+    Utils::FileUtils::appendPathDisplayed(title, StringRef(m_directory.data(), m_directory.size()),
+                                          m_homePath);
+    title += " | " + std::to_string(m_store.size()) + " found";
+    if (m_isWalking)
+        title += ", searching...";
+    else if (m_isTruncated)
+        title += ", stopped at the limit";
+    return title;
+}
+
+} // namespace Core
@@ -0,0 +1,70 @@
+#ifndef FINDFILESMODEL_H
+#define FINDFILESMODEL_H
+
+#include "imodel.h"
+#include "itemstore.h"
+
+#include "utils/directorywalker.h"
+#include "utils/fileutils.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Core {
+
+/// Lists the files and directories below a directory, recursively. They are
+/// found by a Utils::FileUtils::DirectoryWalker in the background and show up
+/// as they are found (see takeChanges()), so they are filtered while walking.
+class FindFilesModel : public IModel
+{
+public:
+    /// Defaults that keep memory and time in bounds even when started at "/".
+    static const unsigned DefaultMaximumDepth = 32;
+    static const uint32_t DefaultMaximumItemCount = 1000000;
+
+    explicit FindFilesModel(unsigned maximumDepth = DefaultMaximumDepth,
+                            uint32_t maximumItemCount = DefaultMaximumItemCount);
+
+    /// Cancels a running walk and starts walking directory.
+    void find(const std::string &directory);
+    std::string directory() const { return m_directory; }
+    /// Stops walking, the items found so far are kept.
+    void cancel();
+
+    const ItemStore &items();
+    /// Walks the directory again.
+    bool reload(ItemsUpdate &update);
+    unsigned identifierColumnWidth();
+
+    /// Readable once more items are found.
+    int notificationDescriptor();
+    /// The items found meanwhile are appended.
+    bool takeChanges(ItemsUpdate &update);
+
+    /// Known for directories, others are up to the FileInfoCache.
+    bool fileInfo(uint32_t row, Utils::FileUtils::FileInfo &info);
+    std::string title();
+
+private:
+    FindFilesModel(const FindFilesModel &) = delete;
+    FindFilesModel &operator=(const FindFilesModel &) = delete;
+
+    const unsigned m_maximumDepth;
+    const uint32_t m_maximumItemCount;
+    const std::string m_homePath;
+
+    std::string m_directory;
+    std::unique_ptr<Utils::FileUtils::DirectoryWalker> m_walker;
+    bool m_isWalking;
+    bool m_isTruncated;
+
+    ItemStore m_store;
+    std::vector<uint8_t> m_types; ///< d_type per row
+    unsigned m_identifierColumnWidth;
+};
+
+} // namespace Core
+
+#endif // FINDFILESMODEL_H
@@ -0,0 +1,84 @@
+#include "fuzzymatcher.h"
+
+#include <cstring>
+
+namespace Core {
+
+namespace {
+
+const int ScoreMatch = 16;
+const int BonusBoundary = 8;    // Match at the start of a path component or word
+const int BonusName = 4;        // Match in the identifier or the last path component
+const int BonusConsecutive = 6; // Match directly following the previous one
+const int PenaltyGapStart = 3;
+const int PenaltyGapExtension = 1;
+
+bool isBoundary(char c)
+{
+    return c == '/' || c == '\0' || c == ' ' || c == '_' || c == '-' || c == '.';
+}
+
+} // anonymous
+
+FuzzyMatcher::FuzzyMatcher(const std::string &pattern)
+    : m_pattern(pattern)
+{
+}
+
+int FuzzyMatcher::score(const char *text, const char *end, std::vector<uint32_t> *positions) const
+{
+    if (m_pattern.empty())
+        return 1;
+
+    // Find the end of the first match. memchr() rejects most texts fast.
+    const char *position = text;
+    for (const char c : m_pattern) {
+        position = static_cast<const char *>(std::memchr(position, c, end - position));
+        if (! position)
+            return 0;
+        ++position;
+    }
+
+    // Walk back to the start of the shortest window ending there.
+    for (std::string::const_reverse_iterator c = m_pattern.rbegin(); c != m_pattern.rend(); ++c) {
+        --position;
+        while (*position != *c)
+            --position;
+    }
+    const char *const windowBegin = position;
+
+    // The name is the identifier or the last component of the displayed path.
+    const char *const identifierEnd = static_cast<const char *>(std::memchr(text, '\0', end - text));
+    const char *nameBegin = end - 1; // The terminating 0 of the path
+    while (nameBegin > identifierEnd + 1 && nameBegin[-1] != '/')
+        --nameBegin;
+
+    int score = 0;
+    const char *previousMatch = 0;
+    position = windowBegin;
+    for (const char c : m_pattern) {
+        while (*position != c)
+            ++position;
+
+        score += ScoreMatch;
+        if (position == text || isBoundary(position[-1]))
+            score += BonusBoundary;
+        if (position < identifierEnd || position >= nameBegin)
+            score += BonusName;
+        if (previousMatch) {
+            const std::ptrdiff_t gap = position - previousMatch - 1;
+            if (gap == 0)
+                score += BonusConsecutive;
+            else
+                score -= PenaltyGapStart + (gap - 1) * PenaltyGapExtension;
+        }
+        if (positions)
+            positions->push_back(position - text);
+
+        previousMatch = position++;
+    }
+
+    return score > 0 ? score : 1;
+}
+
+} // namespace Core
@@ -0,0 +1,34 @@
+#ifndef FUZZYMATCHER_H
+#define FUZZYMATCHER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace Core {
+
+/// Scores the occurrence of a pattern as subsequence of the text of an item, see
+/// ItemHaystack: The identifier and the displayed path, each terminated by a 0 byte.
+///
+/// Of the matched characters, those at the start of a path component or word,
+/// those in the identifier or in the last path component, and those following
+/// another matched character score higher. Gaps cost a little.
+///
+/// Like fzf's fast mode, the shortest window ending at the first complete match is
+/// scored instead of all alignments, so scoring is linear in the text length.
+class FuzzyMatcher
+{
+public:
+    explicit FuzzyMatcher(const std::string &pattern);
+
+    /// Returns 0 if the pattern does not match, otherwise a positive score. The
+    /// offsets of the matched characters are appended to positions, if given.
+    int score(const char *text, const char *end, std::vector<uint32_t> *positions = 0) const;
+
+private:
+    std::string m_pattern;
+};
+
+} // namespace Core
+
+#endif // FUZZYMATCHER_H
@@ -1,14 +1,83 @@
 #ifndef IMODEL_H
 #define IMODEL_H
 
-#include "imenuitem.h"
+#include "itemfilter.h"
+#include "itemstore.h"
+
+#include "utils/fileutils.h"
+
+#include <string>
 
 namespace Core {
 
+/// Describes a change of the items: The rows [firstRow, firstRow + removedCount) of
+/// the old items were replaced by the rows [firstRow, firstRow + insertedCount).
+struct ItemsUpdate
+{
+    ItemsUpdate() : firstRow(0), removedCount(0), insertedCount(0) {}
+
+    unsigned firstRow;
+    unsigned removedCount;
+    unsigned insertedCount;
+};
+
 class IModel
 {
 public:
-    virtual MenuItems items(bool refresh) = 0;
+    virtual ~IModel() {}
+
+    /// Valid until the next reload() or takeChanges().
+    virtual const ItemStore &items() = 0;
+
+    /// Reread the items. Returns false if nothing changed.
+    virtual bool reload(ItemsUpdate &update) = 0;
+
+    /// Models of sources changing behind the back of the application notify about it:
+    /// The returned descriptor becomes readable once takeChanges() should be called.
+    /// -1 if the model does not notify.
+    virtual int notificationDescriptor() { return -1; }
+
+    /// Take over changes made in the background. Returns false if there are none.
+    virtual bool takeChanges(ItemsUpdate &update) { (void) update; return false; }
+
+    /// Models loading their items progressively hand them out in chunks: As long as
+    /// canFetchMore() is true, fetchMore() appends the next chunk of items.
+    virtual bool canFetchMore() { return false; }
+    virtual void fetchMore(ItemsUpdate &update) { update = ItemsUpdate(); }
+    /// Loading progress in percent.
+    virtual unsigned fetchProgress() { return 100; }
+
+    /// Models validating the paths of their items in the background: The
+    /// returned descriptor becomes readable once takeFileInfos() should be called.
+    virtual int fileInfoNotificationDescriptor() { return -1; }
+    /// Take over the file infos validated meanwhile. Returns false if there are none.
+    virtual bool takeFileInfos() { return false; }
+    /// Returns false if the path of row is not validated (yet).
+    virtual bool fileInfo(uint32_t row, Utils::FileUtils::FileInfo &info)
+    { (void) row; (void) info; return false; }
+    /// Validate all paths again, e.g. since they might have been changed
+    /// externally. The outdated file infos are kept until then.
+    virtual void revalidate() {}
+
+    /// Models of sources too big to be items as a whole, e.g. an index of all
+    /// files, search them themselves: Their items are matches of the filter
+    /// string, found in the background (see takeChanges()). The FilterMenu
+    /// filters these items as usual.
+    virtual void setFilter(const std::string &filterString, ItemFilter::Mode mode,
+                           ItemFilter::CaseSensitivity caseSensitivity)
+    { (void) filterString; (void) mode; (void) caseSensitivity; }
+
+    /// Rows of a higher priority are listed first, whatever the filter mode, e.g.
+    /// the bookmarks scoped to the current directory. priority() is only asked
+    /// if hasPriorities().
+    virtual bool hasPriorities() { return false; }
+    virtual unsigned priority(uint32_t row) { (void) row; return 0; }
+
+    /// Width of the widest identifier of all items.
+    virtual unsigned identifierColumnWidth() = 0;
+
+    /// Shown in the status bar, e.g. the browsed directory. Empty by default.
+    virtual std::string title() { return std::string(); }
 };
 
 } // namespace Core
@@ -0,0 +1,542 @@
+#include "itemfilter.h"
+
+#include "fuzzymatcher.h"
+
+#include "utils/debugutils.h"
+#include "utils/substringfinder.h"
+#include "utils/threadpool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <thread>
+
+namespace Core {
+
+namespace {
+
+/// Rows ranked per update, about a page of the menu.
+const uint32_t InitiallyRankedCount = 64;
+
+/// Below this number of candidate rows, one thread filters fast enough.
+const uint32_t ParallelThreshold = 65536;
+/// Rows per job when filtering in parallel. Cancellation is checked between jobs.
+const uint32_t ParallelChunkSize = 16384;
+
+/// Below this number of items, scanning them is fast enough.
+const uint32_t IndexThreshold = 500000;
+/// Rows indexed between cancellation checks.
+const uint32_t IndexChunkSize = 4096;
+/// The trigram index is used if it yields less than this part of the rows to filter.
+const uint32_t IndexSelectivity = 4;
+
+} // anonymous
+
+ItemFilter::ItemFilter(CaseSensitivity caseSensitivity)
+    : m_mode(SubstringMode)
+    , m_caseSensitivity(caseSensitivity)
+    , m_levels(1)
+    , m_items(0)
+    , m_rankedCount(0)
+{
+    m_levels.front().filterLength = 0;
+}
+
+/// Selects the next rows in place behind the ranked ones (see std::nth_element()) and
+/// sorts only those, so ranking a page costs O(n + page log page) instead of sorting
+/// all matches. Only the newly ranked rows are copied to m_rankedRows.
+void ItemFilter::rankRows(uint32_t count)
+{
+    if (! isRanking())
+        return;
+    count = std::min<uint32_t>(count, m_ranking.size());
+    if (count <= m_rankedCount)
+        return;
+
+    const std::vector<RankedRow>::iterator begin = m_ranking.begin() + m_rankedCount;
+    const std::vector<RankedRow>::iterator end = m_ranking.begin() + count;
+    std::nth_element(begin, end, m_ranking.end());
+    std::sort(begin, end);
+    for (uint32_t i = m_rankedCount; i < count; ++i)
+        m_rankedRows[i] = m_ranking[i].row;
+    m_rankedCount = count;
+}
+
+uint32_t ItemFilter::indexOf(uint32_t row)
+{
+    if (! isRanking()) {
+        const std::vector<uint32_t> &rows = m_levels.back().rows;
+        const std::vector<uint32_t>::const_iterator it = std::lower_bound(rows.begin(), rows.end(), row);
+        return it != rows.end() && *it == row ? it - rows.begin() : ItemStore::InvalidRow;
+    }
+
+    const std::vector<RankedRow>::const_iterator it = std::find_if(m_ranking.begin(), m_ranking.end(),
+        [row](const RankedRow &rankedRow) { return rankedRow.row == row; });
+    if (it == m_ranking.end())
+        return ItemStore::InvalidRow;
+    const uint32_t index = it - m_ranking.begin();
+    if (index < m_rankedCount)
+        return index;
+
+    // Rank up to the row, then it is behind all better ones.
+    const RankedRow rankedRow = *it;
+    const uint32_t rank = m_rankedCount + std::count_if(m_ranking.begin() + m_rankedCount,
+                                                        m_ranking.end(),
+        [&rankedRow](const RankedRow &other) { return other < rankedRow; });
+    rankRows(rank + 1);
+    return rank;
+}
+
+bool ItemFilter::setFilterString(const std::string &filterString)
+{
+    // Results for a common prefix of the old and the new filter string stay valid.
+    // With SmartCase, a prefix without upper case characters matched case insensitively,
+    // which still gives a superset of the rows matching the longer string.
+    // A pattern has to be matched anew on any change, though.
+    std::size_t commonLength;
+    if (isPatternMode()) {
+        commonLength = filterString == m_filterString ? filterString.size() : 0;
+    } else {
+        commonLength = std::mismatch(
+            m_filterString.begin(),
+            m_filterString.begin() + std::min(m_filterString.size(), filterString.size()),
+            filterString.begin()).first - m_filterString.begin();
+    }
+    while (m_levels.back().filterLength > commonLength)
+        m_levels.pop_back();
+
+    m_filterString = filterString;
+    const bool isCompleted = isComplete() || pushLevel(m_filterString.size());
+    updateRanking();
+    return isCompleted;
+}
+
+void ItemFilter::complete()
+{
+    if (isComplete())
+        return;
+
+    const std::function<bool()> isCanceled = m_isCanceled;
+    m_isCanceled = std::function<bool()>();
+    setFilterString(m_filterString);
+    m_isCanceled = isCanceled;
+}
+
+void ItemFilter::setCancellationCheck(const std::function<bool()> &isCanceled)
+{
+    m_isCanceled = isCanceled;
+}
+
+void ItemFilter::setMode(Mode mode)
+{
+    if (mode == m_mode)
+        return;
+    m_mode = mode;
+    refilter();
+}
+
+void ItemFilter::setCaseSensitivity(CaseSensitivity caseSensitivity)
+{
+    if (caseSensitivity == m_caseSensitivity)
+        return;
+    m_caseSensitivity = caseSensitivity;
+    refilter();
+}
+
+/// The matching rows stay the same, they are just ranked anew.
+void ItemFilter::setRowScores(const std::vector<double> &scores)
+{
+    m_rowScores = scores;
+    updateRanking();
+}
+
+bool ItemFilter::canIndexMore() const
+{
+    return m_items && m_items->size() >= IndexThreshold && m_index.rowCount() < m_items->size();
+}
+
+bool ItemFilter::updateIndex()
+{
+    while (canIndexMore()) {
+        if (m_isCanceled && m_isCanceled())
+            return false;
+        m_index.append(*m_items, std::min<uint32_t>(m_items->size(),
+                                                    m_index.rowCount() + IndexChunkSize));
+    }
+    return true;
+}
+
+void ItemFilter::reset(const ItemStore &items)
+{
+    m_items = &items;
+    m_haystack.clear();
+    m_index.clear();
+
+    Level &all = m_levels.front();
+    all.rows.clear();
+    all.rows.reserve(items.size());
+    for (uint32_t row = 0; row < items.size(); ++row)
+        all.rows.push_back(row);
+
+    refilter();
+}
+
+void ItemFilter::addRows(const ItemStore &items, uint32_t begin, uint32_t end)
+{
+    m_items = &items;
+    if (m_levels.size() > 1)
+        updateHaystack();
+    for (uint32_t row = begin; row < end; ++row)
+        m_levels.front().rows.push_back(row);
+
+    // Each level matches a subset of the rows of the previous one.
+    for (std::size_t i = 1; i < m_levels.size(); ++i) {
+        const std::size_t filterLength = m_levels[i].filterLength;
+        if (i == 1) {
+            filterInParallel(end - begin, [this, filterLength, begin](uint32_t chunkBegin,
+                                                                      uint32_t chunkEnd,
+                                                                      Level &chunk) {
+                scanRows(filterLength, begin + chunkBegin, begin + chunkEnd, chunk);
+            }, m_levels[i], NotCancelable);
+        } else {
+            const std::vector<uint32_t> &previousRows = m_levels[i - 1].rows;
+            const uint32_t *previousEnd = previousRows.data() + previousRows.size();
+            const uint32_t *added = std::lower_bound(previousRows.data(), previousEnd, begin);
+            filterInParallel(previousEnd - added, [this, filterLength, added](uint32_t chunkBegin,
+                                                                              uint32_t chunkEnd,
+                                                                              Level &chunk) {
+                filterRows(filterLength, added + chunkBegin, added + chunkEnd, chunk);
+            }, m_levels[i], NotCancelable);
+        }
+    }
+    updateRanking();
+}
+
+void ItemFilter::matchedCharacters(uint32_t row, std::vector<MatchedCharacter> &result) const
+{
+    // A glob matches the strings as a whole.
+    if (m_filterString.empty() || row >= m_haystack.size() || m_mode == GlobMode)
+        return;
+
+    const std::size_t filterLength = m_filterString.size();
+    const char *text = m_haystack.text(haystackCase(filterLength));
+    const char *rowBegin = text + m_haystack.rowOffset(row);
+    const char *rowEnd = text + m_haystack.rowOffset(row + 1);
+
+    std::vector<uint32_t> positions;
+    if (m_mode == RegexMode) {
+        if (! m_pattern)
+            return;
+        const char *identifierEnd =
+            static_cast<const char *>(std::memchr(rowBegin, '\0', rowEnd - rowBegin));
+        uint32_t matchBegin, matchEnd;
+        if (m_pattern->find(rowBegin, identifierEnd, matchBegin, matchEnd)) {
+            for (uint32_t position = matchBegin; position < matchEnd; ++position)
+                positions.push_back(position);
+        }
+        const char *pathBegin = identifierEnd + 1;
+        if (m_pattern->find(pathBegin, rowEnd - 1, matchBegin, matchEnd)) {
+            for (uint32_t position = matchBegin; position < matchEnd; ++position)
+                positions.push_back(pathBegin - rowBegin + position);
+        }
+    } else if (m_mode == FuzzyMode) {
+        FuzzyMatcher(needle(filterLength)).score(rowBegin, rowEnd, &positions);
+    } else if (const char *match = Utils::SubstringFinder(needle(filterLength)).find(rowBegin, rowEnd)) {
+        for (uint32_t i = 0; i < filterLength; ++i)
+            positions.push_back(match - rowBegin + i);
+    }
+
+    const uint32_t identifierSize = m_items->identifier(row).size();
+    for (const uint32_t position : positions) {
+        MatchedCharacter character;
+        if (position < identifierSize) {
+            character.column = ItemStore::Identifier;
+            character.offset = position;
+        } else {
+            character.column = ItemStore::PathDisplayed;
+            character.offset = position - identifierSize - 1;
+        }
+        result.push_back(character);
+    }
+}
+
+void ItemFilter::refilter()
+{
+    m_levels.resize(1);
+    if (! m_filterString.empty())
+        pushLevel(m_filterString.size());
+    updateRanking();
+}
+
+/// Narrow the current result to the rows matching the first filterLength characters.
+/// Returns false if canceled.
+bool ItemFilter::pushLevel(std::size_t filterLength)
+{
+    updateHaystack();
+    if (isPatternMode())
+        compilePattern(filterLength);
+
+    Level level;
+    level.filterLength = filterLength;
+    bool isCompleted;
+    std::vector<uint32_t> candidates;
+    if (findCandidates(filterLength, candidates)) {
+        const uint32_t *candidateRows = candidates.data();
+        isCompleted = filterInParallel(candidates.size(), [this, filterLength, candidateRows](
+                                           uint32_t begin, uint32_t end, Level &chunk) {
+            filterRows(filterLength, candidateRows + begin, candidateRows + end, chunk);
+        }, level, Cancelable);
+    } else if (m_levels.size() == 1) {
+        // All rows are candidates, so just scan the whole haystack.
+        isCompleted = filterInParallel(m_haystack.size(), [this, filterLength](uint32_t begin,
+                                                                              uint32_t end,
+                                                                              Level &chunk) {
+            scanRows(filterLength, begin, end, chunk);
+        }, level, Cancelable);
+    } else {
+        const uint32_t *previousRows = m_levels.back().rows.data();
+        isCompleted = filterInParallel(m_levels.back().rows.size(), [this, filterLength, previousRows](
+                                           uint32_t begin, uint32_t end, Level &chunk) {
+            filterRows(filterLength, previousRows + begin, previousRows + end, chunk);
+        }, level, Cancelable);
+    }
+
+    if (isCompleted)
+        m_levels.push_back(std::move(level));
+    return isCompleted;
+}
+
+/// Look up the rows possibly matching the first filterLength characters in the trigram
+/// index, plus the not yet indexed ones. Returns false if the index does not help.
+bool ItemFilter::findCandidates(std::size_t filterLength, std::vector<uint32_t> &candidates) const
+{
+    if (m_mode != SubstringMode || filterLength < TrigramIndex::MinimumNeedleSize
+            || m_index.rowCount() == 0) {
+        return false;
+    }
+
+    const std::vector<uint32_t> &previousRows = m_levels.back().rows;
+    if (! m_index.findCandidates(needle(filterLength), previousRows.size() / IndexSelectivity,
+                                 candidates)) {
+        return false;
+    }
+    candidates.insert(candidates.end(),
+                      std::lower_bound(previousRows.begin(), previousRows.end(), m_index.rowCount()),
+                      previousRows.end());
+    return true;
+}
+
+/// Calls filterChunk for [0, count) or, for many rows, for chunks of it in the threads
+/// of the global thread pool. The results are appended to level in order. Returns
+/// false if canceled, then level is untouched.
+bool ItemFilter::filterInParallel(uint32_t count, const ChunkFilter &filterChunk, Level &level,
+                                  Cancellation cancellation) const
+{
+    Utils::ThreadPool &threadPool = Utils::ThreadPool::globalInstance();
+    if (count < ParallelThreshold) {
+        filterChunk(0, count, level);
+        return true;
+    }
+
+    const unsigned chunkCount = (count + ParallelChunkSize - 1) / ParallelChunkSize;
+    std::vector<Level> chunks(chunkCount);
+    std::atomic<bool> isCanceled(false);
+    const std::thread::id callingThread = std::this_thread::get_id();
+    threadPool.parallelFor(chunkCount, [&](unsigned index) {
+        if (isCanceled)
+            return;
+        // The check is up to the caller, e.g. it might poll the terminal, so call
+        // it in the calling thread only.
+        if (cancellation == Cancelable && m_isCanceled && std::this_thread::get_id() == callingThread
+                && m_isCanceled()) {
+            isCanceled = true;
+            return;
+        }
+        const uint32_t begin = index * ParallelChunkSize;
+        filterChunk(begin, std::min(count, begin + ParallelChunkSize), chunks[index]);
+    });
+    if (isCanceled)
+        return false;
+
+    std::size_t matchCount = level.rows.size();
+    for (const Level &chunk : chunks)
+        matchCount += chunk.rows.size();
+    level.rows.reserve(matchCount);
+    if (m_mode == FuzzyMode)
+        level.scores.reserve(matchCount);
+    for (const Level &chunk : chunks) {
+        level.rows.insert(level.rows.end(), chunk.rows.begin(), chunk.rows.end());
+        level.scores.insert(level.scores.end(), chunk.scores.begin(), chunk.scores.end());
+    }
+    return true;
+}
+
+/// The haystack is only built once filtering starts, so showing all items stays fast.
+void ItemFilter::updateHaystack()
+{
+    assert(m_items);
+    if (m_haystack.size() < m_items->size())
+        m_haystack.append(*m_items, m_haystack.size(), m_items->size());
+}
+
+void ItemFilter::compilePattern(std::size_t filterLength)
+{
+    m_pattern.reset();
+    m_patternError.clear();
+    const PatternMatcher::Syntax syntax = m_mode == GlobMode ? PatternMatcher::Glob
+                                                             : PatternMatcher::RegularExpression;
+    const bool isCaseFolded = haystackCase(filterLength) == ItemHaystack::FoldedCase;
+    try {
+        m_pattern.reset(new PatternMatcher(m_filterString.substr(0, filterLength), syntax,
+                                           isCaseFolded));
+    } catch (const std::runtime_error &error) {
+        m_patternError = error.what();
+    }
+}
+
+/// Whether the identifier or the displayed path of the row text matches the pattern.
+bool ItemFilter::matchesPattern(const char *rowBegin, const char *rowEnd) const
+{
+    const char *identifierEnd =
+        static_cast<const char *>(std::memchr(rowBegin, '\0', rowEnd - rowBegin));
+    return m_pattern->matches(rowBegin, identifierEnd)
+        || m_pattern->matches(identifierEnd + 1, rowEnd - 1);
+}
+
+void ItemFilter::updateRanking()
+{
+    m_ranking.clear();
+    m_rankedRows.clear();
+    m_rankedCount = 0;
+    if (! isRanking())
+        return;
+
+    const Level &level = m_levels.back();
+    m_ranking.resize(level.rows.size());
+    for (std::size_t i = 0; i < level.rows.size(); ++i) {
+        const uint32_t row = level.rows[i];
+        m_ranking[i].rowScore = row < m_rowScores.size() ? m_rowScores[row] : 0;
+        m_ranking[i].score = i < level.scores.size() ? level.scores[i] : 0;
+        m_ranking[i].row = row;
+    }
+    m_rankedRows = level.rows;
+    rankRows(InitiallyRankedCount);
+}
+
+ItemHaystack::Case ItemFilter::haystackCase(std::size_t filterLength) const
+{
+    switch (m_caseSensitivity) {
+    case CaseSensitive:
+        return ItemHaystack::OriginalCase;
+    case CaseInsensitive:
+        return ItemHaystack::FoldedCase;
+    case SmartCase:
+        break;
+    }
+    for (std::size_t i = 0; i < filterLength; ++i) {
+        const char c = m_filterString[i];
+        if (c == '\\' && isPatternMode())
+            ++i; // Like \W
+        else if (c >= 'A' && c <= 'Z')
+            return ItemHaystack::OriginalCase;
+    }
+    return ItemHaystack::FoldedCase;
+}
+
+/// The prefix of the filter string to search for, folded if the folded text is searched.
+std::string ItemFilter::needle(std::size_t filterLength) const
+{
+    std::string needle = m_filterString.substr(0, filterLength);
+    if (haystackCase(filterLength) == ItemHaystack::FoldedCase) {
+        for (char &c : needle) {
+            if (c >= 'A' && c <= 'Z')
+                c = c - 'A' + 'a';
+        }
+    }
+    return needle;
+}
+
+/// Append the rows of [begin, end) matching to the level, scanning their text at once.
+void ItemFilter::scanRows(std::size_t filterLength, uint32_t begin, uint32_t end, Level &level) const
+{
+    if (isPatternMode()) {
+        if (! m_pattern)
+            return;
+        const char *text = m_haystack.text(haystackCase(filterLength));
+        for (uint32_t row = begin; row < end; ++row) {
+            if (matchesPattern(text + m_haystack.rowOffset(row), text + m_haystack.rowOffset(row + 1)))
+                level.rows.push_back(row);
+        }
+        return;
+    }
+
+    const std::string needleString = needle(filterLength);
+    if (needleString.find('\0') != std::string::npos)
+        return; // Would match across the strings of the haystack
+    const char *text = m_haystack.text(haystackCase(filterLength));
+
+    if (m_mode == FuzzyMode) {
+        const FuzzyMatcher matcher(needleString);
+        for (uint32_t row = begin; row < end; ++row) {
+            const int score = matcher.score(text + m_haystack.rowOffset(row),
+                                            text + m_haystack.rowOffset(row + 1));
+            if (score) {
+                level.rows.push_back(row);
+                level.scores.push_back(score);
+            }
+        }
+        return;
+    }
+
+    const Utils::SubstringFinder finder(needleString);
+    const char *position = text + m_haystack.rowOffset(begin);
+    const char *const stop = text + m_haystack.rowOffset(end);
+    uint32_t row = begin;
+    while (const char *match = finder.find(position, stop)) {
+        row = m_haystack.rowAt(match - text, row);
+        level.rows.push_back(row);
+        position = text + m_haystack.rowOffset(++row); // Skip the rest of the row
+    }
+}
+
+/// Append the rows of [begin, end) matching to the level, testing row by row.
+void ItemFilter::filterRows(std::size_t filterLength, const uint32_t *begin, const uint32_t *end,
+                            Level &level) const
+{
+    if (isPatternMode()) {
+        if (! m_pattern)
+            return;
+        const char *text = m_haystack.text(haystackCase(filterLength));
+        for (const uint32_t *row = begin; row != end; ++row) {
+            if (matchesPattern(text + m_haystack.rowOffset(*row), text + m_haystack.rowOffset(*row + 1)))
+                level.rows.push_back(*row);
+        }
+        return;
+    }
+
+    const std::string needleString = needle(filterLength);
+    if (needleString.find('\0') != std::string::npos)
+        return;
+    const char *text = m_haystack.text(haystackCase(filterLength));
+
+    if (m_mode == FuzzyMode) {
+        const FuzzyMatcher matcher(needleString);
+        for (const uint32_t *row = begin; row != end; ++row) {
+            const int score = matcher.score(text + m_haystack.rowOffset(*row),
+                                            text + m_haystack.rowOffset(*row + 1));
+            if (score) {
+                level.rows.push_back(*row);
+                level.scores.push_back(score);
+            }
+        }
+        return;
+    }
+
+    const Utils::SubstringFinder finder(needleString);
+    for (const uint32_t *row = begin; row != end; ++row) {
+        if (finder.find(text + m_haystack.rowOffset(*row), text + m_haystack.rowOffset(*row + 1)))
+            level.rows.push_back(*row);
+    }
+}
+
+} // namespace Core
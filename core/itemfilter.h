@@ -0,0 +1,168 @@
+#ifndef ITEMFILTER_H
+#define ITEMFILTER_H
+
+#include "itemhaystack.h"
+#include "itemstore.h"
+#include "patternmatcher.h"
+#include "trigramindex.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Core {
+
+/// Filters the rows of an ItemStore by the identifier or the displayed path.
+///
+/// In SubstringMode, these must contain the filter string and the rows keep their
+/// order. In FuzzyMode, they must contain the characters of the filter string in
+/// order and the rows are ranked by the score of the match, see FuzzyMatcher.
+/// In GlobMode and RegexMode, the filter string is a pattern for a PatternMatcher
+/// and the rows keep their order. Scores of the rows, see setRowScores(), rank
+/// the matches before all that, e.g. by frecency.
+///
+/// The results for the shorter filter strings typed before are kept on a stack:
+/// Appending characters narrows the current result, removing characters pops
+/// the results of the longer filter strings. So typing and backspacing cost time
+/// proportional to the current matches, not to all items. This does not hold for
+/// patterns, these are matched against all items on each change.
+///
+/// Matching is done on an ItemHaystack of the items passed to reset() and addRows().
+/// These must stay alive. Many rows are filtered in parallel, in chunks, by the
+/// global Utils::ThreadPool.
+///
+/// Filtering for a new filter string can be canceled, see setCancellationCheck().
+/// Then the rows match only a prefix of the filter string and isComplete() is false
+/// until filtering is resumed by another setFilterString() or complete().
+class ItemFilter
+{
+public:
+    enum Mode { SubstringMode, FuzzyMode, GlobMode, RegexMode };
+
+    /// SmartCase matches case insensitively unless the filter string contains
+    /// upper case characters.
+    enum CaseSensitivity { CaseSensitive, CaseInsensitive, SmartCase };
+
+    /// A matched character, to be highlighted.
+    struct MatchedCharacter
+    {
+        ItemStore::Column column; ///< Identifier or PathDisplayed
+        uint32_t offset;
+    };
+
+    ItemFilter(CaseSensitivity caseSensitivity = CaseSensitive);
+
+    const std::string &filterString() const { return m_filterString; }
+    Mode mode() const { return m_mode; }
+    CaseSensitivity caseSensitivity() const { return m_caseSensitivity; }
+    /// Why the filter string is no valid pattern in GlobMode or RegexMode. Then
+    /// no rows match.
+    const std::string &patternError() const { return m_patternError; }
+
+    /// The matching rows. If ranking, in FuzzyMode or by row scores, only the
+    /// first rows are ranked, see rankRows(), and the others are not valid to
+    /// read yet. Otherwise ascending.
+    const std::vector<uint32_t> &rows() const
+    { return isRanking() ? m_rankedRows : m_levels.back().rows; }
+
+    /// Make sure the first count rows are ranked. The ranked rows do not move.
+    void rankRows(uint32_t count);
+    /// Index of row in rows(), ranked if needed, or ItemStore::InvalidRow.
+    uint32_t indexOf(uint32_t row);
+
+    /// Returns false if canceled.
+    bool setFilterString(const std::string &filterString);
+    bool isComplete() const { return m_levels.back().filterLength == m_filterString.size(); }
+    /// Finish filtering, without cancellation.
+    void complete();
+    /// Polled between chunks of rows while filtering in parallel or indexing, in
+    /// the calling thread. Once it returns true, filtering is canceled.
+    void setCancellationCheck(const std::function<bool()> &isCanceled);
+
+    void setMode(Mode mode);
+    void setCaseSensitivity(CaseSensitivity caseSensitivity);
+    /// Ranks the matching rows by these scores first, descending, then as the
+    /// mode does. Rows without a score have 0. Empty to rank by the mode only.
+    void setRowScores(const std::vector<double> &scores);
+
+    /// For many items, a TrigramIndex speeds up filtering once built by
+    /// updateIndex(), e.g. when idle. Rows not yet indexed are scanned.
+    bool canIndexMore() const;
+    /// Returns false if canceled.
+    bool updateIndex();
+
+    /// The items changed, filter them from scratch.
+    void reset(const ItemStore &items);
+    /// The rows [begin, end) were appended to the items.
+    void addRows(const ItemStore &items, uint32_t begin, uint32_t end);
+
+    void matchedCharacters(uint32_t row, std::vector<MatchedCharacter> &result) const;
+
+private:
+    struct Level
+    {
+        std::size_t filterLength; ///< Length of the prefix of the filter string matched
+        std::vector<uint32_t> rows; // Ascending
+        std::vector<int> scores;    // Of the rows, in FuzzyMode
+    };
+
+    struct RankedRow
+    {
+        double rowScore;
+        int score;
+        uint32_t row;
+        bool operator<(const RankedRow &other) const
+        {
+            if (rowScore != other.rowScore)
+                return rowScore > other.rowScore;
+            return score != other.score ? score > other.score : row < other.row;
+        }
+    };
+
+    enum Cancellation { Cancelable, NotCancelable };
+    using ChunkFilter = std::function<void(uint32_t begin, uint32_t end, Level &chunk)>;
+
+    bool isRanking() const
+    { return (m_mode == FuzzyMode && m_levels.size() > 1) || ! m_rowScores.empty(); }
+    bool isPatternMode() const { return m_mode == GlobMode || m_mode == RegexMode; }
+    void refilter();
+    bool pushLevel(std::size_t filterLength);
+    bool findCandidates(std::size_t filterLength, std::vector<uint32_t> &candidates) const;
+    bool filterInParallel(uint32_t count, const ChunkFilter &filterChunk, Level &level,
+                          Cancellation cancellation) const;
+    void updateHaystack();
+    void compilePattern(std::size_t filterLength);
+    bool matchesPattern(const char *rowBegin, const char *rowEnd) const;
+    void updateRanking();
+    ItemHaystack::Case haystackCase(std::size_t filterLength) const;
+    std::string needle(std::size_t filterLength) const;
+    void scanRows(std::size_t filterLength, uint32_t begin, uint32_t end, Level &level) const;
+    void filterRows(std::size_t filterLength, const uint32_t *begin, const uint32_t *end,
+                    Level &level) const;
+
+    Mode m_mode;
+    CaseSensitivity m_caseSensitivity;
+    std::function<bool()> m_isCanceled;
+    std::string m_filterString;
+    std::vector<Level> m_levels; // By increasing filter length, the first is unfiltered
+    const ItemStore *m_items;
+    ItemHaystack m_haystack;
+    TrigramIndex m_index;
+    std::unique_ptr<PatternMatcher> m_pattern; // Of the last level in GlobMode and RegexMode
+    std::string m_patternError;
+
+    std::vector<double> m_rowScores;
+
+    // If ranking: The rows of the last level ordered by score, up to m_rankedCount.
+    // The rows of m_rankedRows behind m_rankedCount are not in place yet.
+    std::vector<RankedRow> m_ranking;
+    std::vector<uint32_t> m_rankedRows;
+    uint32_t m_rankedCount;
+};
+
+} // namespace Core
+
+#endif // ITEMFILTER_H
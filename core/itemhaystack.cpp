@@ -0,0 +1,70 @@
+#include "itemhaystack.h"
+
+#include "utils/stringutils.h"
+#include "utils/substringfinder.h"
+
+#include <algorithm>
+
+namespace Core {
+
+namespace {
+
+char foldCase(char c)
+{
+    return c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c;
+}
+
+} // anonymous
+
+ItemHaystack::ItemHaystack()
+{
+    clear();
+}
+
+uint32_t ItemHaystack::rowAt(uint32_t offset, uint32_t hint) const
+{
+    return std::upper_bound(m_rowOffsets.begin() + hint, m_rowOffsets.end(), offset)
+        - m_rowOffsets.begin() - 1;
+}
+
+void ItemHaystack::clear()
+{
+    m_text.assign(Utils::SubstringFinder::PaddingSize, '\0');
+    m_foldedText.assign(Utils::SubstringFinder::PaddingSize, '\0');
+    m_rowOffsets.assign(1, 0);
+}
+
+void ItemHaystack::append(const ItemStore &items, uint32_t begin, uint32_t end)
+    throw(std::length_error)
+{
+    // Drop the padding while appending.
+    const std::size_t oldSize = m_rowOffsets.back();
+    m_text.resize(oldSize);
+
+    std::size_t size = oldSize;
+    for (uint32_t row = begin; row < end; ++row)
+        size += items.identifier(row).size() + items.pathDisplayed(row).size() + 2;
+    if (size > UINT32_MAX) {
+        m_text.resize(oldSize + Utils::SubstringFinder::PaddingSize, '\0');
+        throw std::length_error("Too many items");
+    }
+    m_text.reserve(size + Utils::SubstringFinder::PaddingSize);
+    m_rowOffsets.reserve(m_rowOffsets.size() + (end - begin));
+
+    for (uint32_t row = begin; row < end; ++row) {
+        const Utils::StringUtils::StringRef identifier = items.identifier(row);
+        const Utils::StringUtils::StringRef pathDisplayed = items.pathDisplayed(row);
+        m_text.insert(m_text.end(), identifier.begin(), identifier.end());
+        m_text.push_back('\0');
+        m_text.insert(m_text.end(), pathDisplayed.begin(), pathDisplayed.end());
+        m_text.push_back('\0');
+        m_rowOffsets.push_back(m_text.size());
+    }
+    m_text.resize(size + Utils::SubstringFinder::PaddingSize, '\0');
+
+    m_foldedText.resize(oldSize);
+    m_foldedText.resize(m_text.size());
+    std::transform(m_text.begin() + oldSize, m_text.end(), m_foldedText.begin() + oldSize, foldCase);
+}
+
+} // namespace Core
@@ -0,0 +1,45 @@
+#ifndef ITEMHAYSTACK_H
+#define ITEMHAYSTACK_H
+
+#include "itemstore.h"
+
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+namespace Core {
+
+/// The identifiers and displayed paths of the items packed into one buffer for
+/// substring search, see Utils::SubstringFinder. Per row, the identifier and the
+/// displayed path are each followed by a 0 byte, so needles never match across
+/// them. A copy folded to lower case (ASCII only) allows to search case
+/// insensitively at the same speed.
+class ItemHaystack
+{
+public:
+    enum Case { OriginalCase, FoldedCase };
+
+    ItemHaystack();
+
+    uint32_t size() const { return m_rowOffsets.size() - 1; }
+
+    /// Padded as required by Utils::SubstringFinder.
+    const char *text(Case textCase) const
+    { return textCase == OriginalCase ? m_text.data() : m_foldedText.data(); }
+    uint32_t rowOffset(uint32_t row) const { return m_rowOffsets[row]; }
+    /// The row containing offset, searching from hint on.
+    uint32_t rowAt(uint32_t offset, uint32_t hint = 0) const;
+
+    void clear();
+    /// Add the rows [begin, end) of items.
+    void append(const ItemStore &items, uint32_t begin, uint32_t end) throw(std::length_error);
+
+private:
+    std::vector<char> m_text;
+    std::vector<char> m_foldedText;
+    std::vector<uint32_t> m_rowOffsets; // One past the last row, too
+};
+
+} // namespace Core
+
+#endif // ITEMHAYSTACK_H
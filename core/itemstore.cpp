@@ -0,0 +1,102 @@
+#include "itemstore.h"
+
+namespace Core {
+
+using Utils::StringUtils::StringRef;
+
+const uint32_t ItemStore::InvalidRow;
+
+ItemStore::ItemStore()
+    : m_size(0)
+    , m_strings(0)
+    , m_stringsSize(0)
+{
+    pointToOwned();
+}
+
+void ItemStore::setExternal(const std::shared_ptr<const void> &owner, uint32_t size,
+                            const char *strings, uint32_t stringsSize, const Columns &columns)
+{
+    clear();
+    m_owner = owner;
+    m_size = size;
+    m_strings = strings;
+    m_stringsSize = stringsSize;
+    m_columns = columns;
+}
+
+void ItemStore::append(StringRef identifier, StringRef path, StringRef pathDisplayed)
+    throw(std::length_error)
+{
+    if (m_owner)
+        makeOwned();
+
+    const StringRef strings[ColumnCount] = { identifier, path, pathDisplayed };
+    for (int column = 0; column < ColumnCount; ++column) {
+        if (m_ownStrings.size() + strings[column].size() > UINT32_MAX)
+            throw std::length_error("Too many items");
+        m_ownOffsets[column].push_back(m_ownStrings.size());
+        m_ownLengths[column].push_back(strings[column].size());
+        m_ownStrings.insert(m_ownStrings.end(), strings[column].begin(), strings[column].end());
+    }
+    ++m_size;
+    pointToOwned(); // The vectors might have reallocated.
+}
+
+void ItemStore::clear()
+{
+    m_owner.reset();
+    m_size = 0;
+    m_ownStrings.clear();
+    for (int column = 0; column < ColumnCount; ++column) {
+        m_ownOffsets[column].clear();
+        m_ownLengths[column].clear();
+    }
+    pointToOwned();
+}
+
+void ItemStore::makeOwned()
+{
+    const uint32_t size = m_size;
+    const char *strings = m_strings;
+    const uint32_t stringsSize = m_stringsSize;
+    const Columns columns = m_columns;
+    std::shared_ptr<const void> owner = m_owner; // Keep alive while copying.
+
+    m_owner.reset();
+    m_ownStrings.clear();
+    for (int column = 0; column < ColumnCount; ++column) {
+        m_ownOffsets[column].clear();
+        m_ownLengths[column].clear();
+        m_ownOffsets[column].reserve(size);
+        m_ownLengths[column].reserve(size);
+    }
+    m_size = 0;
+    for (uint32_t row = 0; row < size; ++row) {
+        for (int column = 0; column < ColumnCount; ++column) {
+            uint32_t offset = columns.offsets[column][row];
+            uint32_t length = columns.lengths[column][row];
+            if (offset > stringsSize || length > stringsSize - offset)
+                offset = length = 0; // See string()
+            m_ownOffsets[column].push_back(m_ownStrings.size());
+            m_ownLengths[column].push_back(length);
+            m_ownStrings.insert(m_ownStrings.end(), strings + offset, strings + offset + length);
+        }
+        ++m_size;
+    }
+    pointToOwned();
+}
+
+void ItemStore::pointToOwned()
+{
+    if (m_owner)
+        return;
+    m_strings = m_ownStrings.data();
+    m_stringsSize = m_ownStrings.size();
+    for (int column = 0; column < ColumnCount; ++column) {
+        m_columns.offsets[column] = m_ownOffsets[column].data();
+        m_columns.lengths[column] = m_ownLengths[column].data();
+    }
+}
+
+} // namespace Core
@@ -0,0 +1,82 @@
+#ifndef ITEMSTORE_H
+#define ITEMSTORE_H
+
+#include "utils/stringutils.h"
+
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+namespace Core {
+
+/// The items of a model in contiguous memory: Packed strings and, per column,
+/// arrays of offsets into them and of lengths. Items are addressed by row, so
+/// e.g. filter results are just vectors of rows.
+///
+/// The memory is either owned by the store (see append()) or by someone else,
+/// who is kept alive by the store (see setExternal()). External rows are not
+/// checked up front, a string not within the strings reads as empty instead.
+class ItemStore
+{
+public:
+    enum Column { Identifier, Path, PathDisplayed, ColumnCount };
+
+    struct Columns
+    {
+        const uint32_t *offsets[ColumnCount];
+        const uint32_t *lengths[ColumnCount];
+    };
+
+    static const uint32_t InvalidRow = UINT32_MAX;
+
+    ItemStore();
+
+    uint32_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+
+    Utils::StringUtils::StringRef string(Column column, uint32_t row) const
+    {
+        const uint32_t offset = m_columns.offsets[column][row];
+        const uint32_t length = m_columns.lengths[column][row];
+        if (offset > m_stringsSize || length > m_stringsSize - offset)
+            return Utils::StringUtils::StringRef(m_strings, 0);
+        return Utils::StringUtils::StringRef(m_strings + offset, length);
+    }
+    Utils::StringUtils::StringRef identifier(uint32_t row) const { return string(Identifier, row); }
+    Utils::StringUtils::StringRef path(uint32_t row) const { return string(Path, row); }
+    Utils::StringUtils::StringRef pathDisplayed(uint32_t row) const { return string(PathDisplayed, row); }
+
+    /// Items without a path separate groups of items, e.g. empty lines or the
+    /// headers of bookmark sections. They cannot be chosen.
+    bool isEmpty(uint32_t row) const { return m_columns.lengths[Path][row] == 0; }
+
+    void setExternal(const std::shared_ptr<const void> &owner, uint32_t size, const char *strings,
+                     uint32_t stringsSize, const Columns &columns);
+
+    /// Copies the strings. External memory is copied first, too.
+    void append(Utils::StringUtils::StringRef identifier, Utils::StringUtils::StringRef path,
+                Utils::StringUtils::StringRef pathDisplayed) throw(std::length_error);
+    void clear();
+
+private:
+    ItemStore(const ItemStore &) = delete;
+    ItemStore &operator=(const ItemStore &) = delete;
+
+    void makeOwned();
+    void pointToOwned();
+
+    uint32_t m_size;
+    const char *m_strings;
+    uint32_t m_stringsSize;
+    Columns m_columns;
+    std::shared_ptr<const void> m_owner;
+
+    std::vector<char> m_ownStrings;
+    std::vector<uint32_t> m_ownOffsets[ColumnCount];
+    std::vector<uint32_t> m_ownLengths[ColumnCount];
+};
+
+} // namespace Core
+
+#endif // ITEMSTORE_H
@@ -0,0 +1,431 @@
+#include "locateindex.h"
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace Core {
+namespace LocateIndex {
+
+using Utils::StringUtils::StringRef;
+
+namespace {
+
+const char Magic[8] = { 'G', 'O', 'T', 'O', 'L', 'O', 'C', '\0' };
+const uint32_t Version = 1;
+
+/// Entries per block, a new block starts with the next directory.
+const uint64_t BlockEntryCount = 4096;
+/// Bytes read per getdents64()
+const std::size_t ReadSize = 64 * 1024;
+
+struct Header
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t blockCount;
+    uint64_t directoryCount;
+    uint64_t entryCount;
+    uint64_t dataSize;
+};
+
+static_assert(sizeof(Header) % sizeof(uint64_t) == 0, "Block offsets are misaligned");
+
+struct LinuxDirectoryEntry
+{
+    uint64_t inode;
+    int64_t offset;
+    unsigned short recordLength;
+    unsigned char type;
+    char name[1];
+};
+
+unsigned pathCharacterKey(char c)
+{
+    return c == '/' ? 0 : static_cast<unsigned char>(c) + 1u;
+}
+
+std::size_t sharedPrefixLength(const std::string &lhs, const std::string &rhs)
+{
+    const std::size_t length = std::min(lhs.size(), rhs.size());
+    return std::mismatch(lhs.begin(), lhs.begin() + length, rhs.begin()).first - lhs.begin();
+}
+
+bool isVersionControlDirectory(const std::string &name)
+{
+    return name == ".git" || name == ".hg" || name == ".svn";
+}
+
+/// Walks the roots depth first and writes what it finds, taking unmodified
+/// directories from the old image.
+class Updater
+{
+public:
+    Updater(const Contents *oldContents, UpdateStatistics &statistics)
+        : m_statistics(statistics)
+        , m_buffer(ReadSize)
+        , m_hasOldDirectory(false)
+    {
+        if (oldContents) {
+            m_oldReader.reset(new Reader(*oldContents, 0, oldContents->blockCount));
+            m_hasOldDirectory = m_oldReader->readDirectory(m_oldDirectory);
+        }
+    }
+
+    void walk(const std::string &path)
+    {
+        const int directoryDescriptor
+            = open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (directoryDescriptor == -1)
+            return;
+        struct stat s;
+        if (fstat(directoryDescriptor, &s) == -1) {
+            close(directoryDescriptor);
+            return;
+        }
+
+        Directory directory;
+        directory.path = path;
+        directory.modificationSeconds = s.st_mtim.tv_sec;
+        directory.modificationNanoseconds = s.st_mtim.tv_nsec;
+        directory.inode = s.st_ino;
+
+        // The old directories are in the same order, skip the removed ones.
+        const StringRef pathRef(path.data(), path.size());
+        while (m_hasOldDirectory
+               && comparePaths(StringRef(m_oldDirectory.path.data(), m_oldDirectory.path.size()),
+                               pathRef) < 0) {
+            m_hasOldDirectory = m_oldReader->readDirectory(m_oldDirectory);
+        }
+
+        std::vector<Entry> entries;
+        if (m_hasOldDirectory && m_oldDirectory.path == path
+                && m_oldDirectory.modificationSeconds == directory.modificationSeconds
+                && m_oldDirectory.modificationNanoseconds == directory.modificationNanoseconds
+                && m_oldDirectory.inode == directory.inode) {
+            entries.reserve(m_oldDirectory.entryCount);
+            Entry entry;
+            while (m_oldReader->readEntry(entry))
+                entries.push_back(entry);
+        } else {
+            readEntries(directoryDescriptor, entries);
+            std::sort(entries.begin(), entries.end(), [](const Entry &lhs, const Entry &rhs) {
+                return lhs.name < rhs.name;
+            });
+            ++m_statistics.readDirectoryCount;
+        }
+        close(directoryDescriptor);
+
+        directory.entryCount = entries.size();
+        m_writer.addDirectory(directory, entries);
+        ++m_statistics.directoryCount;
+        m_statistics.entryCount += entries.size();
+
+        const std::string prefix = path == "/" ? path : path + '/';
+        for (const Entry &entry : entries) {
+            if (entry.type == DT_DIR && ! isVersionControlDirectory(entry.name))
+                walk(prefix + entry.name);
+        }
+    }
+
+    std::string finish() { return m_writer.finish(); }
+
+private:
+    void readEntries(int directoryDescriptor, std::vector<Entry> &entries)
+    {
+        long readSize;
+        while ((readSize = syscall(SYS_getdents64, directoryDescriptor, m_buffer.data(),
+                                   m_buffer.size())) > 0) {
+            for (long position = 0; position < readSize; ) {
+                const LinuxDirectoryEntry *linuxEntry
+                    = reinterpret_cast<const LinuxDirectoryEntry *>(m_buffer.data() + position);
+                position += linuxEntry->recordLength;
+                const char *name = linuxEntry->name;
+                if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0')))
+                    continue;
+
+                Entry entry;
+                entry.name = name;
+                entry.type = linuxEntry->type;
+                struct stat s;
+                if (entry.type == DT_UNKNOWN
+                        && fstatat(directoryDescriptor, name, &s, AT_SYMLINK_NOFOLLOW) == 0) {
+                    entry.type = IFTODT(s.st_mode);
+                }
+                entries.push_back(entry);
+            }
+        }
+    }
+
+    UpdateStatistics &m_statistics;
+    Writer m_writer;
+    std::vector<char> m_buffer;
+    std::unique_ptr<Reader> m_oldReader;
+    Directory m_oldDirectory;
+    bool m_hasOldDirectory;
+};
+
+} // anonymous
+
+bool read(StringRef image, Contents &contents)
+{
+    if (image.size() < sizeof(Header))
+        return false;
+
+    Header header;
+    std::memcpy(&header, image.data(), sizeof(Header));
+    if (std::memcmp(header.magic, Magic, sizeof(Magic)) != 0 || header.version != Version)
+        return false;
+
+    const uint64_t offsetsSize = (uint64_t(header.blockCount) + 1) * sizeof(uint64_t);
+    if (image.size() != sizeof(Header) + offsetsSize + header.dataSize)
+        return false;
+
+    // The header has a size of a multiple of 8 and images are at least that aligned.
+    const uint64_t *blockOffsets = reinterpret_cast<const uint64_t *>(image.data() + sizeof(Header));
+    if (blockOffsets[0] != 0 || blockOffsets[header.blockCount] != header.dataSize)
+        return false;
+    for (uint32_t block = 0; block < header.blockCount; ++block) {
+        if (blockOffsets[block] > blockOffsets[block + 1])
+            return false;
+    }
+
+    contents.blockCount = header.blockCount;
+    contents.directoryCount = header.directoryCount;
+    contents.entryCount = header.entryCount;
+    contents.blockOffsets = blockOffsets;
+    contents.data = image.data() + sizeof(Header) + offsetsSize;
+    return true;
+}
+
+int comparePaths(StringRef lhs, StringRef rhs)
+{
+    const std::size_t length = std::min(lhs.size(), rhs.size());
+    for (std::size_t i = 0; i < length; ++i) {
+        if (lhs.data()[i] != rhs.data()[i])
+            return int(pathCharacterKey(lhs.data()[i])) - int(pathCharacterKey(rhs.data()[i]));
+    }
+    return lhs.size() < rhs.size() ? -1 : lhs.size() > rhs.size() ? 1 : 0;
+}
+
+Reader::Reader(const Contents &contents, uint32_t beginBlock, uint32_t endBlock)
+    : m_contents(contents)
+    , m_block(beginBlock)
+    , m_endBlock(std::min(endBlock, contents.blockCount))
+    , m_position(0)
+    , m_end(0)
+    , m_remainingEntryCount(0)
+{
+    startBlock();
+}
+
+bool Reader::readDirectory(Directory &directory)
+{
+    Entry entry;
+    while (m_remainingEntryCount > 0) {
+        if (! readEntry(entry))
+            return false;
+    }
+    if (m_position == m_end && ! startBlock())
+        return false;
+
+    uint64_t sharedLength, restLength, seconds, nanoseconds, inode, entryCount;
+    const char *rest;
+    if (! readVarint(sharedLength) || ! readVarint(restLength) || sharedLength > m_path.size()
+            || ! readBytes(restLength, rest) || ! readVarint(seconds) || ! readVarint(nanoseconds)
+            || ! readVarint(inode) || ! readVarint(entryCount)) {
+        return false;
+    }
+    m_path.resize(sharedLength);
+    m_path.append(rest, restLength);
+    directory.path = m_path;
+    directory.modificationSeconds = int64_t(seconds);
+    directory.modificationNanoseconds = int64_t(nanoseconds);
+    directory.inode = inode;
+    directory.entryCount = entryCount;
+    m_remainingEntryCount = entryCount;
+    return true;
+}
+
+bool Reader::readEntry(Entry &entry)
+{
+    if (m_remainingEntryCount == 0)
+        return false;
+    --m_remainingEntryCount;
+
+    const char *type;
+    uint64_t sharedLength, restLength;
+    const char *rest;
+    if (! readBytes(1, type) || ! readVarint(sharedLength) || ! readVarint(restLength)
+            || ! readBytes(restLength, rest)) {
+        return false;
+    }
+    if (sharedLength > entry.name.size()) {
+        m_block = m_endBlock;
+        m_position = m_end;
+        m_remainingEntryCount = 0;
+        return false;
+    }
+    entry.type = static_cast<uint8_t>(*type);
+    entry.sharedLength = sharedLength;
+    entry.name.resize(sharedLength);
+    entry.name.append(rest, restLength);
+    return true;
+}
+
+/// LEB128
+bool Reader::readVarint(uint64_t &value)
+{
+    value = 0;
+    for (unsigned shift = 0; shift < 64 && m_position != m_end; shift += 7) {
+        const unsigned char byte = static_cast<unsigned char>(*m_position++);
+        value |= uint64_t(byte & 0x7f) << shift;
+        if (! (byte & 0x80))
+            return true;
+    }
+    // Damaged, stop.
+    m_block = m_endBlock;
+    m_position = m_end;
+    m_remainingEntryCount = 0;
+    return false;
+}
+
+bool Reader::readBytes(std::size_t length, const char *&bytes)
+{
+    if (std::size_t(m_end - m_position) < length) {
+        m_block = m_endBlock;
+        m_position = m_end;
+        m_remainingEntryCount = 0;
+        return false;
+    }
+    bytes = m_position;
+    m_position += length;
+    return true;
+}
+
+/// Moves to the next non-empty block, if any.
+bool Reader::startBlock()
+{
+    while (m_block < m_endBlock) {
+        m_position = m_contents.data + m_contents.blockOffsets[m_block];
+        m_end = m_contents.data + m_contents.blockOffsets[m_block + 1];
+        ++m_block;
+        m_path.clear();
+        if (m_position != m_end)
+            return true;
+    }
+    return false;
+}
+
+Writer::Writer()
+    : m_directoryCount(0)
+    , m_entryCount(0)
+    , m_blockEntryCount(BlockEntryCount)
+{
+}
+
+void Writer::addDirectory(const Directory &directory, const std::vector<Entry> &entries)
+{
+    if (m_blockEntryCount >= BlockEntryCount) {
+        m_blockOffsets.push_back(m_data.size());
+        m_blockEntryCount = 0;
+        m_previousPath.clear();
+    }
+
+    const std::size_t sharedLength = sharedPrefixLength(m_previousPath, directory.path);
+    writeVarint(sharedLength);
+    writeVarint(directory.path.size() - sharedLength);
+    m_data.append(directory.path, sharedLength, std::string::npos);
+    writeVarint(uint64_t(directory.modificationSeconds));
+    writeVarint(uint64_t(directory.modificationNanoseconds));
+    writeVarint(directory.inode);
+    writeVarint(entries.size());
+    m_previousPath = directory.path;
+
+    const std::string *previousName = 0;
+    for (const Entry &entry : entries) {
+        const std::size_t sharedNameLength = previousName
+            ? sharedPrefixLength(*previousName, entry.name) : 0;
+        m_data.push_back(static_cast<char>(entry.type));
+        writeVarint(sharedNameLength);
+        writeVarint(entry.name.size() - sharedNameLength);
+        m_data.append(entry.name, sharedNameLength, std::string::npos);
+        previousName = &entry.name;
+    }
+
+    ++m_directoryCount;
+    m_entryCount += entries.size();
+    m_blockEntryCount += entries.size() + 1;
+}
+
+std::string Writer::finish()
+{
+    Header header;
+    std::memset(&header, 0, sizeof(Header));
+    std::memcpy(header.magic, Magic, sizeof(Magic));
+    header.version = Version;
+    header.blockCount = m_blockOffsets.size();
+    header.directoryCount = m_directoryCount;
+    header.entryCount = m_entryCount;
+    header.dataSize = m_data.size();
+
+    std::vector<uint64_t> blockOffsets = m_blockOffsets;
+    blockOffsets.push_back(m_data.size());
+
+    std::string image;
+    image.reserve(sizeof(Header) + blockOffsets.size() * sizeof(uint64_t) + m_data.size());
+    image.append(reinterpret_cast<const char *>(&header), sizeof(Header));
+    image.append(reinterpret_cast<const char *>(blockOffsets.data()),
+                 blockOffsets.size() * sizeof(uint64_t));
+    image.append(m_data);
+    return image;
+}
+
+void Writer::writeVarint(uint64_t value)
+{
+    while (value >= 0x80) {
+        m_data.push_back(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    m_data.push_back(static_cast<char>(value));
+}
+
+std::string update(const std::vector<std::string> &roots, const Contents *oldContents,
+                   UpdateStatistics &statistics) throw(std::runtime_error)
+{
+    // Walk the roots in order and skip the ones inside others.
+    std::vector<std::string> sortedRoots;
+    for (std::string root : roots) {
+        while (root.size() > 1 && root[root.size() - 1] == '/')
+            root.resize(root.size() - 1);
+        if (! root.empty() && root[0] == '/')
+            sortedRoots.push_back(root);
+    }
+    std::sort(sortedRoots.begin(), sortedRoots.end(), [](const std::string &lhs, const std::string &rhs) {
+        return comparePaths(StringRef(lhs.data(), lhs.size()), StringRef(rhs.data(), rhs.size())) < 0;
+    });
+
+    statistics = UpdateStatistics();
+    Updater updater(oldContents, statistics);
+    std::string previousRoot;
+    for (const std::string &root : sortedRoots) {
+        const bool isInsidePrevious = ! previousRoot.empty()
+            && (previousRoot == "/" || root == previousRoot
+                || (root.compare(0, previousRoot.size(), previousRoot) == 0
+                    && root[previousRoot.size()] == '/'));
+        if (isInsidePrevious)
+            continue;
+        updater.walk(root);
+        previousRoot = root;
+    }
+    return updater.finish();
+}
+
+} // namespace LocateIndex
+} // namespace Core
@@ -0,0 +1,141 @@
+#ifndef LOCATEINDEX_H
+#define LOCATEINDEX_H
+
+#include "utils/stringutils.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace Core {
+
+/// Binary image of the paths below some root directories, for locating files
+/// (~/.goto.locate.idx). It is mapped, not parsed.
+///
+/// Layout, in native byte order:
+///   Header
+///   uint64_t blockOffsets[blockCount + 1] - Into data, the last one is its end
+///   char data[]
+///
+/// The data is the directories in depth first order, with the entries of each
+/// directory sorted. That is, the paths are sorted by comparePaths(). Per
+/// directory:
+///   varint   Length of the prefix shared with the path of the previous directory
+///   varint   Length of the rest of the path, followed by it
+///   varint   Modification time in seconds, nanoseconds and the inode, so an
+///            unchanged directory need not be read again on update()
+///   varint   Count of entries, followed by them:
+///              uint8_t  d_type, DT_DIR only for directories, not for links to them
+///              varint   Length of the prefix shared with the previous name
+///              varint   Length of the rest of the name, followed by it
+///
+/// The directories are grouped into blocks of some thousand entries, each
+/// starting with a full path, so blocks can be decoded in parallel.
+namespace LocateIndex {
+
+struct Directory
+{
+    Directory() : modificationSeconds(0), modificationNanoseconds(0), inode(0), entryCount(0) {}
+
+    std::string path;
+    int64_t modificationSeconds;
+    int64_t modificationNanoseconds;
+    uint64_t inode;
+    uint32_t entryCount;
+};
+
+struct Entry
+{
+    Entry() : type(0), sharedLength(0) {}
+
+    std::string name;
+    uint8_t type;
+    uint32_t sharedLength; ///< Of the name with the previous one, as read
+};
+
+struct Contents
+{
+    Contents() : blockCount(0), directoryCount(0), entryCount(0), blockOffsets(0), data(0) {}
+
+    uint32_t blockCount;
+    uint64_t directoryCount;
+    uint64_t entryCount;
+    const uint64_t *blockOffsets;
+    const char *data;
+};
+
+/// Returns false if the image is damaged. The blocks are checked while decoding.
+bool read(Utils::StringUtils::StringRef image, Contents &contents);
+
+/// Orders paths like a depth first walk with sorted entries: As if '/' were
+/// smaller than any other character. Returns <0, 0 or >0.
+int comparePaths(Utils::StringUtils::StringRef lhs, Utils::StringUtils::StringRef rhs);
+
+/// Decodes the directories of some blocks in order. Damaged data just ends them.
+class Reader
+{
+public:
+    Reader(const Contents &contents, uint32_t beginBlock, uint32_t endBlock);
+
+    /// Reads the header of the next directory, skipping the entries of the
+    /// previous one if not read.
+    bool readDirectory(Directory &directory);
+    /// Returns false after the last entry of the directory. Entry::name is
+    /// front decoded, keep passing the same entry.
+    bool readEntry(Entry &entry);
+
+private:
+    bool readVarint(uint64_t &value);
+    bool readBytes(std::size_t length, const char *&bytes);
+    bool startBlock();
+
+    const Contents &m_contents;
+    uint32_t m_block;
+    const uint32_t m_endBlock;
+    const char *m_position;
+    const char *m_end;
+    uint32_t m_remainingEntryCount;
+    std::string m_path; // Of the previous directory in the block
+};
+
+/// Encodes the directories, in the order of comparePaths().
+class Writer
+{
+public:
+    Writer();
+
+    void addDirectory(const Directory &directory, const std::vector<Entry> &entries);
+    std::string finish();
+
+private:
+    void writeVarint(uint64_t value);
+
+    std::string m_data;
+    std::vector<uint64_t> m_blockOffsets;
+    uint64_t m_directoryCount;
+    uint64_t m_entryCount;
+    uint64_t m_blockEntryCount;
+    std::string m_previousPath;
+};
+
+struct UpdateStatistics
+{
+    UpdateStatistics() : directoryCount(0), entryCount(0), readDirectoryCount(0) {}
+
+    uint64_t directoryCount;
+    uint64_t entryCount;
+    uint64_t readDirectoryCount; ///< Changed since the old image, the others are taken over
+};
+
+/// Builds a new image of the directories below roots. Directories not modified
+/// since oldContents (if any) are taken from there instead of reading them.
+/// Symbolic links are not followed, version control metadata is not indexed.
+std::string update(const std::vector<std::string> &roots, const Contents *oldContents,
+                   UpdateStatistics &statistics) throw(std::runtime_error);
+
+} // namespace LocateIndex
+} // namespace Core
+
+#endif // LOCATEINDEX_H
@@ -0,0 +1,387 @@
+#include "locateitemsmodel.h"
+
+#include "patternmatcher.h"
+
+#include "utils/debugutils.h"
+#include "utils/stringutils.h"
+#include "utils/substringfinder.h"
+#include "utils/threadpool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cstring>
+
+#include <dirent.h>
+
+namespace Core {
+
+using Utils::StringUtils::StringRef;
+
+namespace {
+
+char foldCase(char c)
+{
+    return c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c;
+}
+
+/// Like ItemFilter::haystackCase(): With SmartCase insensitive unless there are
+/// upper case characters.
+bool isCaseFolded(const std::string &filterString, ItemFilter::Mode mode,
+                  ItemFilter::CaseSensitivity caseSensitivity)
+{
+    if (caseSensitivity != ItemFilter::SmartCase)
+        return caseSensitivity == ItemFilter::CaseInsensitive;
+    const bool isPattern = mode == ItemFilter::GlobMode || mode == ItemFilter::RegexMode;
+    for (std::size_t i = 0; i < filterString.size(); ++i) {
+        const char c = filterString[i];
+        if (c == '\\' && isPattern)
+            ++i; // Like \W
+        else if (c >= 'A' && c <= 'Z')
+            return false;
+    }
+    return true;
+}
+
+/// Whether the characters of needle occur in text in order. The FuzzyMatcher
+/// scores the items later on, this just needs to be fast.
+bool containsInOrder(const char *text, const char *end, const std::string &needle)
+{
+    for (const char c : needle) {
+        text = static_cast<const char *>(std::memchr(text, c, end - text));
+        if (! text)
+            return false;
+        ++text;
+    }
+    return true;
+}
+
+} // anonymous
+
+LocateItemsModel::LocateItemsModel(const std::string &indexFilePath) throw(std::runtime_error)
+    : m_indexFilePath(indexFilePath)
+    , m_isTruncated(false)
+    , m_identifierColumnWidth(0)
+    , m_isCanceled(false)
+    , m_hasPendingQuery(false)
+    , m_isStopping(false)
+{
+    m_thread = std::thread(&LocateItemsModel::work, this);
+}
+
+LocateItemsModel::~LocateItemsModel()
+{
+    {
+        std::lock_guard<std::mutex> locker(m_mutex);
+        m_isStopping = true;
+        m_hasPendingQuery = false;
+        m_isCanceled = true;
+    }
+    m_queryAdded.notify_one();
+    m_thread.join();
+}
+
+bool LocateItemsModel::open()
+{
+    Utils::FileUtils::FileStamp stamp;
+    if (! Utils::FileUtils::fileStamp(m_indexFilePath, stamp)) {
+        m_index.reset();
+        return false;
+    }
+    if (m_index && m_index->file.stamp() == stamp)
+        return true;
+
+    std::shared_ptr<Index> index = std::make_shared<Index>();
+    try {
+        index->file = Utils::FileUtils::MappedFile(m_indexFilePath);
+    } catch (const std::runtime_error &error) {
+        Utils::DebugUtils::debug() << error.what();
+        m_index.reset();
+        return false;
+    }
+    if (! LocateIndex::read(StringRef(index->file.data(), index->file.size()), index->contents)) {
+        Utils::DebugUtils::debug() << "Damaged locate index" << m_indexFilePath;
+        m_index.reset();
+        return false;
+    }
+    m_index = index;
+    m_matchedQuery = Query(); // Search again
+    return true;
+}
+
+const ItemStore &LocateItemsModel::items()
+{
+    return m_store;
+}
+
+bool LocateItemsModel::reload(ItemsUpdate &update)
+{
+    open();
+    update = ItemsUpdate();
+    update.removedCount = m_store.size();
+    m_store.clear();
+    m_types.clear();
+    m_identifierColumnWidth = 0;
+    m_matchedQuery = Query();
+    search(m_query);
+    return true;
+}
+
+unsigned LocateItemsModel::identifierColumnWidth()
+{
+    return m_identifierColumnWidth;
+}
+
+int LocateItemsModel::notificationDescriptor()
+{
+    return m_notifier.fileDescriptor();
+}
+
+bool LocateItemsModel::takeChanges(ItemsUpdate &update)
+{
+    m_notifier.clear();
+    std::unique_ptr<Matches> matches;
+    {
+        std::lock_guard<std::mutex> locker(m_mutex);
+        matches.swap(m_matches);
+    }
+    if (! matches || matches->generation != m_query.generation)
+        return false;
+
+    update = ItemsUpdate();
+    update.removedCount = m_store.size();
+    m_store.clear();
+    m_types.clear();
+    m_identifierColumnWidth = 0;
+    std::string identifier;
+    for (const Match &match : matches->matches) {
+        const char *path = matches->paths.data() + match.pathOffset;
+        identifier.assign(path + match.pathLength - match.nameLength, match.nameLength);
+        if (match.type == DT_DIR)
+            identifier.push_back('/');
+        const StringRef pathRef(path, match.pathLength);
+        m_store.append(StringRef(identifier.data(), identifier.size()), pathRef, pathRef);
+        m_types.push_back(match.type);
+        m_identifierColumnWidth = std::max<unsigned>(m_identifierColumnWidth, identifier.size());
+    }
+    update.insertedCount = m_store.size();
+    m_matchedQuery = m_query;
+    m_isTruncated = matches->isTruncated;
+    return true;
+}
+
+void LocateItemsModel::setFilter(const std::string &filterString, ItemFilter::Mode mode,
+                                 ItemFilter::CaseSensitivity caseSensitivity)
+{
+    Query query;
+    query.filterString = filterString;
+    query.mode = mode;
+    query.caseSensitivity = caseSensitivity;
+    search(query);
+}
+
+bool LocateItemsModel::fileInfo(uint32_t row, Utils::FileUtils::FileInfo &info)
+{
+    if (row >= m_types.size() || m_types[row] != DT_DIR)
+        return false;
+    info = Utils::FileUtils::FileInfo();
+    info.isProbed = true;
+    info.exists = true;
+    info.isDirectory = true;
+    return true;
+}
+
+std::string LocateItemsModel::title()
+{
+    if (! m_index)
+        return "Locate: No index, run goto --update-index";
+    std::string title = "Locate: " + std::to_string(m_index->contents.entryCount) + " paths";
+    if (m_matchedQuery.generation != m_query.generation)
+        title += ", searching...";
+    else if (m_isTruncated)
+        title += ", showing the first " + std::to_string(MaximumMatchCount) + " matches";
+    return title;
+}
+
+/// Searches for query in the background, unless the items contain all its matches already.
+void LocateItemsModel::search(const Query &query)
+{
+    const uint64_t generation = m_query.generation + 1;
+    m_query = query;
+    m_query.index = m_index;
+    if (m_matchedQuery.index && m_matchedQuery.index == m_index && ! m_isTruncated
+            && m_matchedQuery.generation == generation - 1 && isNarrowing(m_matchedQuery, m_query)) {
+        m_query.generation = generation;
+        m_matchedQuery = m_query;
+        return;
+    }
+    m_query.generation = generation;
+    {
+        std::lock_guard<std::mutex> locker(m_mutex);
+        m_pendingQuery = m_query;
+        m_hasPendingQuery = true;
+        m_isCanceled = true;
+    }
+    m_queryAdded.notify_one();
+}
+
+/// Whether the matches of next are a subset of the ones of previous.
+bool LocateItemsModel::isNarrowing(const Query &previous, const Query &next)
+{
+    // Case sensitive matches are a subset of the case insensitive ones.
+    return previous.mode == next.mode
+        && (next.mode == ItemFilter::SubstringMode || next.mode == ItemFilter::FuzzyMode)
+        && next.filterString.compare(0, previous.filterString.size(), previous.filterString) == 0;
+}
+
+void LocateItemsModel::work()
+{
+    for (;;) {
+        Query query;
+        {
+            std::unique_lock<std::mutex> locker(m_mutex);
+            m_queryAdded.wait(locker, [this]() { return m_isStopping || m_hasPendingQuery; });
+            if (m_isStopping)
+                return;
+            query = m_pendingQuery;
+            m_hasPendingQuery = false;
+            m_isCanceled = false;
+        }
+
+        const auto startTime = std::chrono::steady_clock::now();
+        std::unique_ptr<Matches> matches(new Matches);
+        matches->generation = query.generation;
+        if (query.index) {
+            const LocateIndex::Contents &contents = query.index->contents;
+            const bool isFolded = isCaseFolded(query.filterString, query.mode, query.caseSensitivity);
+            std::string needle = query.filterString;
+            if (isFolded)
+                std::transform(needle.begin(), needle.end(), needle.begin(), foldCase);
+
+            std::unique_ptr<PatternMatcher> pattern;
+            if (query.mode == ItemFilter::GlobMode || query.mode == ItemFilter::RegexMode) {
+                try {
+                    pattern.reset(new PatternMatcher(query.filterString,
+                                                     query.mode == ItemFilter::GlobMode
+                                                         ? PatternMatcher::Glob
+                                                         : PatternMatcher::RegularExpression,
+                                                     isFolded));
+                } catch (const std::runtime_error &) {
+                    // No matches, the FilterMenu shows the error.
+                }
+            }
+            const bool isPatternInvalid = (query.mode == ItemFilter::GlobMode
+                                           || query.mode == ItemFilter::RegexMode) && ! pattern;
+            const Utils::SubstringFinder finder(needle);
+
+            // Each block is decoded on its own. The blocks are handed out in
+            // order, so stopping at the maximum keeps roughly the first matches.
+            std::vector<Matches> blockMatches(isPatternInvalid ? 0 : contents.blockCount);
+            std::atomic<uint32_t> matchCount(0);
+            Utils::ThreadPool::globalInstance().parallelFor(blockMatches.size(), [&](unsigned block) {
+                Matches &result = blockMatches[block];
+                LocateIndex::Reader reader(contents, block, block + 1);
+                LocateIndex::Directory directory;
+                LocateIndex::Entry entry;
+                std::vector<char> text;
+                while (! m_isCanceled && matchCount < MaximumMatchCount
+                       && reader.readDirectory(directory)) {
+                    // The text to match: The path of the directory, a '/' and the name.
+                    const std::size_t prefixLength = directory.path == "/" ? 1 : directory.path.size() + 1;
+                    text.resize(prefixLength + Utils::SubstringFinder::PaddingSize);
+                    std::copy(directory.path.begin(), directory.path.end(), text.begin());
+                    text[prefixLength - 1] = '/';
+                    if (isFolded)
+                        std::transform(text.begin(), text.begin() + prefixLength, text.begin(), foldCase);
+                    // Matching the directory, all entries match.
+                    const bool isDirectoryMatching = query.mode == ItemFilter::SubstringMode
+                        && (needle.empty() || finder.find(text.data(), text.data() + prefixLength));
+                    const std::size_t searchStart = needle.size() > prefixLength
+                        ? 0 : prefixLength - needle.size() + 1;
+
+                    uint32_t blockMatchCount = 0;
+                    while (reader.readEntry(entry)) {
+                        // Only the rest of the name differs from the previous one.
+                        const std::size_t textLength = prefixLength + entry.name.size();
+                        if (text.size() < textLength + Utils::SubstringFinder::PaddingSize + 1)
+                            text.resize(textLength + NAME_MAX + Utils::SubstringFinder::PaddingSize + 1);
+                        std::copy(entry.name.begin() + entry.sharedLength, entry.name.end(),
+                                  text.begin() + prefixLength + entry.sharedLength);
+                        if (isFolded)
+                            std::transform(text.begin() + prefixLength + entry.sharedLength,
+                                           text.begin() + textLength,
+                                           text.begin() + prefixLength + entry.sharedLength, foldCase);
+                        const char *textBegin = text.data();
+                        const char *textEnd = textBegin + textLength;
+
+                        bool isMatching = isDirectoryMatching;
+                        if (isDirectoryMatching) {
+                            // Matching anyway
+                        } else if (query.mode == ItemFilter::SubstringMode) {
+                            isMatching = finder.find(textBegin + searchStart, textEnd);
+                        } else if (query.mode == ItemFilter::FuzzyMode) {
+                            isMatching = containsInOrder(textBegin, textEnd, needle);
+                        } else {
+                            // Like the ItemFilter, match the identifier or the path.
+                            isMatching = pattern->matches(textBegin, textEnd);
+                            if (! isMatching) {
+                                if (entry.type == DT_DIR) {
+                                    text[textLength] = '/';
+                                    textEnd += 1;
+                                }
+                                isMatching = pattern->matches(textBegin + prefixLength, textEnd);
+                            }
+                        }
+                        if (! isMatching)
+                            continue;
+
+                        Match match;
+                        match.pathOffset = result.paths.size();
+                        match.pathLength = prefixLength + entry.name.size();
+                        match.nameLength = entry.name.size();
+                        match.type = entry.type;
+                        result.paths.append(directory.path);
+                        if (directory.path != "/")
+                            result.paths.push_back('/');
+                        result.paths.append(entry.name);
+                        result.matches.push_back(match);
+                        ++blockMatchCount;
+                    }
+                    matchCount += blockMatchCount;
+                }
+            });
+
+            for (Matches &result : blockMatches) {
+                for (Match match : result.matches) {
+                    if (matches->matches.size() == MaximumMatchCount) {
+                        matches->isTruncated = true;
+                        break;
+                    }
+                    const uint32_t offset = matches->paths.size();
+                    matches->paths.append(result.paths, match.pathOffset, match.pathLength);
+                    match.pathOffset = offset;
+                    matches->matches.push_back(match);
+                }
+            }
+            if (matchCount >= MaximumMatchCount)
+                matches->isTruncated = true;
+        }
+
+        const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - startTime).count();
+        const int matchCount = matches->matches.size();
+        bool isCurrent;
+        {
+            std::lock_guard<std::mutex> locker(m_mutex);
+            isCurrent = ! m_hasPendingQuery;
+            if (isCurrent)
+                m_matches.swap(matches);
+        }
+        if (isCurrent) {
+            Utils::DebugUtils::debug() << "Located" << matchCount << "paths in" << int(elapsed) << "ms";
+            m_notifier.notify();
+        }
+    }
+}
+
+} // namespace Core
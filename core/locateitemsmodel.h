@@ -0,0 +1,128 @@
+#ifndef LOCATEITEMSMODEL_H
+#define LOCATEITEMSMODEL_H
+
+#include "imodel.h"
+#include "itemfilter.h"
+#include "itemstore.h"
+#include "locateindex.h"
+
+#include "utils/fileutils.h"
+#include "utils/notifier.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Core {
+
+/// Locates files in a LocateIndex. Millions of paths are too many to be items,
+/// so the items are the first matches of the filter string only. The index is
+/// searched in a thread of its own, its blocks in parallel by the global
+/// Utils::ThreadPool, and a new filter string cancels the running search.
+///
+/// Appending to the filter string needs no search if all matches are items
+/// already, the FilterMenu narrows them down.
+class LocateItemsModel : public IModel
+{
+public:
+    static const uint32_t MaximumMatchCount = 10000;
+
+    explicit LocateItemsModel(const std::string &indexFilePath) throw(std::runtime_error);
+    ~LocateItemsModel();
+
+    /// Maps the index, again if it was updated meanwhile. Returns false if
+    /// there is no valid one, then there are no items.
+    bool open();
+
+    const ItemStore &items();
+    /// Opens the index again and searches it.
+    bool reload(ItemsUpdate &update);
+    unsigned identifierColumnWidth();
+
+    /// Readable once a search is done.
+    int notificationDescriptor();
+    /// The matches of the last search replace the items.
+    bool takeChanges(ItemsUpdate &update);
+    void setFilter(const std::string &filterString, ItemFilter::Mode mode,
+                   ItemFilter::CaseSensitivity caseSensitivity);
+
+    /// Known for directories, others are up to the FileInfoCache.
+    bool fileInfo(uint32_t row, Utils::FileUtils::FileInfo &info);
+    std::string title();
+
+private:
+    LocateItemsModel(const LocateItemsModel &) = delete;
+    LocateItemsModel &operator=(const LocateItemsModel &) = delete;
+
+    struct Index
+    {
+        Utils::FileUtils::MappedFile file;
+        LocateIndex::Contents contents;
+    };
+
+    struct Query
+    {
+        Query()
+            : mode(ItemFilter::SubstringMode), caseSensitivity(ItemFilter::CaseSensitive)
+            , generation(0) {}
+
+        std::string filterString;
+        ItemFilter::Mode mode;
+        ItemFilter::CaseSensitivity caseSensitivity;
+        uint64_t generation;
+        std::shared_ptr<const Index> index;
+    };
+
+    struct Match
+    {
+        uint32_t pathOffset; ///< Into Matches::paths
+        uint32_t pathLength;
+        uint32_t nameLength; ///< The name ends the path
+        uint8_t type;
+    };
+
+    struct Matches
+    {
+        Matches() : generation(0), isTruncated(false) {}
+
+        std::string paths;
+        std::vector<Match> matches;
+        uint64_t generation;
+        bool isTruncated;
+    };
+
+    void search(const Query &query);
+    void work();
+    static bool isNarrowing(const Query &previous, const Query &next);
+
+    const std::string m_indexFilePath;
+    std::shared_ptr<const Index> m_index;
+
+    // Of the UI thread
+    Query m_query;         ///< The last one searched for
+    Query m_matchedQuery;  ///< The one the items are the matches of
+    bool m_isTruncated;
+    ItemStore m_store;
+    std::vector<uint8_t> m_types; ///< d_type per row
+    unsigned m_identifierColumnWidth;
+
+    std::atomic<bool> m_isCanceled;
+    Utils::Notifier m_notifier;
+    std::mutex m_mutex;
+    std::condition_variable m_queryAdded;
+    Query m_pendingQuery;                // Guarded by m_mutex
+    bool m_hasPendingQuery;              // Guarded by m_mutex
+    bool m_isStopping;                   // Guarded by m_mutex
+    std::unique_ptr<Matches> m_matches;  // Guarded by m_mutex
+    std::thread m_thread;
+};
+
+} // namespace Core
+
+#endif // LOCATEITEMSMODEL_H
@@ -0,0 +1,147 @@
+#include "pathvalidator.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iterator>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+
+namespace Core {
+
+namespace {
+
+/// Enough to validate the first screen with the first batch.
+const uint32_t BatchSize = 256;
+
+Utils::FileUtils::FileInfo validatePath(const char *path)
+{
+    Utils::FileUtils::FileInfo info;
+    info.isProbed = true;
+    if (! *path)
+        return info; // Of a separating empty line
+
+    mode_t mode;
+    struct statx s;
+    if (statx(AT_FDCWD, path, AT_STATX_DONT_SYNC, STATX_TYPE | STATX_MODE, &s) == 0) {
+        mode = s.stx_mode;
+    } else if (errno == ENOSYS) {
+        // Kernels before 4.11
+        return Utils::FileUtils::FileInfo(path);
+    } else {
+        info.error = errno;
+        return info;
+    }
+
+    info.exists = true;
+    info.isExecutable = mode & S_IXUSR;
+    info.isDirectory = S_ISDIR(mode);
+    info.isRegularFile = S_ISREG(mode);
+    return info;
+}
+
+} // anonymous
+
+PathValidator::PathValidator(unsigned threadCount) throw(std::runtime_error)
+    : m_state(std::make_shared<State>())
+    , m_threadCount(std::max(threadCount, 1u))
+    , m_startedThreadCount(0)
+{
+    m_state->generation = 0;
+    m_state->isStopping = false;
+}
+
+PathValidator::~PathValidator()
+{
+    {
+        std::lock_guard<std::mutex> locker(m_state->mutex);
+        m_state->isStopping = true;
+        m_state->batches.clear();
+    }
+    m_state->batchAdded.notify_all();
+}
+
+int PathValidator::notificationDescriptor() const
+{
+    return m_state->notifier.fileDescriptor();
+}
+
+void PathValidator::validate(unsigned generation, const ItemStore &items,
+                             uint32_t beginRow, uint32_t endRow)
+{
+    std::deque<Batch> batches;
+    for (uint32_t row = beginRow; row < endRow; ) {
+        Batch batch;
+        batch.generation = generation;
+        batch.firstRow = row;
+        batch.count = std::min(BatchSize, endRow - row);
+        for (const uint32_t batchEnd = row + batch.count; row < batchEnd; ++row) {
+            const Utils::StringUtils::StringRef path = items.path(row);
+            batch.paths.append(path.begin(), path.end());
+            batch.paths.push_back('\0');
+        }
+        batches.push_back(std::move(batch));
+    }
+    if (batches.empty())
+        return;
+
+    {
+        std::lock_guard<std::mutex> locker(m_state->mutex);
+        m_state->generation = generation;
+        std::move(batches.begin(), batches.end(), std::back_inserter(m_state->batches));
+    }
+    for (; m_startedThreadCount < std::min<std::size_t>(m_threadCount, batches.size());
+         ++m_startedThreadCount) {
+        std::thread(&PathValidator::work, m_state).detach();
+    }
+    m_state->batchAdded.notify_all();
+}
+
+std::vector<PathValidator::Result> PathValidator::takeResults()
+{
+    m_state->notifier.clear();
+    std::vector<Result> results;
+    std::lock_guard<std::mutex> locker(m_state->mutex);
+    results.swap(m_state->results);
+    return results;
+}
+
+void PathValidator::work(std::shared_ptr<State> state)
+{
+    for (;;) {
+        Batch batch;
+        {
+            std::unique_lock<std::mutex> locker(state->mutex);
+            state->batchAdded.wait(locker, [&state]() {
+                return state->isStopping || ! state->batches.empty();
+            });
+            if (state->isStopping)
+                return;
+            batch = std::move(state->batches.front());
+            state->batches.pop_front();
+            if (batch.generation != state->generation)
+                continue; // Outdated
+        }
+
+        Result result;
+        result.generation = batch.generation;
+        result.firstRow = batch.firstRow;
+        result.infos.reserve(batch.count);
+        for (const char *path = batch.paths.data(); result.infos.size() < batch.count;
+             path += std::strlen(path) + 1) {
+            result.infos.push_back(validatePath(path));
+        }
+
+        {
+            std::lock_guard<std::mutex> locker(state->mutex);
+            if (state->isStopping)
+                return;
+            state->results.push_back(std::move(result));
+        }
+        state->notifier.notify();
+    }
+}
+
+} // namespace Core
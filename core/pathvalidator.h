@@ -0,0 +1,79 @@
+#ifndef PATHVALIDATOR_H
+#define PATHVALIDATOR_H
+
+#include "itemstore.h"
+
+#include "utils/fileutils.h"
+#include "utils/notifier.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace Core {
+
+/// Gets the FileInfo of the paths of many items at once, in batches fanned out
+/// across threads of its own. statx() is asked not to sync with the server, so
+/// network file systems answer from their attribute cache if they can. As with
+/// Utils::FileUtils::FileProber, a thread hung in the kernel is never waited for.
+class PathValidator
+{
+public:
+    struct Result
+    {
+        unsigned generation;
+        uint32_t firstRow;
+        std::vector<Utils::FileUtils::FileInfo> infos; ///< Of the rows from firstRow on
+    };
+
+    explicit PathValidator(unsigned threadCount = 8) throw(std::runtime_error);
+    ~PathValidator();
+
+    /// Readable once results are available, see takeResults().
+    int notificationDescriptor() const;
+
+    /// Validates the paths of the rows [beginRow, endRow). The paths are copied.
+    /// Batches of older generations that did not start yet are dropped.
+    void validate(unsigned generation, const ItemStore &items, uint32_t beginRow, uint32_t endRow);
+    /// Returns the results so far and clears the notification.
+    std::vector<Result> takeResults();
+
+private:
+    PathValidator(const PathValidator &) = delete;
+    PathValidator &operator=(const PathValidator &) = delete;
+
+    struct Batch
+    {
+        unsigned generation;
+        uint32_t firstRow;
+        uint32_t count;
+        std::string paths; ///< Null terminated one after the other
+    };
+
+    /// Shared with the threads, which might outlive the validator.
+    struct State
+    {
+        Utils::Notifier notifier;
+        std::mutex mutex;
+        std::condition_variable batchAdded;
+        std::deque<Batch> batches;   // Guarded by mutex
+        std::vector<Result> results; // Guarded by mutex
+        unsigned generation;         // Guarded by mutex
+        bool isStopping;             // Guarded by mutex
+    };
+
+    static void work(std::shared_ptr<State> state);
+
+    std::shared_ptr<State> m_state;
+    unsigned m_threadCount;
+    unsigned m_startedThreadCount;
+};
+
+} // namespace Core
+
+#endif // PATHVALIDATOR_H
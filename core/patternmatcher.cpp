@@ -0,0 +1,557 @@
+#include "patternmatcher.h"
+
+#include <algorithm>
+#include <map>
+
+namespace Core {
+
+namespace {
+
+const std::size_t MaximumNodeCount = 10000;
+const std::size_t MaximumStateCount = 10000;
+const int MaximumRepetitionCount = 1000;
+
+const int BeginSymbol = 256;
+const int EndSymbol = 257;
+const uint32_t DeadState = 0;
+/// Marks transitions to states that end matching, dead or accepting ones.
+const uint32_t StopFlag = 0x80000000;
+
+} // anonymous
+
+/// Parsed pattern
+struct PatternMatcher::Regex
+{
+    enum Type { Empty, Set, Begin, End, Concat, Alternate, Repeat };
+
+    explicit Regex(Type type = Empty) : type(type), min(0), max(0) {}
+
+    Type type;
+    std::bitset<256> set;
+    std::vector<Regex> children;
+    int min;
+    int max; ///< -1 for no limit
+};
+
+class PatternMatcher::Parser
+{
+public:
+    Parser(const std::string &pattern, bool isCaseFolded)
+        : m_pattern(pattern), m_position(0), m_isCaseFolded(isCaseFolded) {}
+
+    Regex parseRegularExpression() throw(std::runtime_error);
+    Regex parseGlob() throw(std::runtime_error);
+
+private:
+    static Regex setRegex(const std::bitset<256> &set);
+    static Regex repeatRegex(const Regex &child, int min, int max);
+
+    bool atEnd() const { return m_position == m_pattern.size(); }
+    char peek() const { return m_pattern[m_position]; }
+
+    Regex parseAlternation() throw(std::runtime_error);
+    Regex parseConcatenation() throw(std::runtime_error);
+    Regex parseRepetition() throw(std::runtime_error);
+    Regex parseAtom() throw(std::runtime_error);
+    int parseNumber() throw(std::runtime_error);
+    std::bitset<256> parseClass(char negation) throw(std::runtime_error);
+    bool addEscapedClass(char c, std::bitset<256> &set) const;
+    void addCharacter(char c, std::bitset<256> &set) const;
+    std::bitset<256> characterSet(char c) const;
+
+    const std::string &m_pattern;
+    std::size_t m_position;
+    bool m_isCaseFolded;
+};
+
+PatternMatcher::Regex PatternMatcher::Parser::setRegex(const std::bitset<256> &set)
+{
+    Regex regex(Regex::Set);
+    regex.set = set;
+    return regex;
+}
+
+PatternMatcher::Regex PatternMatcher::Parser::repeatRegex(const Regex &child, int min, int max)
+{
+    Regex regex(Regex::Repeat);
+    regex.children.push_back(child);
+    regex.min = min;
+    regex.max = max;
+    return regex;
+}
+
+PatternMatcher::Regex PatternMatcher::Parser::parseRegularExpression() throw(std::runtime_error)
+{
+    const Regex regex = parseAlternation();
+    if (! atEnd())
+        throw std::runtime_error("Unmatched )");
+    return regex;
+}
+
+PatternMatcher::Regex PatternMatcher::Parser::parseGlob() throw(std::runtime_error)
+{
+    std::bitset<256> anyCharacter;
+    anyCharacter.set();
+    std::bitset<256> fileNameCharacter = anyCharacter;
+    fileNameCharacter.reset('/');
+
+    Regex glob(Regex::Concat);
+    glob.children.push_back(Regex(Regex::Begin));
+    while (! atEnd()) {
+        const char c = m_pattern[m_position++];
+        if (c == '*' && ! atEnd() && peek() == '*') {
+            ++m_position;
+            const Regex anything = repeatRegex(setRegex(anyCharacter), 0, -1);
+            if (! atEnd() && peek() == '/') {
+                // Zero or more directories
+                ++m_position;
+                Regex directories(Regex::Concat);
+                directories.children.push_back(anything);
+                directories.children.push_back(setRegex(characterSet('/')));
+                glob.children.push_back(repeatRegex(directories, 0, 1));
+            } else {
+                glob.children.push_back(anything);
+            }
+        } else if (c == '*') {
+            glob.children.push_back(repeatRegex(setRegex(fileNameCharacter), 0, -1));
+        } else if (c == '?') {
+            glob.children.push_back(setRegex(fileNameCharacter));
+        } else if (c == '[') {
+            std::bitset<256> set = parseClass('!');
+            set.reset('/'); // Only matched literally
+            glob.children.push_back(setRegex(set));
+        } else if (c == '\\' && ! atEnd()) {
+            glob.children.push_back(setRegex(characterSet(m_pattern[m_position++])));
+        } else {
+            glob.children.push_back(setRegex(characterSet(c)));
+        }
+    }
+    glob.children.push_back(Regex(Regex::End));
+    return glob;
+}
+
+PatternMatcher::Regex PatternMatcher::Parser::parseAlternation() throw(std::runtime_error)
+{
+    Regex alternation(Regex::Alternate);
+    alternation.children.push_back(parseConcatenation());
+    while (! atEnd() && peek() == '|') {
+        ++m_position;
+        alternation.children.push_back(parseConcatenation());
+    }
+    return alternation.children.size() == 1 ? alternation.children.front() : alternation;
+}
+
+PatternMatcher::Regex PatternMatcher::Parser::parseConcatenation() throw(std::runtime_error)
+{
+    Regex concatenation(Regex::Concat);
+    while (! atEnd() && peek() != '|' && peek() != ')')
+        concatenation.children.push_back(parseRepetition());
+    return concatenation;
+}
+
+PatternMatcher::Regex PatternMatcher::Parser::parseRepetition() throw(std::runtime_error)
+{
+    Regex regex = parseAtom();
+    while (! atEnd()) {
+        const char c = peek();
+        if (c == '*') {
+            regex = repeatRegex(regex, 0, -1);
+        } else if (c == '+') {
+            regex = repeatRegex(regex, 1, -1);
+        } else if (c == '?') {
+            regex = repeatRegex(regex, 0, 1);
+        } else if (c == '{') {
+            ++m_position;
+            const int min = parseNumber();
+            int max = min;
+            if (! atEnd() && peek() == ',') {
+                ++m_position;
+                max = ! atEnd() && peek() == '}' ? -1 : parseNumber();
+            }
+            if (atEnd() || peek() != '}')
+                throw std::runtime_error("Missing }");
+            if (max != -1 && max < min)
+                throw std::runtime_error("Invalid repetition");
+            regex = repeatRegex(regex, min, max);
+        } else {
+            break;
+        }
+        ++m_position;
+    }
+    return regex;
+}
+
+PatternMatcher::Regex PatternMatcher::Parser::parseAtom() throw(std::runtime_error)
+{
+    const char c = m_pattern[m_position++];
+    switch (c) {
+    case '(': {
+        const Regex regex = parseAlternation();
+        if (atEnd())
+            throw std::runtime_error("Missing )");
+        ++m_position;
+        return regex;
+    }
+    case '[':
+        return setRegex(parseClass('^'));
+    case '.':
+        return setRegex(std::bitset<256>().set());
+    case '^':
+        return Regex(Regex::Begin);
+    case '$':
+        return Regex(Regex::End);
+    case '*':
+    case '+':
+    case '?':
+    case '{':
+        throw std::runtime_error(std::string("Nothing to repeat by ") + c);
+    case '\\': {
+        if (atEnd())
+            throw std::runtime_error("Trailing \\");
+        const char escaped = m_pattern[m_position++];
+        std::bitset<256> set;
+        if (! addEscapedClass(escaped, set))
+            addCharacter(escaped, set);
+        return setRegex(set);
+    }
+    default:
+        return setRegex(characterSet(c));
+    }
+}
+
+int PatternMatcher::Parser::parseNumber() throw(std::runtime_error)
+{
+    int number = 0;
+    const std::size_t begin = m_position;
+    while (! atEnd() && peek() >= '0' && peek() <= '9') {
+        number = number * 10 + (m_pattern[m_position++] - '0');
+        if (number > MaximumRepetitionCount)
+            throw std::runtime_error("Too many repetitions");
+    }
+    if (m_position == begin)
+        throw std::runtime_error("Invalid repetition");
+    return number;
+}
+
+/// After the opening '['. A closing ']' right at the beginning is a member.
+std::bitset<256> PatternMatcher::Parser::parseClass(char negation) throw(std::runtime_error)
+{
+    std::bitset<256> set;
+    const bool isNegated = ! atEnd() && peek() == negation;
+    if (isNegated)
+        ++m_position;
+
+    for (bool isFirst = true; ; isFirst = false) {
+        if (atEnd())
+            throw std::runtime_error("Missing ]");
+        char c = m_pattern[m_position++];
+        if (c == ']' && ! isFirst)
+            break;
+        if (c == '\\' && ! atEnd()) {
+            c = m_pattern[m_position++];
+            if (addEscapedClass(c, set))
+                continue;
+        }
+        if (m_position + 1 < m_pattern.size() && peek() == '-' && m_pattern[m_position + 1] != ']') {
+            const char last = m_pattern[m_position + 1];
+            m_position += 2;
+            if (static_cast<unsigned char>(last) < static_cast<unsigned char>(c))
+                throw std::runtime_error("Invalid range");
+            for (int member = static_cast<unsigned char>(c);
+                 member <= static_cast<unsigned char>(last); ++member) {
+                addCharacter(static_cast<char>(member), set);
+            }
+        } else {
+            addCharacter(c, set);
+        }
+    }
+
+    return isNegated ? ~set : set;
+}
+
+bool PatternMatcher::Parser::addEscapedClass(char c, std::bitset<256> &set) const
+{
+    std::bitset<256> members;
+    switch (c) {
+    case 'd': case 'D':
+        for (int member = '0'; member <= '9'; ++member)
+            members.set(member);
+        break;
+    case 'w': case 'W':
+        for (int member = 0; member < 256; ++member) {
+            if ((member >= '0' && member <= '9') || (member >= 'a' && member <= 'z')
+                    || (member >= 'A' && member <= 'Z') || member == '_') {
+                members.set(member);
+            }
+        }
+        break;
+    case 's': case 'S':
+        for (const char member : std::string(" \t\n\r\f\v"))
+            members.set(static_cast<unsigned char>(member));
+        break;
+    default:
+        return false;
+    }
+    set |= c >= 'A' && c <= 'Z' ? ~members : members;
+    return true;
+}
+
+/// Folded strings contain no upper case characters, so match their lower case ones.
+void PatternMatcher::Parser::addCharacter(char c, std::bitset<256> &set) const
+{
+    set.set(static_cast<unsigned char>(c));
+    if (m_isCaseFolded && c >= 'A' && c <= 'Z')
+        set.set(static_cast<unsigned char>(c - 'A' + 'a'));
+}
+
+std::bitset<256> PatternMatcher::Parser::characterSet(char c) const
+{
+    std::bitset<256> set;
+    addCharacter(c, set);
+    return set;
+}
+
+PatternMatcher::PatternMatcher(const std::string &pattern, Syntax syntax, bool isCaseFolded)
+    throw(std::runtime_error)
+{
+    Parser parser(pattern, isCaseFolded);
+    const Regex regex = syntax == Glob ? parser.parseGlob() : parser.parseRegularExpression();
+
+    m_patternStart = compile(regex, addNode(Node::Match, -1));
+    if (syntax == Glob) {
+        // Anchored anyway
+        m_searchStart = m_patternStart;
+    } else {
+        // The match may start anywhere: Skip the beginning of the text and any bytes.
+        std::bitset<256> anyByte;
+        anyByte.set();
+        m_sets.push_back(anyByte);
+        const int loop = addNode(Node::Split, -1, m_patternStart);
+        const int skipByte = addNode(Node::Set, loop, -1, m_sets.size() - 1);
+        m_nodes[loop].out = skipByte;
+        const int skipBegin = addNode(Node::Begin, loop);
+        m_searchStart = addNode(Node::Split, skipBegin, m_patternStart);
+    }
+
+    compileDfa();
+}
+
+bool PatternMatcher::matches(const char *begin, const char *end) const
+{
+    const uint32_t *transitions = m_transitions.data();
+    uint32_t transition = transitions[m_startState + m_beginSymbol];
+    for (const char *c = begin; ! (transition & StopFlag) && c != end; ++c)
+        transition = transitions[transition + m_byteClasses[static_cast<unsigned char>(*c)]];
+    if (! (transition & StopFlag))
+        transition = transitions[transition + m_endSymbol];
+    return m_isAccepting[(transition & ~StopFlag) / (m_classCount + 2)];
+}
+
+bool PatternMatcher::find(const char *begin, const char *end,
+                          uint32_t &matchBegin, uint32_t &matchEnd) const
+{
+    const auto containsMatch = [this](const std::vector<int> &nodes) {
+        return std::find_if(nodes.begin(), nodes.end(), [this](int node) {
+            return m_nodes[node].type == Node::Match;
+        }) != nodes.end();
+    };
+
+    std::vector<int> nodes;
+    std::vector<int> nextNodes;
+    std::vector<bool> isAdded(m_nodes.size());
+    for (const char *start = begin; start <= end; ++start) {
+        nodes.clear();
+        std::fill(isAdded.begin(), isAdded.end(), false);
+        addClosure(m_patternStart, nodes, isAdded);
+        if (start == begin) {
+            // Anchors for the beginning of the text match here.
+            step(nodes, BeginSymbol, nextNodes);
+            for (const int node : nextNodes) {
+                if (! isAdded[node]) {
+                    isAdded[node] = true;
+                    nodes.push_back(node);
+                }
+            }
+        }
+
+        const char *longestEnd = 0;
+        for (const char *c = start; ! nodes.empty(); ++c) {
+            if (containsMatch(nodes))
+                longestEnd = c;
+            if (c == end) {
+                step(nodes, EndSymbol, nextNodes);
+                if (containsMatch(nextNodes))
+                    longestEnd = c;
+                break;
+            }
+            step(nodes, static_cast<unsigned char>(*c), nextNodes);
+            nodes.swap(nextNodes);
+        }
+
+        if (longestEnd) {
+            matchBegin = start - begin;
+            matchEnd = longestEnd - begin;
+            return true;
+        }
+    }
+    return false;
+}
+
+int PatternMatcher::addNode(Node::Type type, int out, int out1, int set) throw(std::runtime_error)
+{
+    if (m_nodes.size() == MaximumNodeCount)
+        throw std::runtime_error("Pattern too long");
+    Node node;
+    node.type = type;
+    node.out = out;
+    node.out1 = out1;
+    node.set = set;
+    m_nodes.push_back(node);
+    return m_nodes.size() - 1;
+}
+
+/// Builds the nodes backwards, so each fragment knows its successor right away.
+int PatternMatcher::compile(const Regex &regex, int next) throw(std::runtime_error)
+{
+    switch (regex.type) {
+    case Regex::Empty:
+        return next;
+    case Regex::Set:
+        m_sets.push_back(regex.set);
+        return addNode(Node::Set, next, -1, m_sets.size() - 1);
+    case Regex::Begin:
+        return addNode(Node::Begin, next);
+    case Regex::End:
+        return addNode(Node::End, next);
+    case Regex::Concat:
+        for (auto child = regex.children.rbegin(); child != regex.children.rend(); ++child)
+            next = compile(*child, next);
+        return next;
+    case Regex::Alternate: {
+        int start = compile(regex.children.back(), next);
+        for (std::size_t i = regex.children.size() - 1; i-- > 0; )
+            start = addNode(Node::Split, compile(regex.children[i], next), start);
+        return start;
+    }
+    case Regex::Repeat: {
+        const Regex &child = regex.children.front();
+        int start = next;
+        if (regex.max == -1) {
+            const int loop = addNode(Node::Split, -1, next);
+            const int body = compile(child, loop); // Adds nodes, so assign afterwards
+            m_nodes[loop].out = body;
+            start = loop;
+        } else {
+            for (int i = regex.min; i < regex.max; ++i)
+                start = addNode(Node::Split, compile(child, start), next);
+        }
+        for (int i = 0; i < regex.min; ++i)
+            start = compile(child, start);
+        return start;
+    }
+    }
+    return next;
+}
+
+/// Subset construction over the classes of bytes that no set of the pattern tells apart.
+void PatternMatcher::compileDfa() throw(std::runtime_error)
+{
+    std::map<std::vector<bool>, int> classes;
+    int representatives[256 + 2];
+    for (int byte = 0; byte < 256; ++byte) {
+        std::vector<bool> membership(m_sets.size());
+        for (std::size_t i = 0; i < m_sets.size(); ++i)
+            membership[i] = m_sets[i][byte];
+        const auto inserted = classes.insert(std::make_pair(membership, int(classes.size())));
+        m_byteClasses[byte] = inserted.first->second;
+        if (inserted.second)
+            representatives[inserted.first->second] = byte;
+    }
+    m_classCount = classes.size();
+    m_beginSymbol = m_classCount;
+    m_endSymbol = m_classCount + 1;
+    representatives[m_beginSymbol] = BeginSymbol;
+    representatives[m_endSymbol] = EndSymbol;
+    const int symbolCount = m_classCount + 2;
+
+    std::vector<std::vector<int>> states;
+    std::map<std::vector<int>, uint32_t> stateIds;
+    const auto addState = [&](const std::vector<int> &nodes) -> uint32_t {
+        const auto it = stateIds.find(nodes);
+        if (it != stateIds.end())
+            return it->second;
+        if (states.size() == MaximumStateCount)
+            throw std::runtime_error("Pattern too complex");
+        const uint32_t state = states.size();
+        stateIds[nodes] = state;
+        states.push_back(nodes);
+        m_isAccepting.push_back(std::find_if(nodes.begin(), nodes.end(), [this](int node) {
+            return m_nodes[node].type == Node::Match;
+        }) != nodes.end());
+        return state;
+    };
+
+    addState(std::vector<int>()); // DeadState
+    std::vector<int> nodes;
+    std::vector<bool> isAdded(m_nodes.size());
+    addClosure(m_searchStart, nodes, isAdded);
+    std::sort(nodes.begin(), nodes.end());
+    m_startState = addState(nodes) * symbolCount;
+
+    // The transitions hold the offset of the target's transitions, see matches().
+    for (uint32_t state = 0; state < states.size(); ++state) {
+        for (int symbol = 0; symbol < symbolCount; ++symbol) {
+            step(states[state], representatives[symbol], nodes);
+            std::sort(nodes.begin(), nodes.end());
+            const uint32_t target = addState(nodes);
+            const bool isStop = target == DeadState || m_isAccepting[target];
+            m_transitions.push_back(target * symbolCount | (isStop ? StopFlag : 0));
+        }
+    }
+}
+
+/// Adds node and the nodes reachable from it without consuming input, except for splits.
+void PatternMatcher::addClosure(int node, std::vector<int> &nodes, std::vector<bool> &isAdded) const
+{
+    std::vector<int> pending(1, node);
+    while (! pending.empty()) {
+        const int current = pending.back();
+        pending.pop_back();
+        if (current == -1 || isAdded[current])
+            continue;
+        isAdded[current] = true;
+        if (m_nodes[current].type == Node::Split) {
+            pending.push_back(m_nodes[current].out1);
+            pending.push_back(m_nodes[current].out);
+        } else {
+            nodes.push_back(current);
+        }
+    }
+}
+
+/// The closure of the nodes after consuming symbol, a byte, BeginSymbol or EndSymbol.
+void PatternMatcher::step(const std::vector<int> &nodes, int symbol, std::vector<int> &result) const
+{
+    result.clear();
+    std::vector<bool> isAdded(m_nodes.size());
+    for (const int node : nodes) {
+        const Node &current = m_nodes[node];
+        const bool isConsumed =
+            (current.type == Node::Set && symbol < 256 && m_sets[current.set][symbol])
+            || (current.type == Node::Begin && symbol == BeginSymbol)
+            || (current.type == Node::End && symbol == EndSymbol);
+        if (isConsumed)
+            addClosure(current.out, result, isAdded);
+    }
+
+    // Anchors do not consume anything, so "$$" matches one end.
+    if (symbol == BeginSymbol || symbol == EndSymbol) {
+        const Node::Type anchor = symbol == BeginSymbol ? Node::Begin : Node::End;
+        for (std::size_t i = 0; i < result.size(); ++i) {
+            if (m_nodes[result[i]].type == anchor)
+                addClosure(m_nodes[result[i]].out, result, isAdded);
+        }
+    }
+}
+
+} // namespace Core
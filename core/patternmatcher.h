@@ -0,0 +1,74 @@
+#ifndef PATTERNMATCHER_H
+#define PATTERNMATCHER_H
+
+#include <bitset>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace Core {
+
+/// Matches a regular expression or a glob, compiled to a DFA up front. So each
+/// string is matched in one pass over its bytes, without backtracking, and a
+/// matcher can be shared by threads.
+///
+/// Regular expressions are searched for anywhere in the string. Supported are
+/// . [] [^] * + ? {m} {m,} {m,n} | () ^ $ and the escapes \d \w \s \D \W \S.
+///
+/// Globs match the whole string. * and ? match anything but '/', ** matches
+/// across directories, "**/" matches zero or more directories, [] and [!] match
+/// character classes.
+class PatternMatcher
+{
+public:
+    enum Syntax { RegularExpression, Glob };
+
+    /// With isCaseFolded, the strings to match are folded to lower case (ASCII
+    /// only) and the pattern is folded accordingly. Throws with a message for
+    /// the user if the pattern is invalid or too complex.
+    PatternMatcher(const std::string &pattern, Syntax syntax, bool isCaseFolded)
+        throw(std::runtime_error);
+
+    bool matches(const char *begin, const char *end) const;
+    /// The leftmost, longest match in [begin, end) as offsets. Returns false if
+    /// there is none. Only meant for a few strings, it simulates the NFA.
+    bool find(const char *begin, const char *end, uint32_t &matchBegin, uint32_t &matchEnd) const;
+
+private:
+    struct Regex;
+    class Parser;
+
+    struct Node
+    {
+        enum Type { Set, Split, Begin, End, Match };
+        Type type;
+        int out;
+        int out1;   // Split only
+        int set;    // Set only, index into m_sets
+    };
+
+    int addNode(Node::Type type, int out, int out1 = -1, int set = -1) throw(std::runtime_error);
+    int compile(const Regex &regex, int next) throw(std::runtime_error);
+    void compileDfa() throw(std::runtime_error);
+    void addClosure(int node, std::vector<int> &nodes, std::vector<bool> &isAdded) const;
+    void step(const std::vector<int> &nodes, int symbol, std::vector<int> &result) const;
+
+    std::vector<Node> m_nodes;
+    std::vector<std::bitset<256>> m_sets;
+    int m_patternStart;  // The pattern itself
+    int m_searchStart;   // Preceded by a loop over any text
+
+    // DFA over byte classes plus the symbols for the beginning and end of text.
+    uint8_t m_byteClasses[256];
+    int m_classCount;
+    int m_beginSymbol;
+    int m_endSymbol;
+    std::vector<uint32_t> m_transitions; // At state * (m_classCount + 2) + symbol
+    std::vector<uint8_t> m_isAccepting;
+    uint32_t m_startState; // Offset in m_transitions
+};
+
+} // namespace Core
+
+#endif // PATTERNMATCHER_H
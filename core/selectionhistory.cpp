@@ -0,0 +1,271 @@
+#include "selectionhistory.h"
+
+#include "utils/fileutils.h"
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace Core {
+
+namespace {
+
+const char Magic[8] = { 'G', 'O', 'T', 'O', 'H', 'S', 'T', '\0' };
+const uint32_t Version = 1;
+
+struct Header
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t entryCount;
+};
+
+/// rank, lastTime and the path length
+const std::size_t SnapshotEntrySize = sizeof(double) + sizeof(int64_t) + sizeof(uint32_t);
+/// checksum, the path length and time
+const std::size_t SelectionSize = 2 * sizeof(uint32_t) + sizeof(int64_t);
+
+const int64_t Hour = 60 * 60;
+const int64_t Day = 24 * Hour;
+const int64_t Week = 7 * Day;
+
+// FNV-1a
+uint32_t checksum(const char *begin, const char *end)
+{
+    uint64_t result = 14695981039346656037ULL;
+    for (const char *c = begin; c != end; ++c) {
+        result ^= static_cast<unsigned char>(*c);
+        result *= 1099511628211ULL;
+    }
+    return static_cast<uint32_t>(result ^ (result >> 32));
+}
+
+bool isInside(uint64_t offset, uint64_t length, uint64_t size)
+{
+    return offset <= size && length <= size - offset;
+}
+
+/// Closes the file, which releases its lock, too.
+struct FileDescriptor
+{
+    explicit FileDescriptor(int fileDescriptor) : fd(fileDescriptor) {}
+    ~FileDescriptor() { if (fd != -1) close(fd); }
+
+    int fd;
+};
+
+bool readAll(int fd, std::string &contents)
+{
+    contents.clear();
+    char buffer[65536];
+    for (;;) {
+        const ssize_t count = pread(fd, buffer, sizeof(buffer), contents.size());
+        if (count == -1)
+            return false;
+        if (count == 0)
+            return true;
+        contents.append(buffer, count);
+    }
+}
+
+} // anonymous
+
+SelectionHistory::SelectionHistory(const std::string &filePath)
+    : m_filePath(filePath)
+{
+}
+
+bool SelectionHistory::load()
+{
+    m_entries.clear();
+    const FileDescriptor file(open(m_filePath.c_str(), O_RDONLY | O_CLOEXEC));
+    std::string contents;
+    if (file.fd == -1 || ! readAll(file.fd, contents))
+        return false;
+    // Without a lock, a selection might be appended meanwhile. Its checksum
+    // fails then, so it is left out.
+    Log log;
+    parse(contents, log);
+    return log.hasHeader;
+}
+
+void SelectionHistory::record(const std::string &path, int64_t time) throw(std::runtime_error)
+{
+    // Another instance might replace the file by compacting it until it is locked.
+    std::unique_ptr<FileDescriptor> file;
+    for (;;) {
+        file.reset(new FileDescriptor(open(m_filePath.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600)));
+        if (file->fd == -1 || flock(file->fd, LOCK_EX) == -1)
+            throw std::runtime_error("Failed to open file \"" + m_filePath + "\"");
+        struct stat opened, current;
+        if (fstat(file->fd, &opened) == 0 && stat(m_filePath.c_str(), &current) == 0
+                && opened.st_dev == current.st_dev && opened.st_ino == current.st_ino) {
+            break;
+        }
+    }
+
+    // Other instances might have appended selections since load().
+    std::string contents;
+    if (! readAll(file->fd, contents))
+        throw std::runtime_error("Failed to read file \"" + m_filePath + "\"");
+    Log log;
+    parse(contents, log);
+    select(path, time);
+
+    if (! log.hasHeader || log.selectionCount + 1 >= CompactionThreshold) {
+        Utils::FileUtils::writeFileAtomically(m_filePath, compact());
+        return;
+    }
+
+    std::string selection(SelectionSize, '\0');
+    const uint32_t pathLength = path.size();
+    std::memcpy(&selection[sizeof(uint32_t)], &pathLength, sizeof(uint32_t));
+    std::memcpy(&selection[2 * sizeof(uint32_t)], &time, sizeof(int64_t));
+    selection += path;
+    const uint32_t sum = checksum(selection.data() + sizeof(uint32_t),
+                                  selection.data() + selection.size());
+    std::memcpy(&selection[0], &sum, sizeof(uint32_t));
+
+    // Cut off a torn selection, it would hide the ones behind.
+    if ((log.validSize != contents.size() && ftruncate(file->fd, log.validSize) == -1)
+            || pwrite(file->fd, selection.data(), selection.size(), log.validSize)
+                != ssize_t(selection.size())) {
+        throw std::runtime_error("Failed to write file \"" + m_filePath + "\"");
+    }
+}
+
+double SelectionHistory::score(const std::string &path, int64_t time) const
+{
+    const std::unordered_map<std::string, Entry>::const_iterator it = m_entries.find(path);
+    if (it == m_entries.end())
+        return 0;
+
+    const Entry &entry = it->second;
+    const int64_t age = time - entry.lastTime;
+    if (age < Hour)
+        return entry.rank * 4;
+    if (age < Day)
+        return entry.rank * 2;
+    if (age < Week)
+        return entry.rank / 2;
+    return entry.rank / 4;
+}
+
+/// Reads the snapshot and applies the intact selections appended since.
+void SelectionHistory::parse(const std::string &contents, Log &log)
+{
+    m_entries.clear();
+    log = Log();
+    if (contents.size() < sizeof(Header))
+        return;
+
+    Header header;
+    std::memcpy(&header, contents.data(), sizeof(Header));
+    if (std::memcmp(header.magic, Magic, sizeof(Magic)) != 0 || header.version != Version)
+        return;
+
+    const char *data = contents.data();
+    const std::size_t size = contents.size();
+    std::size_t offset = sizeof(Header);
+    m_entries.reserve(std::min<std::size_t>(header.entryCount, size / SnapshotEntrySize)
+                      + CompactionThreshold);
+    for (uint32_t i = 0; i < header.entryCount; ++i) {
+        Entry entry;
+        uint32_t pathLength;
+        if (! isInside(offset, SnapshotEntrySize, size)) {
+            m_entries.clear();
+            return;
+        }
+        std::memcpy(&entry.rank, data + offset, sizeof(double));
+        std::memcpy(&entry.lastTime, data + offset + sizeof(double), sizeof(int64_t));
+        std::memcpy(&pathLength, data + offset + sizeof(double) + sizeof(int64_t), sizeof(uint32_t));
+        offset += SnapshotEntrySize;
+        if (! isInside(offset, pathLength, size)) {
+            m_entries.clear();
+            return;
+        }
+        m_entries[std::string(data + offset, pathLength)] = entry;
+        offset += pathLength;
+    }
+    log.hasHeader = true;
+    log.validSize = offset;
+
+    std::string path;
+    while (isInside(offset, SelectionSize, size)) {
+        uint32_t sum, pathLength;
+        int64_t time;
+        std::memcpy(&sum, data + offset, sizeof(uint32_t));
+        std::memcpy(&pathLength, data + offset + sizeof(uint32_t), sizeof(uint32_t));
+        std::memcpy(&time, data + offset + 2 * sizeof(uint32_t), sizeof(int64_t));
+        if (! isInside(offset + SelectionSize, pathLength, size)
+                || checksum(data + offset + sizeof(uint32_t),
+                            data + offset + SelectionSize + pathLength) != sum) {
+            break;
+        }
+        path.assign(data + offset + SelectionSize, pathLength);
+        select(path, time);
+        offset += SelectionSize + pathLength;
+        log.validSize = offset;
+        ++log.selectionCount;
+    }
+}
+
+void SelectionHistory::select(const std::string &path, int64_t time)
+{
+    Entry &entry = m_entries[path];
+    entry.rank += 1;
+    entry.lastTime = std::max(entry.lastTime, time);
+}
+
+/// Ages the ranks if needed and returns a log of just the snapshot of them.
+std::string SelectionHistory::compact()
+{
+    double rankSum = 0;
+    for (const auto &entry : m_entries)
+        rankSum += entry.second.rank;
+    if (rankSum > MaximumRankSum) {
+        const double factor = 0.9 * MaximumRankSum / rankSum;
+        for (auto it = m_entries.begin(); it != m_entries.end(); ) {
+            it->second.rank *= factor;
+            if (it->second.rank < 1)
+                it = m_entries.erase(it);
+            else
+                ++it;
+        }
+    }
+
+    std::vector<const std::pair<const std::string, Entry> *> entries;
+    entries.reserve(m_entries.size());
+    for (const auto &entry : m_entries)
+        entries.push_back(&entry);
+    std::sort(entries.begin(), entries.end(), [](const std::pair<const std::string, Entry> *lhs,
+                                                 const std::pair<const std::string, Entry> *rhs) {
+        return lhs->first < rhs->first;
+    });
+
+    Header header;
+    std::memset(&header, 0, sizeof(Header));
+    std::memcpy(header.magic, Magic, sizeof(Magic));
+    header.version = Version;
+    header.entryCount = entries.size();
+
+    std::string image(reinterpret_cast<const char *>(&header), sizeof(Header));
+    char record[SnapshotEntrySize];
+    for (const std::pair<const std::string, Entry> *entry : entries) {
+        const uint32_t pathLength = entry->first.size();
+        std::memcpy(record, &entry->second.rank, sizeof(double));
+        std::memcpy(record + sizeof(double), &entry->second.lastTime, sizeof(int64_t));
+        std::memcpy(record + sizeof(double) + sizeof(int64_t), &pathLength, sizeof(uint32_t));
+        image.append(record, SnapshotEntrySize);
+        image += entry->first;
+    }
+    return image;
+}
+
+} // namespace Core
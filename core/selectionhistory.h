@@ -0,0 +1,83 @@
+#ifndef SELECTIONHISTORY_H
+#define SELECTIONHISTORY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+
+namespace Core {
+
+/// The paths chosen in goto, ranked by frecency like zoxide does: Each
+/// selection adds 1 to the rank of a path, which is weighted by how recently
+/// it was selected last. Once the ranks sum up to more than MaximumRankSum,
+/// all are aged, so rarely used paths drop out.
+///
+/// Stored as a log (~/.goto.history), in native byte order:
+///   Header
+///   Snapshot entries[entryCount] - The ranks at the last compaction:
+///     double   rank
+///     int64_t  Time of the last selection, in seconds since the epoch
+///     uint32_t Length of the path, followed by it
+///   Selections appended since:
+///     uint32_t Checksum of the rest of the record
+///     uint32_t Length of the path
+///     int64_t  Time of the selection
+///     char     path[]
+///
+/// Loading applies the selections to the snapshot, and the snapshot is
+/// rewritten once there are CompactionThreshold selections. So loading costs
+/// time proportional to the paths ranked, not to all selections ever made.
+///
+/// A selection is appended by a single write(), a torn one fails its checksum
+/// and is cut off by the next record(). Compaction replaces the file
+/// atomically. Concurrent instances of goto serialize by flock().
+class SelectionHistory
+{
+public:
+    static const uint32_t CompactionThreshold = 256;
+    static const uint32_t MaximumRankSum = 10000;
+
+    explicit SelectionHistory(const std::string &filePath);
+
+    /// Returns false if there is no valid history, then it is empty.
+    bool load();
+    /// Appends a selection of path at time (seconds since the epoch) to the file,
+    /// compacting it if needed, and updates the ranks with the ones of the file.
+    void record(const std::string &path, int64_t time) throw(std::runtime_error);
+
+    bool isEmpty() const { return m_entries.empty(); }
+    std::size_t size() const { return m_entries.size(); }
+    /// Frecency of path at time, 0 if it was never selected.
+    double score(const std::string &path, int64_t time) const;
+
+private:
+    struct Entry
+    {
+        Entry() : rank(0), lastTime(0) {}
+
+        double rank;
+        int64_t lastTime;
+    };
+
+    struct Log
+    {
+        Log() : hasHeader(false), validSize(0), selectionCount(0) {}
+
+        bool hasHeader;
+        std::size_t validSize;     ///< Up to the last intact selection
+        uint32_t selectionCount;   ///< Appended since the snapshot
+    };
+
+    void parse(const std::string &contents, Log &log);
+    void select(const std::string &path, int64_t time);
+    std::string compact();
+
+    const std::string m_filePath;
+    std::unordered_map<std::string, Entry> m_entries;
+};
+
+} // namespace Core
+
+#endif // SELECTIONHISTORY_H
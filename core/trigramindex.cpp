@@ -0,0 +1,149 @@
+#include "trigramindex.h"
+
+#include <algorithm>
+
+namespace Core {
+
+namespace {
+
+/// Intersecting with a posting list longer than this factor times the candidates
+/// found so far costs more than checking the candidates.
+const uint32_t IntersectionFactor = 16;
+
+unsigned char foldCase(char c)
+{
+    return c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c;
+}
+
+/// The trigrams of text, unsorted and not unique.
+void appendTrigrams(const char *begin, const char *end, std::vector<uint32_t> &trigrams)
+{
+    if (end - begin < TrigramIndex::MinimumNeedleSize)
+        return;
+    uint32_t trigram = foldCase(begin[0]) << 8 | foldCase(begin[1]);
+    for (const char *c = begin + 2; c != end; ++c) {
+        trigram = (trigram << 8 | foldCase(*c)) & 0xffffff;
+        trigrams.push_back(trigram);
+    }
+}
+
+void appendVarint(std::vector<uint8_t> &bytes, uint32_t value)
+{
+    while (value >= 0x80) {
+        bytes.push_back(static_cast<uint8_t>(value) | 0x80);
+        value >>= 7;
+    }
+    bytes.push_back(static_cast<uint8_t>(value));
+}
+
+const uint8_t *readVarint(const uint8_t *bytes, uint32_t &value)
+{
+    value = 0;
+    for (unsigned shift = 0; ; shift += 7) {
+        const uint8_t byte = *bytes++;
+        value |= static_cast<uint32_t>(byte & 0x7f) << shift;
+        if (! (byte & 0x80))
+            return bytes;
+    }
+}
+
+} // anonymous
+
+TrigramIndex::TrigramIndex()
+    : m_rowCount(0)
+{
+}
+
+std::size_t TrigramIndex::memoryUsage() const
+{
+    std::size_t size = m_lists.bucket_count() * sizeof(void *);
+    for (const auto &entry : m_lists)
+        size += sizeof(entry) + entry.second.deltas.capacity();
+    return size;
+}
+
+void TrigramIndex::clear()
+{
+    m_lists.clear();
+    m_rowCount = 0;
+}
+
+void TrigramIndex::append(const ItemStore &items, uint32_t end)
+{
+    std::vector<uint32_t> trigrams;
+    for (uint32_t row = m_rowCount; row < end; ++row) {
+        // The strings are indexed separately, as needles do not match across them.
+        trigrams.clear();
+        const Utils::StringUtils::StringRef identifier = items.identifier(row);
+        const Utils::StringUtils::StringRef pathDisplayed = items.pathDisplayed(row);
+        appendTrigrams(identifier.begin(), identifier.end(), trigrams);
+        appendTrigrams(pathDisplayed.begin(), pathDisplayed.end(), trigrams);
+        std::sort(trigrams.begin(), trigrams.end());
+        trigrams.erase(std::unique(trigrams.begin(), trigrams.end()), trigrams.end());
+
+        for (const uint32_t trigram : trigrams) {
+            PostingList &list = m_lists[trigram];
+            appendVarint(list.deltas, list.count ? row - list.lastRow : row);
+            list.lastRow = row;
+            ++list.count;
+        }
+    }
+    m_rowCount = std::max(m_rowCount, end);
+}
+
+bool TrigramIndex::findCandidates(const std::string &needle, uint32_t maximumCount,
+                                  std::vector<uint32_t> &rows) const
+{
+    rows.clear();
+    std::vector<uint32_t> trigrams;
+    appendTrigrams(needle.data(), needle.data() + needle.size(), trigrams);
+    if (trigrams.empty())
+        return false;
+    std::sort(trigrams.begin(), trigrams.end());
+    trigrams.erase(std::unique(trigrams.begin(), trigrams.end()), trigrams.end());
+
+    std::vector<const PostingList *> lists;
+    for (const uint32_t trigram : trigrams) {
+        const std::unordered_map<uint32_t, PostingList>::const_iterator it = m_lists.find(trigram);
+        if (it == m_lists.end())
+            return true; // No row contains the needle
+        lists.push_back(&it->second);
+    }
+    std::sort(lists.begin(), lists.end(), [](const PostingList *a, const PostingList *b) {
+        return a->count < b->count;
+    });
+    if (lists.front()->count > maximumCount)
+        return false;
+
+    // Start with the shortest list, intersect with the others while that pays off.
+    const PostingList &shortest = *lists.front();
+    rows.reserve(shortest.count);
+    const uint8_t *delta = shortest.deltas.data();
+    for (uint32_t i = 0, row = 0, value; i < shortest.count; ++i) {
+        delta = readVarint(delta, value);
+        row += value;
+        rows.push_back(row);
+    }
+
+    for (std::size_t i = 1; i < lists.size() && ! rows.empty(); ++i) {
+        const PostingList &list = *lists[i];
+        if (list.count > IntersectionFactor * rows.size())
+            break;
+
+        std::vector<uint32_t>::iterator kept = rows.begin();
+        std::vector<uint32_t>::const_iterator candidate = rows.begin();
+        const uint8_t *delta = list.deltas.data();
+        for (uint32_t j = 0, row = 0, value; j < list.count && candidate != rows.end(); ++j) {
+            delta = readVarint(delta, value);
+            row += value;
+            while (candidate != rows.end() && *candidate < row)
+                ++candidate;
+            if (candidate != rows.end() && *candidate == row)
+                *kept++ = *candidate++;
+        }
+        rows.erase(kept, rows.end());
+    }
+    return true;
+}
+
+} // namespace Core
@@ -0,0 +1,55 @@
+#ifndef TRIGRAMINDEX_H
+#define TRIGRAMINDEX_H
+
+#include "itemstore.h"
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Core {
+
+/// Maps each trigram (three consecutive bytes, folded to lower case) of the
+/// identifiers and displayed paths to the rows containing it. The rows of a
+/// posting list are stored ascending as varint encoded deltas.
+///
+/// Rows containing all trigrams of a needle are candidates for containing the
+/// needle, so looking them up costs about the number of matches instead of the
+/// number of rows. The candidates still need to be checked.
+class TrigramIndex
+{
+public:
+    enum { MinimumNeedleSize = 3 };
+
+    TrigramIndex();
+
+    /// The rows [0, rowCount()) are indexed.
+    uint32_t rowCount() const { return m_rowCount; }
+    std::size_t memoryUsage() const;
+
+    void clear();
+    /// Index the rows [rowCount(), end) of items.
+    void append(const ItemStore &items, uint32_t end);
+
+    /// Put the indexed rows that might contain needle into rows, ascending.
+    /// Returns false without looking up the rows if there would be more than
+    /// maximumCount, then scanning is cheaper.
+    bool findCandidates(const std::string &needle, uint32_t maximumCount,
+                        std::vector<uint32_t> &rows) const;
+
+private:
+    struct PostingList
+    {
+        std::vector<uint8_t> deltas; // The first one is the row itself
+        uint32_t lastRow;
+        uint32_t count;
+    };
+
+    std::unordered_map<uint32_t, PostingList> m_lists; // By trigram
+    uint32_t m_rowCount;
+};
+
+} // namespace Core
+
+#endif // TRIGRAMINDEX_H
@@ -4,6 +4,13 @@
 ///  <number> <name> <fullpath>
 ///
 /// Config file is ~/.goto.bookmarks
+/// A line "[~/project]" starts a section of bookmarks scoped to that directory:
+/// Started in it or below, goto lists them first, the most specific scope first.
+/// "[]" ends the section, the bookmarks following are not scoped.
+/// Its parsed contents are cached in ~/.goto.bookmarks.idx, --rebuild-index forces a rebuild.
+///
+/// Known terminals are driven by ANSI escape sequences directly, others by
+/// ncurses. --ncurses uses ncurses for any terminal.
 ///
 /// Keys:
 ///   Up, k, Down, j:    Move up and down the list.
@@ -11,6 +18,25 @@
 ///   Enter:             Go to selected directory.
 ///   Digit:             Select item with by digit.
 ///   e:                 Open editor with bookmarks file.
+///   Right:             Browse the selected directory, its entries are listed.
+///   Left:              When browsing, go to the parent directory.
+///   Ctrl-F:            Find files below the selected directory (or else the browsed or
+///                      current one). They are listed and filtered while searching.
+///   Ctrl-L:            Locate files in the index of ~/.goto.locate.idx, the filter
+///                      searches all of it. goto --update-index updates the index,
+///                      e.g. by cron, reading only the directories changed since.
+///                      The directories to index are listed in ~/.goto.locate, one
+///                      per line, by default the home directory is indexed.
+///   Ctrl-B:            Back to the bookmarks from browsing, finding or locating.
+///   Printable keys:    Filter by name or path. Case sensitive, with --smart-case
+///                      case insensitive unless the filter contains upper case
+///                      characters.
+///   Tab:               Toggle fuzzy filtering: The characters only need to
+///                      occur in order, the best matches are listed first.
+///   Ctrl-R:            Cycle through glob filtering (e.g. **/src/*go*), regular
+///                      expression filtering and plain filtering.
+///   Ctrl-O:            Toggle ordering by frecency: The items chosen often and
+///                      lately are listed first. Choices are logged in ~/.goto.history.
 ///   TODO: i:           Enter filter mode. You can enter a pattern
 ///                      and the filtered list will be shown.
 ///                      In filter Mode:
@@ -54,7 +80,7 @@
 ///  TODO: Enhance to general launcher/executer
 ///        File: (1) Open with $EDITOR (2) Open with xdg-open (3) Execute if execute bit is set!
 ///         Dir: (1) Go to location (2) Open with xdg-open (for image dirs e.g.)
-///  TODO: Directory dependent bookmarks/actions!
+///  TODO: Directory dependent actions!
 ///
 ///  Display:
 ///  TODO: Digit navigation for all entries? (line numbers)
@@ -71,6 +97,9 @@
 #include "gotoapplication.h"
 
 #include <core/bookmarkitemsmodel.h>
+#include <core/locateindex.h>
+#include <core/locateitemsmodel.h>
+#include <core/selectionhistory.h>
 
 #include <gui-ncurses/bookmarkmenu.h>
 #include <gui-ncurses/ikeyhandler.h>
@@ -80,58 +109,177 @@
 #include <utils/fileutils.h>
 #include <utils/stringutils.h>
 
+#include <chrono>
+#include <climits>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
 using namespace std;
 using namespace Core;
 using namespace TUI::NCurses;
 
 static const char BookmarkFile[] = ".goto.bookmarks";
 static const char ResultFile[] = ".goto.result";
+static const char LocateRootsFile[] = ".goto.locate";
+static const char LocateIndexFile[] = ".goto.locate.idx";
+static const char HistoryFile[] = ".goto.history";
 
-int main(int argc, char *argv[])
+/// The logical current directory as the shell has it, e.g. not resolving symbolic links.
+static string currentDirectory()
 {
-    GotoApplication app;
+    const char *directory = getenv("PWD");
+    struct stat logical, physical;
+    if (directory && directory[0] == '/' && stat(directory, &logical) == 0
+            && stat(".", &physical) == 0 && logical.st_dev == physical.st_dev
+            && logical.st_ino == physical.st_ino) {
+        return directory;
+    }
+    char buffer[PATH_MAX];
+    return getcwd(buffer, sizeof(buffer)) ? buffer : string();
+}
 
-    BookmarkItemsModel bookmarkItemsModel(BookmarkFile);
-    BookmarkMenu menu(BookmarkFile, bookmarkItemsModel, &app);
-    menu.exec(); // Block until the user decided for an item.
+/// The directories to index for locating, one per line. '~' is the home
+/// directory, which is the default.
+static vector<string> readLocateRoots(const string &homePath)
+{
+    vector<string> roots;
+    ifstream file(homePath + "/" + LocateRootsFile);
+    if (! file)
+        return vector<string>(1, homePath);
+    string line;
+    while (getline(file, line)) {
+        Utils::StringUtils::trim(line);
+        if (line.empty() || line[0] == '#')
+            continue;
+        if (line[0] == '~')
+            line.replace(0, 1, homePath);
+        roots.push_back(line);
+    }
+    return roots;
+}
 
-    BookmarkItemPointer item = menu.chosenItem();
-    assert(item);
-    BookmarkItem::HandlerHint handlerHint(item->path());
-    assert(handlerHint.hint != BookmarkItem::HandlerHint::NoHandlerHint);
+/// Updates the locate index, meant to be run by cron.
+static int updateLocateIndex(const string &homePath)
+{
+    const auto startTime = chrono::steady_clock::now();
+    const string indexFilePath = homePath + "/" + LocateIndexFile;
+
+    // The old index stays mapped while the new one replaces it.
+    Utils::FileUtils::MappedFile oldFile;
+    LocateIndex::Contents oldContents;
+    bool hasOldContents = false;
+    try {
+        oldFile = Utils::FileUtils::MappedFile(indexFilePath);
+        hasOldContents = LocateIndex::read(Utils::StringUtils::StringRef(oldFile.data(), oldFile.size()),
+                                           oldContents);
+    } catch (const runtime_error &) {
+        // Built from scratch
+    }
+
+    LocateIndex::UpdateStatistics statistics;
+    try {
+        const string image = LocateIndex::update(readLocateRoots(homePath),
+                                                 hasOldContents ? &oldContents : 0, statistics);
+        Utils::FileUtils::writeFileAtomically(indexFilePath, image);
+    } catch (const runtime_error &error) {
+        cerr << "goto: " << error.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    const auto elapsed = chrono::duration_cast<chrono::milliseconds>(
+        chrono::steady_clock::now() - startTime).count();
+    cout << "Indexed " << statistics.entryCount << " paths in " << statistics.directoryCount
+         << " directories, read " << statistics.readDirectoryCount << " changed directories in "
+         << elapsed << " ms." << endl;
+    return EXIT_SUCCESS;
+}
 
-    // Check format for resulting file
+int main(int argc, char *argv[])
+{
+    // Parse arguments
     enum ResultFileFormat { WriteInDefaultFormat, WriteInFutureFormat } resultFileFormat;
     resultFileFormat = WriteInDefaultFormat;
-    if (argc == 2 && string("--future-format") == argv[1])
-        resultFileFormat = WriteInFutureFormat;
+    BookmarkItemsModel::IndexMode indexMode = BookmarkItemsModel::UseIndex;
+    bool isUpdatingLocateIndex = false;
+    NCursesApplication::RendererChoice rendererChoice = NCursesApplication::ChooseRenderer;
+    ItemFilter::CaseSensitivity caseSensitivity = ItemFilter::CaseSensitive;
+    for (int i = 1; i < argc; ++i) {
+        const string argument = argv[i];
+        if (argument == "--future-format")
+            resultFileFormat = WriteInFutureFormat;
+        else if (argument == "--rebuild-index")
+            indexMode = BookmarkItemsModel::RebuildIndex;
+        else if (argument == "--update-index")
+            isUpdatingLocateIndex = true;
+        else if (argument == "--ncurses")
+            rendererChoice = NCursesApplication::UseNCursesRenderer;
+        else if (argument == "--smart-case")
+            caseSensitivity = ItemFilter::SmartCase;
+    }
+
+    const string homePath = getenv("HOME");
+    if (isUpdatingLocateIndex)
+        return updateLocateIndex(homePath);
+
+    GotoApplication app(rendererChoice);
+
+    BookmarkItemsModel bookmarkItemsModel(BookmarkFile, true, indexMode,
+                                          BookmarkItemsModel::LoadProgressively);
+    bookmarkItemsModel.startWatching(); // Pick up bookmarks added by other shells.
+    bookmarkItemsModel.setCurrentDirectory(currentDirectory());
+    LocateItemsModel locateItemsModel(homePath + "/" + LocateIndexFile);
+    SelectionHistory history(homePath + "/" + HistoryFile);
+    history.load();
+    BookmarkMenu menu(BookmarkFile, bookmarkItemsModel, locateItemsModel, &app);
+    menu.setSelectionHistory(&history);
+    menu.setCaseSensitivity(caseSensitivity);
+    menu.exec(); // Block until the user decided for an item.
+
+    const BookmarkItem item = menu.chosenItem();
+    Utils::FileUtils::FileInfo fileInfo;
+    const BookmarkItem::HandlerHint handlerHint
+        = menu.chosenFileInfo(fileInfo) ? BookmarkItem::HandlerHint(fileInfo)
+                                        : BookmarkItem::HandlerHint(item.path());
+    assert(handlerHint.hint != BookmarkItem::HandlerHint::NoHandlerHint);
 
     string fileContents;
     if (resultFileFormat == WriteInDefaultFormat) {
-        fileContents = item->path();
+        fileContents = item.path();
     } else {
         // TODO: Make this portable
         switch (handlerHint.hint) {
         case BookmarkItem::HandlerHint::ChangeToDirectory:
-            fileContents = "cd \"" + item->path() + '"';
+            fileContents = "cd \"" + item.path() + '"';
             break;
         case BookmarkItem::HandlerHint::ExecuteApplication:
-            fileContents = '"' + item->path() + '"';
+            fileContents = '"' + item.path() + '"';
             break;
         case BookmarkItem::HandlerHint::OpenWithDefaultApplication:
-            fileContents = "xdg-open \"" + item->path() + '"';
+            fileContents = "xdg-open \"" + item.path() + '"';
             break;
         default:
             fileContents = "Ops, could not determine command to handle path \""
-                + item->path() + "\".";
+                + item.path() + "\".";
         }
     }
 
     // No result file is written if the user aborts by e.g. Ctrl-C since we
     // never will get to this point. This is OK since the shell function
     // handles this case.
-    const string filePath = string(getenv("HOME")) + "/" + ResultFile;
+    const string filePath = homePath + "/" + ResultFile;
     Utils::FileUtils::writeFile(filePath, fileContents);
 
+    try {
+        history.record(item.path(), time(0));
+    } catch (const runtime_error &error) {
+        Utils::DebugUtils::debug() << error.what();
+    }
+
     return EXIT_SUCCESS;
 }
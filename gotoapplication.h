@@ -9,6 +9,8 @@ class GotoApplication
     , public TUI::NCurses::IKeyController
 {
 public:
+    explicit GotoApplication(RendererChoice choice) : NCursesApplication(choice) {}
+
     bool handleKey(KeyPress keyPress);
 };
 
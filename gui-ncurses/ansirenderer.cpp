@@ -0,0 +1,492 @@
+#include "ansirenderer.h"
+
+#include "ncursesapplication.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+
+#include <ncurses.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+namespace TUI {
+namespace NCurses {
+
+namespace {
+
+/// Maximum wait for the rest of an escape sequence, otherwise it is the escape key.
+const int EscapeTimeout = 25; // ms
+/// Maximum wait for the replies to the queries of the terminal on leaving it.
+const int ReplyTimeout = 100; // ms
+
+/// By TERM, followed by nothing, '-' or '.'
+const char *const SupportedTerminals[] = {
+    "alacritty", "foot", "gnome", "konsole", "kitty", "linux", "mintty", "putty", "rxvt",
+    "screen", "st", "tmux", "vt100", "vt102", "vt220", "wezterm", "xterm"
+};
+
+Utils::Notifier *resizeNotifier = 0;
+
+void notifyResize(int)
+{
+    const int savedErrno = errno;
+    if (resizeNotifier)
+        resizeNotifier->notify();
+    errno = savedErrno;
+}
+
+} // anonymous
+
+bool AnsiRenderer::isSupported()
+{
+    const char *terminal = getenv("TERM");
+    if (! terminal || ! isatty(STDIN_FILENO) || ! isatty(STDOUT_FILENO))
+        return false;
+
+    for (const char *name : SupportedTerminals) {
+        const std::size_t length = strlen(name);
+        if (strncmp(terminal, name, length) == 0
+                && (terminal[length] == '\0' || terminal[length] == '-' || terminal[length] == '.')) {
+            return true;
+        }
+    }
+    return false;
+}
+
+AnsiRenderer::AnsiRenderer() throw(std::runtime_error)
+    : m_isEntered(false)
+    , m_hasColors(! getenv("TERM") || strncmp(getenv("TERM"), "vt", 2) != 0)
+    , m_lineCount(0)
+    , m_columnCount(0)
+    , m_isCleared(true)
+    , m_isAwaitingReplies(false)
+    , m_hasSynchronizedOutput(false)
+{
+    if (tcgetattr(STDIN_FILENO, &m_originalAttributes) == -1)
+        throw std::runtime_error("Failed to get the attributes of the terminal");
+
+    // Without SA_RESTART, a resize interrupts poll() right away.
+    resizeNotifier = &m_resizeNotifier;
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = notifyResize;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGWINCH, &action, &m_originalResizeAction);
+
+    updateSize();
+    enterScreen();
+
+    // Ask for synchronized output (DECRQM), then for the device attributes,
+    // which every terminal answers. Once that reply is there, all are.
+    m_output = "\x1b[?2026$p\x1b[c";
+    writeOutput();
+    m_isAwaitingReplies = true;
+}
+
+AnsiRenderer::~AnsiRenderer()
+{
+    leaveScreen();
+    sigaction(SIGWINCH, &m_originalResizeAction, 0);
+    resizeNotifier = 0;
+}
+
+int AnsiRenderer::lineCount()
+{
+    return m_lineCount;
+}
+
+int AnsiRenderer::columnCount()
+{
+    return m_columnCount;
+}
+
+bool AnsiRenderer::supportsColors()
+{
+    return m_hasColors;
+}
+
+void AnsiRenderer::drawText(int line, int column, Utils::StringUtils::StringRef text,
+                            int attributes, Color color)
+{
+    if (line < 0 || line >= m_lineCount || column < 0)
+        return;
+
+    Cell *cells = &m_cells[line * m_columnCount];
+    const int end = std::min<int>(m_columnCount, column + text.size());
+    for (const char *character = text.data(); column < end; ++column, ++character) {
+        // Control characters would move the cursor, and the bytes of multibyte
+        // characters would take less columns than cells.
+        const unsigned char c = *character;
+        cells[column] = Cell(c >= 32 && c < 127 ? c : '?', attributes, color);
+    }
+}
+
+void AnsiRenderer::clearLine(int line, int column, int attributes)
+{
+    if (line < 0 || line >= m_lineCount || column < 0 || column >= m_columnCount)
+        return;
+    std::fill(m_cells.begin() + line * m_columnCount + column, m_cells.begin() + (line + 1) * m_columnCount,
+              Cell(' ', attributes, ColorDefault));
+}
+
+void AnsiRenderer::drawHorizontalLine(int line, int column, int attributes)
+{
+    if (line < 0 || line >= m_lineCount || column < 0 || column >= m_columnCount)
+        return;
+    // 'q' is the horizontal line of the DEC special graphics
+    std::fill(m_cells.begin() + line * m_columnCount + column, m_cells.begin() + (line + 1) * m_columnCount,
+              Cell('q', attributes | LineDrawing, ColorDefault));
+}
+
+void AnsiRenderer::addAttributes(int line, int column, int attributes)
+{
+    if (line < 0 || line >= m_lineCount || column < 0 || column >= m_columnCount)
+        return;
+    m_cells[line * m_columnCount + column].attributes |= attributes;
+}
+
+void AnsiRenderer::clear()
+{
+    std::fill(m_cells.begin(), m_cells.end(), Cell());
+    m_isCleared = true;
+}
+
+/// Write the cells changed since the last update, moving the cursor only to skip
+/// unchanged ones. The style is reset at the end, so each frame starts without.
+void AnsiRenderer::update()
+{
+    if (! m_isEntered)
+        return;
+
+    if (m_hasSynchronizedOutput)
+        m_output += "\x1b[?2026h";
+    const std::size_t frameStart = m_output.size();
+    if (m_isCleared) {
+        m_output += "\x1b[0m\x1b[H\x1b[2J";
+        std::fill(m_shownCells.begin(), m_shownCells.end(), Cell());
+        m_isCleared = false;
+    }
+
+    Cell style;
+    int cursorLine = -1;
+    int cursorColumn = -1; // -1 if unknown, e.g. behind the right edge
+    for (int line = 0; line < m_lineCount; ++line) {
+        const Cell *cells = &m_cells[line * m_columnCount];
+        Cell *shownCells = &m_shownCells[line * m_columnCount];
+        int blankColumn = m_columnCount; // Blank from here to the right edge
+        while (blankColumn > 0 && cells[blankColumn - 1] == Cell())
+            --blankColumn;
+        for (int column = 0; column < m_columnCount; ++column) {
+            if (cells[column] == shownCells[column])
+                continue;
+            const bool isErasable = column >= blankColumn && m_columnCount - column > 3;
+
+            if (line == cursorLine && cursorColumn != -1 && column > cursorColumn) {
+                // Writing a few unchanged characters again is shorter than moving.
+                const int gap = column - cursorColumn;
+                bool isRewritable = gap <= 3;
+                for (int i = cursorColumn; isRewritable && i < column; ++i)
+                    isRewritable = cells[i].attributes == style.attributes && cells[i].color == style.color;
+                if (isRewritable) {
+                    for (int i = cursorColumn; i < column; ++i)
+                        m_output += cells[i].character;
+                } else {
+                    m_output += "\x1b[" + std::to_string(gap) + 'C';
+                }
+            } else if (line != cursorLine || column != cursorColumn) {
+                m_output += "\x1b[" + std::to_string(line + 1) + ';' + std::to_string(column + 1) + 'H';
+            }
+
+            appendStyle(cells[column], style);
+            if (isErasable) {
+                // Erasing the rest of the line is shorter than writing blanks.
+                m_output += "\x1b[K";
+                std::fill(shownCells + column, shownCells + m_columnCount, Cell());
+                cursorLine = -1;
+                break;
+            }
+            m_output += cells[column].character;
+            shownCells[column] = cells[column];
+            cursorLine = line;
+            cursorColumn = column + 1 < m_columnCount ? column + 1 : -1;
+        }
+    }
+
+    if (m_output.size() == frameStart) {
+        m_output.clear();
+        return;
+    }
+    appendStyle(Cell(), style);
+    if (m_hasSynchronizedOutput)
+        m_output += "\x1b[?2026l";
+    writeOutput();
+}
+
+/// Decode the next key read, unless the terminal was resized.
+int AnsiRenderer::readKey()
+{
+    pollfd resize = { m_resizeNotifier.fileDescriptor(), POLLIN, 0 };
+    if (poll(&resize, 1, 0) == 1) {
+        m_resizeNotifier.clear();
+        updateSize();
+        return KEY_RESIZE;
+    }
+
+    if (m_input.empty())
+        readInput(0);
+    int key;
+    return decodeKey(key) ? key : ERR;
+}
+
+int AnsiRenderer::notificationDescriptor()
+{
+    return m_resizeNotifier.fileDescriptor();
+}
+
+void AnsiRenderer::suspend()
+{
+    leaveScreen();
+}
+
+void AnsiRenderer::resume()
+{
+    enterScreen();
+}
+
+/// Set up the terminal like raw() of ncurses, on the alternate screen and
+/// with the cursor hidden.
+void AnsiRenderer::enterScreen()
+{
+    termios attributes = m_originalAttributes;
+    attributes.c_iflag &= ~(IGNBRK | BRKINT | PARMRK | ISTRIP | INLCR | IGNCR | ICRNL | IXON);
+    attributes.c_lflag &= ~(ECHO | ECHONL | ICANON | ISIG | IEXTEN);
+    attributes.c_cflag &= ~(CSIZE | PARENB);
+    attributes.c_cflag |= CS8;
+    attributes.c_cc[VMIN] = 1;
+    attributes.c_cc[VTIME] = 0;
+    tcsetattr(STDIN_FILENO, TCSADRAIN, &attributes);
+
+    m_output += "\x1b[?1049h\x1b[?25l";
+    writeOutput();
+    m_isEntered = true;
+    m_isCleared = true;
+}
+
+void AnsiRenderer::leaveScreen()
+{
+    if (! m_isEntered)
+        return;
+
+    awaitReplies(); // Otherwise they end up in the shell
+    m_output += "\x1b[0m\x1b(B\x1b[?25h\x1b[?1049l";
+    writeOutput();
+    tcsetattr(STDIN_FILENO, TCSADRAIN, &m_originalAttributes);
+    m_isEntered = false;
+}
+
+/// Take the size of the terminal, keeping what is drawn as far as it fits.
+void AnsiRenderer::updateSize()
+{
+    winsize size;
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &size) == -1 || size.ws_row == 0 || size.ws_col == 0) {
+        size.ws_row = 24;
+        size.ws_col = 80;
+    }
+
+    std::vector<Cell> cells(size.ws_row * size.ws_col);
+    const int lineCount = std::min<int>(m_lineCount, size.ws_row);
+    const int columnCount = std::min<int>(m_columnCount, size.ws_col);
+    for (int line = 0; line < lineCount; ++line) {
+        std::copy(m_cells.begin() + line * m_columnCount,
+                  m_cells.begin() + line * m_columnCount + columnCount,
+                  cells.begin() + line * size.ws_col);
+    }
+    m_cells.swap(cells);
+    m_shownCells.assign(m_cells.size(), Cell());
+    m_lineCount = size.ws_row;
+    m_columnCount = size.ws_col;
+    m_isCleared = true; // The terminal might have rewrapped the lines
+}
+
+/// Write and clear m_output.
+void AnsiRenderer::writeOutput()
+{
+    std::size_t written = 0;
+    while (written < m_output.size()) {
+        const ssize_t count = write(STDOUT_FILENO, m_output.data() + written, m_output.size() - written);
+        if (count == -1 && errno != EINTR)
+            break;
+        if (count > 0)
+            written += count;
+    }
+    m_output.clear();
+}
+
+void AnsiRenderer::appendStyle(const Cell &cell, Cell &style)
+{
+    if ((cell.attributes & LineDrawing) != (style.attributes & LineDrawing))
+        m_output += cell.attributes & LineDrawing ? "\x1b(0" : "\x1b(B";
+    if ((cell.attributes & ~LineDrawing) != (style.attributes & ~LineDrawing) || cell.color != style.color) {
+        m_output += "\x1b[0";
+        if (cell.attributes & Bold)
+            m_output += ";1";
+        if (cell.attributes & Underline)
+            m_output += ";4";
+        if (cell.attributes & Reverse)
+            m_output += ";7";
+        if (cell.color != ColorDefault) {
+            m_output += ";3"; // The colors are in the order of ANSI
+            m_output += static_cast<char>('0' + cell.color);
+        }
+        m_output += 'm';
+    }
+    style.attributes = cell.attributes;
+    style.color = cell.color;
+}
+
+/// Append what is readable within timeout (ms) to m_input. Returns false if nothing.
+bool AnsiRenderer::readInput(int timeout)
+{
+    pollfd input = { STDIN_FILENO, POLLIN, 0 };
+    if (poll(&input, 1, timeout) != 1)
+        return false;
+    char buffer[4096];
+    const ssize_t count = read(STDIN_FILENO, buffer, sizeof(buffer));
+    if (count <= 0)
+        return false;
+    m_input.append(buffer, count);
+    return true;
+}
+
+/// Take the next key from m_input, skipping the replies of the terminal.
+bool AnsiRenderer::decodeKey(int &key)
+{
+    while (! m_input.empty()) {
+        const unsigned char character = m_input[0];
+        if (character != KEY_ESC) {
+            m_input.erase(0, 1);
+            if (character == '\r')
+                key = KEY_RETURN;
+            else if (character == 127 || character == '\b')
+                key = KEY_BACKSPACE;
+            else
+                key = character;
+            return true;
+        }
+
+        // An escape followed by another key is passed on as two keys, like
+        // ncurses does, see FilterMenu::exec().
+        if (m_input.size() == 1 && ! readInput(EscapeTimeout)) {
+            m_input.clear();
+            key = KEY_ESC;
+            return true;
+        }
+        if (m_input[1] != '[' && m_input[1] != 'O') {
+            m_input.erase(0, 1);
+            key = KEY_ESC;
+            return true;
+        }
+        if (decodeControlSequence(key))
+            return true;
+    }
+    return false;
+}
+
+/// Decode the CSI or SS3 sequence at the start of m_input. Returns false if it
+/// is no key, e.g. a reply to a query.
+bool AnsiRenderer::decodeControlSequence(int &key)
+{
+    // SS3 is followed by the final character. CSI has parameters and
+    // intermediate characters before it.
+    const bool isControlSequenceIntroducer = m_input[1] == '[';
+    std::size_t end = 2;
+    for (;;) {
+        while (isControlSequenceIntroducer && end < m_input.size()
+               && m_input[end] >= 0x20 && m_input[end] < 0x40) {
+            ++end;
+        }
+        if (end < m_input.size())
+            break;
+        if (! readInput(EscapeTimeout)) {
+            // Incomplete, e.g. Alt-[ was pressed.
+            m_input.erase(0, 1);
+            key = KEY_ESC;
+            return true;
+        }
+    }
+    const char final = m_input[end];
+    const std::string parameters = m_input.substr(2, end - 2);
+    m_input.erase(0, end + 1);
+
+    switch (final) {
+    case 'A':
+        key = KEY_UP;
+        return true;
+    case 'B':
+        key = KEY_DOWN;
+        return true;
+    case 'C':
+        key = KEY_RIGHT;
+        return true;
+    case 'D':
+        key = KEY_LEFT;
+        return true;
+    case 'H':
+        key = KEY_HOME;
+        return true;
+    case 'F':
+        key = KEY_END;
+        return true;
+    case '~':
+        switch (atoi(parameters.c_str())) {
+        case 1: case 7:
+            key = KEY_HOME;
+            return true;
+        case 4: case 8:
+            key = KEY_END;
+            return true;
+        case 2:
+            key = KEY_IC;
+            return true;
+        case 3:
+            key = KEY_DC;
+            return true;
+        case 5:
+            key = KEY_PPAGE;
+            return true;
+        case 6:
+            key = KEY_NPAGE;
+            return true;
+        }
+        return false;
+    case 'y': // "?2026;<state>$": Set (1) or reset (2) if supported
+        if (parameters.compare(0, 6, "?2026;") == 0 && parameters.size() > 6)
+            m_hasSynchronizedOutput = parameters[6] == '1' || parameters[6] == '2';
+        return false;
+    case 'c':
+        if (! parameters.empty() && parameters[0] == '?')
+            m_isAwaitingReplies = false;
+        return false;
+    }
+    return false;
+}
+
+/// Read the replies to the queries, dropping the keys typed meanwhile.
+void AnsiRenderer::awaitReplies()
+{
+    int key;
+    while (m_isAwaitingReplies) {
+        while (m_isAwaitingReplies && decodeKey(key)) {
+        }
+        if (m_isAwaitingReplies && ! readInput(ReplyTimeout))
+            break;
+    }
+    m_isAwaitingReplies = false;
+    m_input.clear();
+}
+
+} // namespace NCurses
+} // namespace TUI
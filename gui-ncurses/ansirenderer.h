@@ -0,0 +1,112 @@
+#ifndef ANSIRENDERER_H
+#define ANSIRENDERER_H
+
+#include "irenderer.h"
+
+#include "utils/notifier.h"
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <signal.h>
+#include <termios.h>
+
+namespace TUI {
+namespace NCurses {
+
+/// Draws by writing ANSI escape sequences to stdout, without terminfo. It keeps
+/// what the terminal shows and what is drawn for the next frame, so update()
+/// writes only the characters that changed, by a single write().
+///
+/// The menu is shown on the alternate screen. If the terminal reports to
+/// support synchronized output (DEC mode 2026), frames are wrapped in it, so
+/// they never show half drawn.
+///
+/// Keys are decoded from the escape sequences of xterm and the Linux console,
+/// in normal and in application cursor mode.
+class AnsiRenderer : public IRenderer
+{
+public:
+    /// Whether the terminal of stdin and stdout is known to understand the
+    /// escape sequences, by its TERM.
+    static bool isSupported();
+
+    AnsiRenderer() throw(std::runtime_error);
+    ~AnsiRenderer();
+
+    int lineCount();
+    int columnCount();
+    bool supportsColors();
+
+    void drawText(int line, int column, Utils::StringUtils::StringRef text,
+                  int attributes = 0, Color color = ColorDefault);
+    void clearLine(int line, int column, int attributes = 0);
+    void drawHorizontalLine(int line, int column, int attributes = 0);
+    void addAttributes(int line, int column, int attributes);
+    void clear();
+    void update();
+
+    int readKey();
+    int notificationDescriptor();
+
+    void suspend();
+    void resume();
+
+private:
+    AnsiRenderer(const AnsiRenderer &) = delete;
+    AnsiRenderer &operator=(const AnsiRenderer &) = delete;
+
+    /// Attributes of the cell besides the ones of IRenderer::Attribute
+    enum CellAttribute { LineDrawing = 8 };
+
+    struct Cell
+    {
+        Cell() : character(' '), attributes(0), color(ColorDefault) {}
+        Cell(char character, uint8_t attributes, uint8_t color)
+            : character(character), attributes(attributes), color(color) {}
+        bool operator==(const Cell &other) const
+        {
+            return character == other.character && attributes == other.attributes
+                && color == other.color;
+        }
+        bool operator!=(const Cell &other) const { return ! (*this == other); }
+
+        char character;
+        uint8_t attributes;
+        uint8_t color;
+    };
+
+    void enterScreen();
+    void leaveScreen();
+    void updateSize();
+    void writeOutput();
+    void appendStyle(const Cell &cell, Cell &style);
+    bool readInput(int timeout);
+    bool decodeKey(int &key);
+    bool decodeControlSequence(int &key);
+    void awaitReplies();
+
+    termios m_originalAttributes;
+    struct sigaction m_originalResizeAction;
+    bool m_isEntered;
+    bool m_hasColors;
+    Utils::Notifier m_resizeNotifier; // Notified on SIGWINCH
+
+    int m_lineCount;
+    int m_columnCount;
+    std::vector<Cell> m_cells;       // Drawn for the next update()
+    std::vector<Cell> m_shownCells;  // Shown by the terminal
+    bool m_isCleared;                // The terminal needs to be cleared before drawing
+    std::string m_output;
+
+    std::string m_input;             // Read, but not decoded to keys yet
+    bool m_isAwaitingReplies;        // To the queries of enterScreen()
+    bool m_hasSynchronizedOutput;
+};
+
+} // namespace NCurses
+} // namespace TUI
+
+#endif // ANSIRENDERER_H
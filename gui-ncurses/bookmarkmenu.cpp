@@ -1,9 +1,12 @@
 #include "bookmarkmenu.h"
 
 #include "utils/debugutils.h"
+#include "utils/fileinfocache.h"
 #include "utils/fileutils.h"
 #include "utils/stringutils.h"
 
+#include <algorithm>
+#include <climits>
 #include <cstdlib>
 #include <fstream>
 #include <functional>
@@ -11,33 +14,152 @@
 #include <sstream>
 #include <stdexcept>
 
+#include <unistd.h>
+
 namespace TUI {
 namespace NCurses {
 
 BookmarkMenu::BookmarkMenu(const std::string &bookmarkFilePath,
                            Core::BookmarkItemsModel &model,
+                           Core::LocateItemsModel &locateItemsModel,
                            IKeyController *parentKeyHandler)
     : FilterMenu(model, parentKeyHandler)
     , m_bookmarkFilePath(bookmarkFilePath)
+    , m_bookmarkItemsModel(model)
+    , m_locateItemsModel(locateItemsModel)
 {
     m_map[IKeyController::KeyPress('e', true)] = std::bind(&BookmarkMenu::openEditor, this);
+    m_map[IKeyController::KeyPress(KEY_RIGHT)]
+        = std::bind(&BookmarkMenu::browseSelectedDirectory, this);
+    m_map[IKeyController::KeyPress(KEY_LEFT)] = std::bind(&BookmarkMenu::browseParentDirectory, this);
+    m_map[IKeyController::KeyPress(KEY_CTRL_F)] = std::bind(&BookmarkMenu::findFiles, this);
+    m_map[IKeyController::KeyPress(KEY_CTRL_L)] = std::bind(&BookmarkMenu::locateFiles, this);
+    m_map[IKeyController::KeyPress(KEY_CTRL_B)] = std::bind(&BookmarkMenu::showBookmarks, this);
 }
 
 bool BookmarkMenu::openEditor()
 {
+    if (&model() != &m_bookmarkItemsModel)
+        return false;
+
     std::stringstream command;
     command << "$EDITOR " << "$HOME/" << m_bookmarkFilePath;
 
     NCursesApplication::runExternalCommand(command.str());
-    m_allMenuItems = m_menuItems = m_model.items(true); // Reread file contents.
-    reset(); // Cursor might be on the last entry and the user might deleted the last entry.
+    // Anything might have changed meanwhile.
+    Utils::FileUtils::FileInfoCache::globalInstance().invalidate();
+    m_model->revalidate();
+
+    // Reread only the changed lines of the file.
+    updateItems(ReloadItems);
+
+    clearScreen();
+
+    return true;
+}
+
+/// Enter browse mode with the selected directory.
+bool BookmarkMenu::browseSelectedDirectory()
+{
+    const uint32_t row = selectedItemRow();
+    if (row == Core::ItemStore::InvalidRow || m_model->items().isEmpty(row))
+        return true;
+    if (m_directoryItemsModel.setDirectory(m_model->items().path(row).toString()))
+        showModel(m_directoryItemsModel);
+    return true;
+}
+
+/// Go up in browse mode and select the directory coming from.
+bool BookmarkMenu::browseParentDirectory()
+{
+    if (! isBrowsing())
+        return false;
+
+    const std::string directory = m_directoryItemsModel.directory();
+    const std::size_t separator = directory.rfind('/');
+    if (directory == "/" || separator == std::string::npos)
+        return true;
+    const std::string parent = separator == 0 ? "/" : directory.substr(0, separator);
+    if (! m_directoryItemsModel.setDirectory(parent))
+        return true;
+    showModel(m_directoryItemsModel);
+
+    // Huge directories might not be read that far yet, then stay at the top.
+    const Core::ItemStore &items = m_model->items();
+    for (uint32_t row = 0; row < items.size(); ++row) {
+        const Utils::StringUtils::StringRef path = items.path(row);
+        if (path.size() == directory.size() && std::equal(path.begin(), path.end(), directory.begin())) {
+            selectItem(row);
+            break;
+        }
+    }
+    return true;
+}
 
+/// Enter find mode below the selected directory, otherwise below the browsed
+/// or the current directory.
+bool BookmarkMenu::findFiles()
+{
+    // Bookmarks not validated yet are most probably directories. Browsed and
+    // found directories are known.
+    const uint32_t row = selectedItemRow();
+    bool isDirectory = false;
+    if (row != Core::ItemStore::InvalidRow && ! m_model->items().isEmpty(row)) {
+        Utils::FileUtils::FileInfo info;
+        isDirectory = m_model->fileInfo(row, info) ? info.isDirectory
+                                                   : &model() == &m_bookmarkItemsModel;
+    }
+
+    std::string directory;
+    if (isDirectory) {
+        directory = m_model->items().path(row).toString();
+    } else if (isBrowsing()) {
+        directory = m_directoryItemsModel.directory();
+    } else if (isFinding()) {
+        directory = m_findFilesModel.directory();
+    } else {
+        char currentDirectory[PATH_MAX];
+        if (! getcwd(currentDirectory, sizeof(currentDirectory)))
+            return true;
+        directory = currentDirectory;
+    }
+
+    m_findFilesModel.find(directory);
+    showModel(m_findFilesModel);
     return true;
 }
 
-Core::BookmarkItemPointer BookmarkMenu::chosenItem()
+/// Enter locate mode, the filter searches the index of files.
+bool BookmarkMenu::locateFiles()
+{
+    m_locateItemsModel.open(); // Updated meanwhile?
+    showModel(m_locateItemsModel);
+    return true;
+}
+
+bool BookmarkMenu::showBookmarks()
+{
+    if (&model() != &m_bookmarkItemsModel)
+        showModel(m_bookmarkItemsModel);
+    return true;
+}
+
+/// Switch the mode, finding files does not go on in the background.
+void BookmarkMenu::showModel(Core::IModel &model)
+{
+    if (isFinding() && &model != &m_findFilesModel)
+        m_findFilesModel.cancel();
+    setModel(model);
+}
+
+Core::BookmarkItem BookmarkMenu::chosenItem()
+{
+    return Core::BookmarkItem(m_model->items(), chosenRow());
+}
+
+bool BookmarkMenu::chosenFileInfo(Utils::FileUtils::FileInfo &info)
 {
-    return std::static_pointer_cast<Core::BookmarkItem>(FilterMenu::chosenItem());
+    return m_model->fileInfo(chosenRow(), info);
 }
 
 } // namespace NCurses
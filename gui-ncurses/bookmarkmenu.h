@@ -5,6 +5,11 @@
 #include "ncursesapplication.h"
 
 #include "core/bookmarkitemsmodel.h"
+#include "core/directoryitemsmodel.h"
+#include "core/findfilesmodel.h"
+#include "core/locateitemsmodel.h"
+
+#include "utils/fileutils.h"
 
 #include <memory>
 #include <string>
@@ -12,17 +17,36 @@
 namespace TUI {
 namespace NCurses {
 
+/// The menu of goto: It lists the bookmarks, the entries of a directory in
+/// browse mode, the files below a directory in find mode, or the indexed files
+/// in locate mode.
 class BookmarkMenu : public FilterMenu
 {
 public:
     BookmarkMenu(const std::string &bookmarkFilePath, Core::BookmarkItemsModel &model,
-                 IKeyController *parentKeyHandler = 0);
+                 Core::LocateItemsModel &locateItemsModel, IKeyController *parentKeyHandler = 0);
     bool openEditor();
 
-    Core::BookmarkItemPointer chosenItem();
+    bool browseSelectedDirectory();
+    bool browseParentDirectory();
+    bool findFiles();
+    bool locateFiles();
+    bool showBookmarks();
+
+    Core::BookmarkItem chosenItem();
+    /// Returns false if it is not known without asking the file system.
+    bool chosenFileInfo(Utils::FileUtils::FileInfo &info);
 
 private:
+    bool isBrowsing() { return &model() == &m_directoryItemsModel; }
+    bool isFinding() { return &model() == &m_findFilesModel; }
+    void showModel(Core::IModel &model);
+
     const std::string m_bookmarkFilePath;
+    Core::BookmarkItemsModel &m_bookmarkItemsModel;
+    Core::DirectoryItemsModel m_directoryItemsModel;
+    Core::FindFilesModel m_findFilesModel;
+    Core::LocateItemsModel &m_locateItemsModel;
 };
 
 } // namespace NCurses
@@ -5,36 +5,66 @@
 #include "menuitemvisualhints.h"
 
 #include "utils/debugutils.h"
+#include "utils/fileinfocache.h"
 #include "utils/fileutils.h"
+#include "utils/stringutils.h"
 
-#include <iomanip>
+#include <algorithm>
+#include <ctime>
 #include <functional>
-#include <sstream>
+
+#include <poll.h>
+#include <unistd.h>
 
 using namespace Utils::DebugUtils;
+using Core::ItemStore;
+using Utils::StringUtils::StringRef;
 
 namespace TUI {
 namespace NCurses {
 
+namespace {
+/// Maximum wait for the first validated paths before drawing the first frame.
+const int FirstFrameValidationTimeout = 50; // ms
+/// Keys arriving faster are applied together, see readTypeahead().
+const int MinimumFrameInterval = 16; // ms
+/// Top entries accessible by Alt-Digit.
+const std::size_t DigitAccessorCount = 10;
+/// Ranks a priority above any frecency, see Core::SelectionHistory::MaximumRankSum.
+const double PriorityWeight = 1e9;
+
+/// The menu takes all but the last line, that is for the status bar.
+int menuLineCount(IRenderer &renderer)
+{
+    return std::max(renderer.lineCount() - 1, 1);
+}
+} // anonymous
+
 FilterMenu::FilterMenu(Core::IModel &model, IKeyController *parentKeyHandler)
-    : m_model(model)
-    , m_allMenuItems(m_model.items(false))
-    , m_menuItems(m_allMenuItems)
+    : m_model(&model)
     , m_optionWrapOnEntryNavigation(false)
     , m_key(-1)
-    , m_chosenItem(0)
+    , m_chosenRow(ItemStore::InvalidRow)
+    , m_probingChosenRow(ItemStore::InvalidRow)
     , m_parentKeyHandler(parentKeyHandler)
-    , m_scrollView(0, LINES - 2)
+    , m_scrollView(0, menuLineCount(NCursesApplication::renderer()))
     , m_selectedRow(0)
-    , m_window(newwin(LINES - 1, COLS, 0, 0))
-    , m_statusBar(1, COLS, LINES - 1, 0)
+    , m_renderer(NCursesApplication::renderer())
+    , m_statusBar(m_renderer, m_scrollView.rowCount())
+    , m_filterWorker(m_filter)
+    , m_isIndexing(false)
+    , m_filterMode(m_filter.mode())
+    , m_caseSensitivity(m_filter.caseSensitivity())
+    , m_selectionHistory(0)
+    , m_isOrderedByFrecency(false)
+    , m_isFilterPending(false)
+    , m_isMenuDamaged(true)
+    , m_identifierColumnWidth(0)
+    , m_columnCount(0)
+    , m_digitAccessorScanEnd(0)
 {
-    int windowColumns, windowRows;
-    getmaxyx(m_window, windowRows, windowColumns);
-    m_scrollView = ScrollView(0, windowRows);
-    debug() << "FilterMenu: Window size: " << windowColumns << "x" << windowRows;
+    debug() << "FilterMenu: Window size: " << m_renderer.columnCount() << "x" << int(m_scrollView.rowCount());
 
-    keypad(m_window, TRUE);
     m_map[IKeyController::KeyPress(KEY_UP)] = std::bind(&FilterMenu::navigateEntryUp, this);
     m_map[IKeyController::KeyPress(KEY_DOWN)] = std::bind(&FilterMenu::navigateEntryDown, this);
     m_map[IKeyController::KeyPress(KEY_NPAGE)] = std::bind(&FilterMenu::navigatePageDown, this);
@@ -61,149 +91,422 @@ FilterMenu::FilterMenu(Core::IModel &model, IKeyController *parentKeyHandler)
     m_map[IKeyController::KeyPress(KEY_BACKSPACE)] = std::bind(&FilterMenu::chopFromFilter, this);
     m_map[IKeyController::KeyPress(KEY_CTRL_C)] = std::bind(&FilterMenu::clearFilter, this);
     m_map[IKeyController::KeyPress(KEY_CTRL_D)] = std::bind(&FilterMenu::clearFilter, this);
+    m_map[IKeyController::KeyPress(KEY_TAB)] = std::bind(&FilterMenu::toggleFilterMode, this);
+    m_map[IKeyController::KeyPress(KEY_CTRL_R)] = std::bind(&FilterMenu::togglePatternMode, this);
+    m_map[IKeyController::KeyPress(KEY_CTRL_O)] = std::bind(&FilterMenu::toggleFrecencyOrder, this);
+
+    m_filter.reset(m_model->items());
+    updateRowScores(0);
 }
 
 int FilterMenu::exec()
 {
+    // Flag dead items from the first frame on, unless the file systems are slow.
+    const int fileInfoDescriptor = m_model->fileInfoNotificationDescriptor();
+    if (fileInfoDescriptor != -1) {
+        pollfd fileDescriptor = { fileInfoDescriptor, POLLIN, 0 };
+        if (poll(&fileDescriptor, 1, FirstFrameValidationTimeout) == 1)
+            m_model->takeFileInfos();
+    }
+
     bool isEscapePreceded = false;
-    while (! m_chosenItem) {
-        updateMenu();
-        updateStatusBar();
-        m_key = wgetch(m_window);
-        if (m_key == KEY_ESC) {
-            isEscapePreceded = true;
-            continue;
+    while (m_chosenRow == ItemStore::InvalidRow) {
+        // While searching, the old rows stay on the screen until the new ones are ready.
+        if (! isSearching()) {
+            finishFiltering();
+            updateMenu();
         }
+        updateStatusBar();
+        m_frameTime = std::chrono::steady_clock::now();
+        m_key = readKey();
+        if (m_chosenRow != ItemStore::InvalidRow)
+            break; // Probed meanwhile, see fire()
+
+        // Apply all keys typed ahead before drawing the next frame, e.g. pasted
+        // or auto-repeated ones. The filter runs once for all of them.
+        do {
+            if (m_key == KEY_RESIZE) {
+                relayout();
+                continue;
+            }
+            m_probingChosenRow = ItemStore::InvalidRow;
+            if (m_key == KEY_ESC) {
+                isEscapePreceded = true; // Pairs with the next key, maybe of the next batch
+                continue;
+            }
 
-        const IKeyController::KeyPress keyPress(m_key, isEscapePreceded);
-        if (isEscapePreceded)
-            isEscapePreceded = false;
+            const IKeyController::KeyPress keyPress(m_key, isEscapePreceded);
+            if (isEscapePreceded)
+                isEscapePreceded = false;
+
+            // Keys changing the filter supersede the running search, the other keys of
+            // the menu act on its result, e.g. navigating the rows shown for the input.
+            // The keys of the parent do not wait for it, see below.
+            const bool isMenuKey = m_map.find(keyPress) != m_map.end();
+            if (isMenuKey && ! changesFilter(keyPress)) {
+                startFiltering();
+                finishFiltering();
+            }
 
-        debug() << "Key:" << keyPress.key << "escapePreded:" << keyPress.escapePreceded;
-        if (! handleKey(keyPress) && m_parentKeyHandler)
-            m_parentKeyHandler->handleKey(keyPress);
+            debug() << "Key:" << keyPress.key << "escapePreded:" << keyPress.escapePreceded;
+            if (! handleKey(keyPress) && m_parentKeyHandler) {
+                // The parent might quit, so the worker must not use the filter
+                // or the thread pool anymore.
+                const bool isSearchCanceled = cancelFiltering();
+                m_parentKeyHandler->handleKey(keyPress);
+                if (isSearchCanceled)
+                    runFilter();
+            }
+        } while (m_chosenRow == ItemStore::InvalidRow && (m_key = readTypeahead()) != ERR);
+        startFiltering();
     }
 
     return ItemChosen;
 }
 
-MenuItemPointer FilterMenu::chosenItem()
+bool FilterMenu::changesFilter(KeyPress keyPress)
+{
+    return ! keyPress.escapePreceded
+        && ((keyPress.key >= 0 && keyPress.key < 256 && isprint(keyPress.key))
+            || keyPress.key == KEY_BACKSPACE || keyPress.key == KEY_TAB
+            || keyPress.key == KEY_CTRL_R
+            || keyPress.key == KEY_CTRL_C || keyPress.key == KEY_CTRL_D);
+}
+
+/// Returns the next key if it is pending or arrives before the next frame is
+/// due, otherwise ERR. This caps the frame rate while a key is auto-repeated.
+int FilterMenu::readTypeahead()
 {
-    return m_chosenItem;
+    const int key = m_renderer.readKey();
+    if (key != ERR)
+        return key;
+
+    using namespace std::chrono;
+    const int elapsed = duration_cast<milliseconds>(steady_clock::now() - m_frameTime).count();
+    pollfd input = { STDIN_FILENO, POLLIN, 0 };
+    if (elapsed >= MinimumFrameInterval || poll(&input, 1, MinimumFrameInterval - elapsed) != 1)
+        return ERR;
+    return m_renderer.readKey();
+}
+
+/// Wait for the next key without blocking anything else, e.g. take over
+/// changes of the model, show the result of filtering or load more items meanwhile.
+/// Returns ERR if an item got chosen meanwhile.
+int FilterMenu::readKey()
+{
+    Utils::FileUtils::FileInfoCache &fileInfoCache = Utils::FileUtils::FileInfoCache::globalInstance();
+
+    for (;;) {
+        // The renderer might have buffered keys already, so ask it first.
+        const int key = m_renderer.readKey();
+        if (key != ERR)
+            return key;
+
+        pollfd fileDescriptors[6];
+        nfds_t fileDescriptorCount = 0;
+        const auto addDescriptor = [&](int fileDescriptor) -> int {
+            if (fileDescriptor == -1)
+                return -1;
+            fileDescriptors[fileDescriptorCount].fd = fileDescriptor;
+            fileDescriptors[fileDescriptorCount].events = POLLIN;
+            return fileDescriptorCount++;
+        };
+        const auto isReadable = [&](int index) {
+            return index != -1 && (fileDescriptors[index].revents & POLLIN);
+        };
+        // The items must not change while filtering, so load more items only in
+        // between. Once loaded, index them in the background.
+        const bool isFilterIdle = ! m_filterWorker.isBusy();
+
+        const int inputIndex = addDescriptor(STDIN_FILENO);
+        addDescriptor(m_renderer.notificationDescriptor()); // Read by readKey()
+        const int filterIndex = addDescriptor(m_filterWorker.notificationDescriptor());
+        const int fileInfoIndex = addDescriptor(fileInfoCache.notificationDescriptor());
+        // Changes are taken once the filter is done, the worker wakes us up then.
+        const int modelIndex = addDescriptor(isFilterIdle || m_isIndexing
+                                             ? m_model->notificationDescriptor() : -1);
+        const int validationIndex = addDescriptor(m_model->fileInfoNotificationDescriptor());
+
+        const bool canFetchMore = isFilterIdle && m_model->canFetchMore();
+        if (isFilterIdle && ! canFetchMore && m_filter.canIndexMore()) {
+            m_isIndexing = true;
+            m_filterWorker.run([](Core::ItemFilter &filter) { filter.updateIndex(); });
+        }
+
+        // While the model is loading, keep on loading unless keys are pending.
+        // Otherwise wake up to show probes that time out.
+        const int timeout = canFetchMore ? 0 : fileInfoCache.timeUntilNextTimeout();
+        const int readyCount = poll(fileDescriptors, fileDescriptorCount, timeout);
+        if (readyCount == -1)
+            continue; // EINTR
+        if (readyCount == 0 && ! canFetchMore) {
+            updateProbedRows();
+            continue;
+        }
+
+        bool isProbed = isReadable(validationIndex) && m_model->takeFileInfos();
+        if (isReadable(fileInfoIndex) && fileInfoCache.takeResults())
+            isProbed = true;
+        if (isProbed) {
+            if (m_probingChosenRow != ItemStore::InvalidRow) {
+                fireProbed();
+                if (m_chosenRow != ItemStore::InvalidRow)
+                    return ERR;
+            }
+            updateProbedRows();
+        }
+
+        if (isReadable(filterIndex)) {
+            m_filterWorker.clearNotification();
+            if (isSearching()) {
+                // Superseded meanwhile
+            } else if (m_isIndexing) {
+                m_isIndexing = false;
+            } else {
+                updateMenu();
+                updateStatusBar();
+            }
+        }
+
+        if (isReadable(modelIndex)) {
+            if (updateItems(TakeChangedItems)) {
+                updateMenu();
+                updateStatusBar();
+            }
+        }
+
+        if (canFetchMore && ! isReadable(inputIndex)) {
+            fetchMoreItems();
+            updateMenu();
+            updateStatusBar();
+        }
+    }
+}
+
+uint32_t FilterMenu::chosenRow()
+{
+    return m_chosenRow;
 }
 
 void FilterMenu::reset()
 {
     m_selectedRow = 0;
     m_scrollView.resetTo(0);
+    clearScreen();
+}
+
+void FilterMenu::clearScreen()
+{
     // If the last entry is removed from the bookmarks file,
     // the menu is printed in its new dimensions. But the
     // last line is left on the screen. Therefore, clear the
     // window completely instead of doing just a refresh.
-    // The refresh will be triggered anyway at updateMenu().
-    wclear(m_window);
+    // The refresh will be triggered anyway at updateStatusBar().
+    m_renderer.clear();
+    invalidateMenu();
     m_statusBar.update();
 }
 
-void FilterMenu::updateMenu()
+/// Fit the windows to the resized terminal, see KEY_RESIZE. The filtered rows
+/// and the probed paths stay, and the lines left as they were are not redrawn.
+void FilterMenu::relayout()
 {
-    // Clear window
-    // wclear() flickers with urxvt. werase() works fine.
-    werase(m_window);
-
-    if (m_menuItems.empty())
-        return;
+    const int windowRows = menuLineCount(m_renderer);
+    m_statusBar.setLine(windowRows);
+    debug() << "FilterMenu: Window size: " << m_renderer.columnCount() << "x" << windowRows;
+
+    m_scrollView = ScrollView(m_scrollView.firstRow(), windowRows);
+    // While searching, the selection is at the first row anyway.
+    if (! isSearching()) {
+        finishFiltering();
+        ensureSelectedRowIsVisible();
+    }
+}
 
-    const int x = 0;
-    int y = 0;
+void FilterMenu::setSelectionHistory(const Core::SelectionHistory *history)
+{
+    m_selectionHistory = history;
+}
 
-    // Get width of first column
-    // Use m_allMenuItems to determine the width, otherwise the column will be adapted on filtering.
-    unsigned firstColumnWidth = 0;
-    for (auto v : m_allMenuItems) {
-        unsigned width = v->identifier().size();
-        if (width > firstColumnWidth)
-            firstColumnWidth = width;
+/// Redraw the lines showing other rows than before, or selected differently.
+/// Everything else, like the items, the filter or the hints, invalidates all.
+void FilterMenu::updateMenu()
+{
+    // Only the visible rows need to be ranked.
+    m_filter.rankRows(m_scrollView.lastRow() + 1);
+    skipEmptySelectedItem(); // Might scroll
+    m_filter.rankRows(m_scrollView.lastRow() + 1);
+
+    // Use all items to determine the width, otherwise the column will be adapted on filtering.
+    const unsigned identifierColumnWidth = m_model->identifierColumnWidth();
+    if (identifierColumnWidth != m_identifierColumnWidth) {
+        m_identifierColumnWidth = identifierColumnWidth;
+        m_isMenuDamaged = true;
     }
-
-    // Find first visible digit accessor
-    const unsigned firstRow = m_scrollView.firstRow();
-    unsigned digitAccessor = 0;
-    for (unsigned i = 0; i < firstRow; ++i) {
-        if (! m_menuItems.at(i)->isEmpty())
-            ++digitAccessor;
+    // Paths are chopped to the width, but a changed height keeps the lines.
+    const unsigned columnCount = m_renderer.columnCount();
+    if (columnCount != m_columnCount) {
+        m_columnCount = columnCount;
+        m_isMenuDamaged = true;
     }
+    // Lines gained by a higher window are drawn in any case, the status bar
+    // might have been there.
+    const unsigned lineCount = m_scrollView.rowCount();
+    const std::size_t drawnLineCount = m_isMenuDamaged
+        ? 0 : std::min<std::size_t>(m_drawnLines.size(), lineCount);
+    m_drawnLines.resize(lineCount);
+
+    const std::vector<uint32_t> &rows = m_filter.rows();
+    const unsigned firstRow = m_scrollView.firstRow();
+    updateDigitAccessors(m_scrollView.lastRow());
+    for (unsigned y = 0; y < lineCount; ++y) {
+        const unsigned index = firstRow + y;
+        DrawnLine line;
+        if (index < rows.size()) {
+            line.row = rows[index];
+            line.digitAccessor = digitAccessor(index);
+            line.isSelected = index == m_selectedRow;
+        }
+        if (y < drawnLineCount && line == m_drawnLines[y])
+            continue;
 
-    // Print them
-    unsigned int to = m_menuItems.size() - 1 < m_scrollView.lastRow()
-        ? m_menuItems.size() - 1
-        : m_scrollView.lastRow();
-    for (unsigned i = firstRow; i <= to; ++i, ++y) {
-        const MenuItemPointer item = m_menuItems.at(i);
-        const bool isCurrentItem = m_selectedRow == i;
-
-
-        std::string digitAccessorString;
-        if (digitAccessor <= 9 && ! item->isEmpty())
-            digitAccessorString = std::to_string(digitAccessor++);
-
-        MenuItemVisualHints hints(item);
-        int attributes = 0;
-        if (isCurrentItem)
-            attributes |= A_REVERSE;
-
-        wattrset(m_window, 0);
-        wattron(m_window, attributes);
-
-        // Clear line
-        // With these extra spaces A_REVERSE will highlight the full line
-        mvwhline(m_window, y, x, NCURSES_ACS(' '), 1000); // TODO: Is it OK to use NCURSES_ACS?
-
-        // Construct line
-        std::stringstream ss;
-        ss << std::right << std::setw(2) << digitAccessorString << ' '
-           << std::left << std::setw(firstColumnWidth) << item->identifier() << ' ';
-        const std::string outDigitAccessorAndIdentifier = ss.str();
+        m_drawnLines[y] = line;
+        if (line.row == ItemStore::InvalidRow)
+            m_renderer.clearLine(y, 0);
+        else
+            drawLine(y, index, line.digitAccessor);
+    }
+    m_isMenuDamaged = false;
+}
 
-        // Write line
-        mvwprintw(m_window, y, x, "%s", outDigitAccessorAndIdentifier.c_str());
+/// Draw the row at index of the filtered rows on line y of the window.
+void FilterMenu::drawLine(int y, unsigned index, int digitAccessor)
+{
+    const Core::ItemStore &items = m_model->items();
+    const uint32_t row = m_filter.rows()[index];
+    const bool isCurrentItem = m_selectedRow == index;
+    const int x = 0;
 
-        if (! isCurrentItem && NCursesApplication::supportsColors())
-            NCursesApplication::useColor(m_window, hints.color);
-        attributes |= hints.attributes;
-        wattron(m_window, attributes);
+    MenuItemVisualHints hints(*m_model, row);
+    int attributes = 0;
+    if (isCurrentItem)
+        attributes |= IRenderer::Reverse;
+
+    // Clear line
+    // With these extra spaces IRenderer::Reverse will highlight the full line
+    m_renderer.clearLine(y, x, attributes);
+
+    // Construct line: The digit accessor right aligned, then the identifier
+    m_lineBuffer.assign(digitAccessor == -1 ? 2 : 1, ' ');
+    if (digitAccessor != -1)
+        m_lineBuffer += static_cast<char>('0' + digitAccessor);
+    m_lineBuffer += ' ';
+    const StringRef identifier = items.identifier(row);
+    m_lineBuffer.append(identifier.data(), identifier.size());
+    if (identifier.size() < m_identifierColumnWidth)
+        m_lineBuffer.append(m_identifierColumnWidth - identifier.size(), ' ');
+    m_lineBuffer += ' ';
+
+    // Write line
+    m_renderer.drawText(y, x, StringRef(m_lineBuffer.data(), m_lineBuffer.size()), attributes);
+
+    const IRenderer::Color color = isCurrentItem ? IRenderer::ColorDefault : hints.color;
+    attributes |= hints.attributes;
+
+    std::string outPath = items.pathDisplayed(row).toString();
+    const int startPosition = x + 3  + m_identifierColumnWidth + 1;
+    NCursesApplication::maybeChop(m_columnCount, startPosition, outPath);
+    m_renderer.drawText(y, startPosition, StringRef(outPath.data(), outPath.size()), attributes, color);
+
+    // Highlight the characters matching the filter, keeping the other attributes.
+    std::vector<Core::ItemFilter::MatchedCharacter> matchedCharacters;
+    m_filter.matchedCharacters(row, matchedCharacters);
+    for (const Core::ItemFilter::MatchedCharacter &character : matchedCharacters) {
+        int column = -1;
+        if (character.column == Core::ItemStore::Identifier)
+            column = x + 3 + character.offset;
+        else if (character.offset < outPath.size())
+            column = startPosition + character.offset;
+        if (column != -1)
+            m_renderer.addAttributes(y, column, IRenderer::Bold | IRenderer::Underline);
+    }
+}
 
-        std::string outPath = item->pathDisplayed();
-        const int startPosition = x + 3  + firstColumnWidth + 1;
-        NCursesApplication::maybeChop(m_window, startPosition, outPath);
-        mvwprintw(m_window, y, startPosition, "%s", outPath.c_str());
+/// The lines drawn might not show the current items, the filter or the hints anymore.
+void FilterMenu::invalidateMenu()
+{
+    m_isMenuDamaged = true;
+    m_digitAccessorIndexes.clear();
+    m_digitAccessorScanEnd = 0;
+}
 
-        wattroff(m_window, attributes);
+/// Find the digit accessors among the filtered rows up to lastIndex, unless
+/// all are found already. Separators and headers have none.
+void FilterMenu::updateDigitAccessors(unsigned lastIndex)
+{
+    const Core::ItemStore &items = m_model->items();
+    const std::vector<uint32_t> &rows = m_filter.rows();
+    const std::size_t end = std::min<std::size_t>(std::size_t(lastIndex) + 1, rows.size());
+    while (m_digitAccessorScanEnd < end && m_digitAccessorIndexes.size() < DigitAccessorCount) {
+        // Rows behind the ranked ones are not in place yet, so rank page by page.
+        const std::size_t pageEnd = std::min<std::size_t>(end, m_digitAccessorScanEnd + m_scrollView.rowCount());
+        m_filter.rankRows(pageEnd);
+        for (; m_digitAccessorScanEnd < pageEnd && m_digitAccessorIndexes.size() < DigitAccessorCount;
+             ++m_digitAccessorScanEnd) {
+            if (! items.isEmpty(rows[m_digitAccessorScanEnd]))
+                m_digitAccessorIndexes.push_back(m_digitAccessorScanEnd);
+        }
     }
+}
 
-    wrefresh(m_window);
+/// The digit accessor of the filtered row at index, -1 if it has none.
+int FilterMenu::digitAccessor(unsigned index) const
+{
+    const std::vector<unsigned>::const_iterator it
+        = std::find(m_digitAccessorIndexes.begin(), m_digitAccessorIndexes.end(), index);
+    return it != m_digitAccessorIndexes.end() ? it - m_digitAccessorIndexes.begin() : -1;
 }
 
 void FilterMenu::updateStatusBar()
 {
     std::string text;
+    const std::string title = m_model->title();
+    if (! title.empty())
+        text = ' ' + title + ' ';
+    if (m_model->canFetchMore())
+        text += (text.empty() ? " " : "| ") + std::string("Loading: ")
+            + std::to_string(m_model->fetchProgress()) + "% ";
     const bool isFilterActive = ! m_filterInput.empty();
     if (isFilterActive)
-        text = " Filter: " + m_filterInput + ' ' ;
+        text += (text.empty() ? " " : "| ") + filterName() + ": " + m_filterInput + ' ' ;
+    if (m_isOrderedByFrecency)
+        text += (text.empty() ? " " : "| ") + std::string("Frecent first ");
+    if (isSearching()) {
+        m_statusBar.setText(text + "| Searching...", 0, IRenderer::ColorDefault);
+        m_statusBar.update();
+        m_renderer.update();
+        return;
+    }
+    if (! m_filter.patternError().empty()) {
+        m_statusBar.setText(text + "| " + m_filter.patternError(), 0, IRenderer::ColorRed);
+        m_statusBar.update();
+        m_renderer.update();
+        return;
+    }
 
     int attributes = 0;
-    NCursesApplication::Color color = NCursesApplication::ColorDefault;
-    if (m_selectedRow < m_menuItems.size()) {
-        MenuItemPointer selectedItem = m_menuItems.at(m_selectedRow);
-        MenuItemVisualHints hints(selectedItem);
+    IRenderer::Color color = IRenderer::ColorDefault;
+    if (m_selectedRow < m_filter.rows().size()) {
+        MenuItemVisualHints hints(*m_model, m_filter.rows()[m_selectedRow]);
         attributes |= hints.attributes;
         color = hints.color;
-        const std::string textToAppend = (isFilterActive ? "| " : "") + hints.hint;
+        const std::string textToAppend = (text.empty() ? "" : "| ") + hints.hint;
         text += textToAppend;
     }
 
     m_statusBar.setText(text, attributes, color);
     m_statusBar.update();
+    m_renderer.update();
 }
 
 bool FilterMenu::navigateToStart()
@@ -215,12 +518,12 @@ bool FilterMenu::navigateToStart()
 
 bool FilterMenu::navigateToEnd()
 {
-    if (m_menuItems.empty())
+    if (m_filter.rows().empty())
         return true;
 
-    m_selectedRow = m_menuItems.size() - 1;
+    m_selectedRow = m_filter.rows().size() - 1;
 
-    if (m_menuItems.size() == 0)
+    if (m_filter.rows().size() == 0)
         m_scrollView.resetTo(0);
     else if (m_scrollView.lastRow() < m_selectedRow)
         m_scrollView.resetTo(m_selectedRow - (m_scrollView.rowCount() - 1));
@@ -230,33 +533,25 @@ bool FilterMenu::navigateToEnd()
 
 bool FilterMenu::navigateByDigit()
 {
-    if (m_menuItems.empty())
+    if (m_filter.rows().empty())
         return true;
 
     const unsigned digit = m_key - '0';
-    const unsigned lastRow = m_menuItems.size() - 1;
-
-    for (unsigned i = 0, digitCounter = 0; i <= lastRow; ++i) {
-        if (m_menuItems.at(i)->isEmpty())
-            continue;
-
-        if (digitCounter == digit) {
-            const unsigned newRow = i;
-            m_selectedRow = newRow <= lastRow ? newRow : lastRow;
-            if (m_scrollView.isRowBefore(m_selectedRow)) {
-                m_scrollView.resetTo(m_selectedRow);
-            } else if (m_scrollView.isRowBehind(m_selectedRow)) {
-                const unsigned countFollowingEntries = lastRow - m_selectedRow;
-                const unsigned scrollViewRowCount = m_scrollView.rowCount();
-                const unsigned newFirstRowOfScrollView = countFollowingEntries >= scrollViewRowCount
-                    ? m_selectedRow
-                    : m_selectedRow - (scrollViewRowCount - 1 - countFollowingEntries);
-                m_scrollView.resetTo(newFirstRowOfScrollView);
-            }
-            return true;
-        }
+    const unsigned lastRow = m_filter.rows().size() - 1;
+    updateDigitAccessors(lastRow);
+    if (digit >= m_digitAccessorIndexes.size())
+        return true;
 
-        ++digitCounter;
+    m_selectedRow = m_digitAccessorIndexes[digit];
+    if (m_scrollView.isRowBefore(m_selectedRow)) {
+        m_scrollView.resetTo(m_selectedRow);
+    } else if (m_scrollView.isRowBehind(m_selectedRow)) {
+        const unsigned countFollowingEntries = lastRow - m_selectedRow;
+        const unsigned scrollViewRowCount = m_scrollView.rowCount();
+        const unsigned newFirstRowOfScrollView = countFollowingEntries >= scrollViewRowCount
+            ? m_selectedRow
+            : m_selectedRow - (scrollViewRowCount - 1 - countFollowingEntries);
+        m_scrollView.resetTo(newFirstRowOfScrollView);
     }
 
     return true;
@@ -280,6 +575,62 @@ bool FilterMenu::chopFromFilter()
     return true;
 }
 
+bool FilterMenu::toggleFilterMode()
+{
+    const bool isFuzzy = m_filterMode == Core::ItemFilter::FuzzyMode;
+    setFilterMode(isFuzzy ? Core::ItemFilter::SubstringMode : Core::ItemFilter::FuzzyMode);
+    return true;
+}
+
+/// Cycle through the glob and the regular expression mode, then back to plain filtering.
+bool FilterMenu::togglePatternMode()
+{
+    switch (m_filterMode) {
+    case Core::ItemFilter::GlobMode:
+        setFilterMode(Core::ItemFilter::RegexMode);
+        break;
+    case Core::ItemFilter::RegexMode:
+        setFilterMode(Core::ItemFilter::SubstringMode);
+        break;
+    default:
+        setFilterMode(Core::ItemFilter::GlobMode);
+        break;
+    }
+    return true;
+}
+
+/// Rank the items chosen often and lately first, or go back to the order of the model.
+bool FilterMenu::toggleFrecencyOrder()
+{
+    if (! m_selectionHistory)
+        return false;
+
+    finishFiltering();
+    m_isOrderedByFrecency = ! m_isOrderedByFrecency;
+    updateRowScores(0);
+    m_selectedRow = 0;
+    m_scrollView.resetTo(0);
+    return true;
+}
+
+void FilterMenu::setFilterMode(Core::ItemFilter::Mode mode)
+{
+    invalidateMenu();
+    m_filterMode = mode;
+    m_isFilterPending = true;
+    m_selectedRow = 0;
+    m_scrollView.resetTo(0);
+}
+
+void FilterMenu::setCaseSensitivity(Core::ItemFilter::CaseSensitivity caseSensitivity)
+{
+    invalidateMenu();
+    m_caseSensitivity = caseSensitivity;
+    m_isFilterPending = true;
+    m_selectedRow = 0;
+    m_scrollView.resetTo(0);
+}
+
 bool FilterMenu::clearFilter()
 {
     if (m_filterInput.empty())
@@ -293,15 +644,23 @@ bool FilterMenu::clearFilter()
 
 bool FilterMenu::navigateEntryUp()
 {
-    if (m_menuItems.empty())
+    if (m_filter.rows().empty())
         return true;
 
     if (m_selectedRow == 0) {
         if (m_optionWrapOnEntryNavigation)
             navigateToEnd();
     } else {
+        const Core::ItemStore &items = m_model->items();
         const unsigned originalSelectedRow = m_selectedRow;
-        while (m_menuItems.at(--m_selectedRow)->isEmpty());
+        unsigned row = m_selectedRow;
+        while (row > 0 && items.isEmpty(m_filter.rows()[--row]));
+        if (items.isEmpty(m_filter.rows()[row])) {
+            // Only separators or headers above, show them at least.
+            m_scrollView.resetTo(0);
+            return true;
+        }
+        m_selectedRow = row;
 
         const bool nonVisibleItemsBefore = m_scrollView.firstRow() != 0;
         const bool selectedLineWouldBeInvisible = m_selectedRow <= m_scrollView.firstRow() - 1;
@@ -314,7 +673,7 @@ bool FilterMenu::navigateEntryUp()
 
 bool FilterMenu::navigateEntryDown()
 {
-    const unsigned menuItemsSize = m_menuItems.size();
+    const unsigned menuItemsSize = m_filter.rows().size();
     if (menuItemsSize == 0)
         return true;
 
@@ -322,8 +681,17 @@ bool FilterMenu::navigateEntryDown()
         if (m_optionWrapOnEntryNavigation)
             navigateToStart();
     } else {
+        const Core::ItemStore &items = m_model->items();
         const unsigned originalSelectedRow = m_selectedRow;
-        while (m_menuItems.at(++m_selectedRow)->isEmpty());
+        unsigned row = m_selectedRow;
+        while (row < menuItemsSize - 1) {
+            m_filter.rankRows(++row + 1); // The row below the page is not ranked yet
+            if (! items.isEmpty(m_filter.rows()[row]))
+                break;
+        }
+        if (items.isEmpty(m_filter.rows()[row]))
+            return true; // Only separators below
+        m_selectedRow = row;
 
         const bool nonVisibleItemsFollowing = m_scrollView.lastRow() < menuItemsSize - 1;
         const bool selectedLineWouldBeInvisible = m_selectedRow >= m_scrollView.lastRow() + 1;
@@ -336,7 +704,7 @@ bool FilterMenu::navigateEntryDown()
 
 bool FilterMenu::navigatePageUp()
 {
-    if (m_menuItems.empty())
+    if (m_filter.rows().empty())
         return true;
 
     if (m_selectedRow == 0) {
@@ -357,17 +725,17 @@ bool FilterMenu::navigatePageUp()
 
 bool FilterMenu::navigatePageDown()
 {
-    if (m_menuItems.empty())
+    if (m_filter.rows().empty())
         return true;
 
-    if (m_selectedRow == m_menuItems.size() - 1) {
+    if (m_selectedRow == m_filter.rows().size() - 1) {
         assert(m_selectedRow == m_scrollView.lastRow())
         return true;
     }
 
     const unsigned newFirstRow = m_scrollView.lastRow() + 1;
     const unsigned newLastRow = newFirstRow + m_scrollView.rowCount() - 1;
-    if (newLastRow < m_menuItems.size() - 1) {
+    if (newLastRow < m_filter.rows().size() - 1) {
         m_selectedRow = newFirstRow;
         m_scrollView.resetTo(newFirstRow);
     } else {
@@ -379,26 +747,56 @@ bool FilterMenu::navigatePageDown()
 
 bool FilterMenu::fire()
 {
-    if (m_menuItems.empty())
+    if (m_filter.rows().empty())
         return true;
 
-    assert(m_selectedRow <= m_menuItems.size() - 1);
-    MenuItemPointer item = m_menuItems.at(m_selectedRow);
+    assert(m_selectedRow <= m_filter.rows().size() - 1);
+    const Core::ItemStore &items = m_model->items();
+    const uint32_t row = m_filter.rows().at(m_selectedRow);
 
-    if (item->isEmpty())
-        return true;
-    Utils::FileUtils::FileInfo info(item->path());
-    if (! info.exists)
+    if (items.isEmpty(row))
         return true;
-
-    m_chosenItem = item;
+    m_probingChosenRow = row;
+    fireProbed();
     return true;
 }
 
+/// Choose m_probingChosenRow if it exists. If it is still probed, decide
+/// once the result is there, unless another key is pressed meanwhile.
+void FilterMenu::fireProbed()
+{
+    Utils::FileUtils::FileInfo info;
+    if (! m_model->fileInfo(m_probingChosenRow, info)) {
+        const std::string path = m_model->items().path(m_probingChosenRow).toString();
+        info = Utils::FileUtils::FileInfoCache::globalInstance().fileInfo(path);
+    }
+    if (! info.isProbed)
+        return;
+
+    if (info.exists)
+        m_chosenRow = m_probingChosenRow;
+    m_probingChosenRow = ItemStore::InvalidRow;
+}
+
+std::string FilterMenu::filterName() const
+{
+    switch (m_filterMode) {
+    case Core::ItemFilter::FuzzyMode:
+        return "Fuzzy filter";
+    case Core::ItemFilter::GlobMode:
+        return "Glob filter";
+    case Core::ItemFilter::RegexMode:
+        return "Regex filter";
+    default:
+        return "Filter";
+    }
+}
+
 void FilterMenu::printInputSoFar()
 {
-    mvwprintw(m_window, 1, 1, "Filter: '%s'", m_filterInput.c_str());
-    wrefresh(m_window);
+    const std::string text = "Filter: '" + m_filterInput + '\'';
+    m_renderer.drawText(1, 1, StringRef(text.data(), text.size()));
+    m_renderer.update();
     // wclear(m_menu_win); // This one flickers with urxvt.
 }
 
@@ -414,22 +812,270 @@ bool FilterMenu::handleKey(KeyPress keyPress)
 
 void FilterMenu::onFilterStringUpdated()
 {
+    invalidateMenu();
     m_selectedRow = 0;
     m_scrollView.resetTo(0);
+    m_isFilterPending = true;
+}
 
-    if (m_filterInput.empty()) {
-        m_menuItems = m_allMenuItems;
+/// Filter for the input and the mode set meanwhile, superseding the running search.
+void FilterMenu::startFiltering()
+{
+    if (! m_isFilterPending)
         return;
+    m_isFilterPending = false;
+    m_model->setFilter(m_filterInput, m_filterMode, m_caseSensitivity);
+    runFilter();
+}
+
+/// Let the worker filter for the input and the mode, resuming a canceled search.
+void FilterMenu::runFilter()
+{
+    const std::string filterString = m_filterInput;
+    const Core::ItemFilter::Mode mode = m_filterMode;
+    const Core::ItemFilter::CaseSensitivity caseSensitivity = m_caseSensitivity;
+    // A waiting job is dropped, so each one sets all.
+    m_filterWorker.run([filterString, mode, caseSensitivity](Core::ItemFilter &filter) {
+        filter.setMode(mode);
+        filter.setCaseSensitivity(caseSensitivity);
+        filter.setFilterString(filterString);
+    });
+    m_isIndexing = false;
+}
+
+/// Show new hints of the visible rows, unless the new rows are not there yet.
+void FilterMenu::updateProbedRows()
+{
+    if (isSearching())
+        return;
+    finishFiltering(); // Stops indexing, the rows are used for drawing
+    invalidateMenu();
+    updateMenu();
+    updateStatusBar();
+}
+
+/// Searching means filtering for new input, as opposed to indexing.
+bool FilterMenu::isSearching()
+{
+    return ! m_isIndexing && m_filterWorker.isBusy();
+}
+
+/// Take the filter back from the worker thread without waiting for the result.
+/// Returns true if a search was canceled, see runFilter() to resume it.
+bool FilterMenu::cancelFiltering()
+{
+    const bool isSearchCanceled = isSearching();
+    m_filterWorker.cancel();
+    m_isIndexing = false;
+    return isSearchCanceled;
+}
+
+/// Take the filter back from the worker thread.
+void FilterMenu::finishFiltering()
+{
+    if (m_isIndexing) {
+        m_filterWorker.cancel(); // Resumed once idle again
+        m_isIndexing = false;
+    } else {
+        m_filterWorker.wait();
+    }
+}
+
+/// Take over the changed items of the model, but keep the filter and the
+/// selected item, if it still exists. Returns false if nothing changed.
+bool FilterMenu::updateItems(ItemsChange change)
+{
+    finishFiltering();
+
+    // The old items are gone after the update, so remember the selected one.
+    uint32_t oldRow = ItemStore::InvalidRow;
+    std::string identifier;
+    std::string path;
+    if (m_selectedRow < m_filter.rows().size()) {
+        const Core::ItemStore &oldItems = m_model->items();
+        oldRow = m_filter.rows()[m_selectedRow];
+        identifier = oldItems.identifier(oldRow).toString();
+        path = oldItems.path(oldRow).toString();
     }
 
-    m_menuItems.clear();
-    for (unsigned i = 0; i < m_allMenuItems.size(); ++i) {
-        MenuItemPointer item = m_allMenuItems.at(i);
-        const bool identifierMatches = item->identifier().find(m_filterInput) != std::string::npos;
-        const bool pathMatches = item->pathDisplayed().find(m_filterInput) != std::string::npos;
-        if (identifierMatches || pathMatches)
-            m_menuItems.push_back(item);
+    Core::ItemsUpdate update;
+    const uint32_t oldCount = m_model->items().size();
+    const bool changed = change == ReloadItems ? m_model->reload(update)
+                                               : m_model->takeChanges(update);
+    if (! changed)
+        return false;
+
+    // Appended items are just filtered, e.g. the ones found meanwhile.
+    if (update.removedCount == 0 && update.firstRow == oldCount) {
+        m_filter.addRows(m_model->items(), update.firstRow, update.firstRow + update.insertedCount);
+        updateRowScores(update.firstRow);
+        return true;
+    }
+    m_probingChosenRow = ItemStore::InvalidRow;
+
+    // Map the selected item to its row in the new items
+    const Core::ItemStore &items = m_model->items();
+    uint32_t selectedItemRow = ItemStore::InvalidRow;
+    if (oldRow == ItemStore::InvalidRow) {
+        // Nothing selected
+    } else if (oldRow < update.firstRow) {
+        selectedItemRow = oldRow;
+    } else if (oldRow >= update.firstRow + update.removedCount) {
+        selectedItemRow = oldRow - update.removedCount + update.insertedCount;
+    } else {
+        // The selected line was edited, look for the same bookmark among the new ones.
+        for (uint32_t row = update.firstRow; row < update.firstRow + update.insertedCount; ++row) {
+            const StringRef rowIdentifier = items.identifier(row);
+            const StringRef rowPath = items.path(row);
+            if (rowIdentifier.size() == identifier.size() && rowPath.size() == path.size()
+                    && std::equal(rowIdentifier.begin(), rowIdentifier.end(), identifier.begin())
+                    && std::equal(rowPath.begin(), rowPath.end(), path.begin())) {
+                selectedItemRow = row;
+                break;
+            }
+        }
+    }
+
+    m_filter.reset(items);
+    updateRowScores(0);
+
+    // Select the mapped item, otherwise stay at the same row.
+    if (selectedItemRow != ItemStore::InvalidRow) {
+        const uint32_t index = m_filter.indexOf(selectedItemRow);
+        if (index != ItemStore::InvalidRow)
+            m_selectedRow = index;
+    }
+    if (m_selectedRow >= m_filter.rows().size())
+        m_selectedRow = m_filter.rows().empty() ? 0 : m_filter.rows().size() - 1;
+    ensureSelectedRowIsVisible();
+    return true;
+}
+
+void FilterMenu::setModel(Core::IModel &model)
+{
+    finishFiltering();
+    m_probingChosenRow = ItemStore::InvalidRow;
+    m_isFilterPending = false;
+    m_filterInput.clear();
+    m_filter.setFilterString(m_filterInput);
+    m_model = &model;
+    m_model->setFilter(m_filterInput, m_filterMode, m_caseSensitivity);
+    m_filter.reset(m_model->items());
+    updateRowScores(0);
+    m_selectedRow = 0;
+    m_scrollView.resetTo(0);
+    clearScreen();
+}
+
+uint32_t FilterMenu::selectedItemRow() const
+{
+    return m_selectedRow < m_filter.rows().size() ? m_filter.rows()[m_selectedRow]
+                                                  : ItemStore::InvalidRow;
+}
+
+/// Select the item at row of the model, if it is not filtered out.
+void FilterMenu::selectItem(uint32_t row)
+{
+    finishFiltering();
+    const uint32_t index = m_filter.indexOf(row);
+    if (index == ItemStore::InvalidRow)
+        return;
+    m_selectedRow = index;
+    ensureSelectedRowIsVisible();
+}
+
+/// The selection is reset to the first row, which might be a header or a
+/// separator. Select the next item instead, or else the previous one.
+void FilterMenu::skipEmptySelectedItem()
+{
+    const Core::ItemStore &items = m_model->items();
+    const std::vector<uint32_t> &rows = m_filter.rows();
+    if (m_selectedRow >= rows.size())
+        return;
+    // Only the ranked rows are valid to read, rank further a page at a time.
+    unsigned rankedEnd = m_selectedRow + 1;
+    m_filter.rankRows(rankedEnd);
+    if (! items.isEmpty(rows[m_selectedRow]))
+        return;
+
+    for (unsigned row = m_selectedRow + 1; row < rows.size(); ++row) {
+        if (row >= rankedEnd) {
+            rankedEnd = row + 1 + m_scrollView.rowCount();
+            m_filter.rankRows(rankedEnd);
+        }
+        if (! items.isEmpty(rows[row])) {
+            m_selectedRow = row;
+            ensureSelectedRowIsVisible();
+            return;
+        }
+    }
+    for (unsigned row = m_selectedRow; row-- > 0; ) {
+        if (! items.isEmpty(rows[row])) {
+            m_selectedRow = row;
+            ensureSelectedRowIsVisible();
+            return;
+        }
+    }
+}
+
+void FilterMenu::ensureSelectedRowIsVisible()
+{
+    // Do not leave empty rows at the end if the items shrank.
+    const unsigned rowCount = m_scrollView.rowCount();
+    if (m_scrollView.firstRow() + rowCount > m_filter.rows().size())
+        m_scrollView.resetTo(m_filter.rows().size() > rowCount ? m_filter.rows().size() - rowCount : 0);
+
+    if (m_scrollView.isRowBefore(m_selectedRow))
+        m_scrollView.resetTo(m_selectedRow);
+    else if (m_scrollView.isRowBehind(m_selectedRow))
+        m_scrollView.resetTo(m_selectedRow - (rowCount - 1));
+}
+
+/// Take over the next chunk of items of a progressively loading model. They
+/// are appended, so the selection stays as it is.
+void FilterMenu::fetchMoreItems()
+{
+    Core::ItemsUpdate update;
+    m_model->fetchMore(update);
+    assert(update.removedCount == 0);
+    m_filter.addRows(m_model->items(), update.firstRow, update.firstRow + update.insertedCount);
+    updateRowScores(update.firstRow);
+}
+
+/// Score the items from firstRow on, the ones before are scored already: By
+/// their priority, then by their frecency if ordered by it.
+void FilterMenu::updateRowScores(uint32_t firstRow)
+{
+    invalidateMenu(); // Called whenever the filtered rows change
+    const bool hasPriorities = m_model->hasPriorities();
+    const bool isOrderedByFrecency = m_isOrderedByFrecency && ! m_selectionHistory->isEmpty();
+    if (! hasPriorities && ! isOrderedByFrecency) {
+        if (! m_rowScores.empty()) {
+            m_rowScores.clear();
+            m_filter.setRowScores(m_rowScores);
+        }
+        return;
+    }
+
+    const Core::ItemStore &items = m_model->items();
+    const int64_t now = time(0);
+    bool isScored = firstRow == 0;
+    m_rowScores.resize(items.size());
+    std::string path;
+    for (uint32_t row = firstRow; row < items.size(); ++row) {
+        double score = hasPriorities ? m_model->priority(row) * PriorityWeight : 0;
+        if (isOrderedByFrecency) {
+            const StringRef rowPath = items.path(row);
+            path.assign(rowPath.data(), rowPath.size());
+            score += m_selectionHistory->score(path, now);
+        }
+        m_rowScores[row] = score;
+        if (score != 0)
+            isScored = true;
     }
+    // New rows scoring 0 rank the same without being passed.
+    if (isScored)
+        m_filter.setRowScores(m_rowScores);
 }
 
 } // namespace NCurses
@@ -2,17 +2,21 @@
 #define FILTERMENU_H
 
 #include "ikeyhandler.h"
+#include "irenderer.h"
 #include "scrollview.h"
 #include "statusbar.h"
 
-#include "core/imenuitem.h"
+#include "core/filterworker.h"
 #include "core/imodel.h"
+#include "core/itemfilter.h"
+#include "core/selectionhistory.h"
 
+#include <chrono>
+#include <cstdint>
 #include <functional>
 #include <map>
 #include <string>
-
-#include <ncurses.h>
+#include <vector>
 
 namespace TUI {
 namespace NCurses {
@@ -21,13 +25,20 @@ class FilterMenu : public IKeyController
 {
 public:
     FilterMenu(Core::IModel &model, IKeyController *parentKeyHandler = 0);
-    ~FilterMenu() { delwin(m_window); }
 
     enum MenuResult { ItemChosen, NoItemChosen };
     int exec();
-    MenuItemPointer chosenItem();
+    /// Row of the chosen item in the items of the model.
+    uint32_t chosenRow();
 
     void reset();
+    void clearScreen();
+    void relayout();
+
+    /// Enables ordering the items by frecency, see toggleFrecencyOrder().
+    void setSelectionHistory(const Core::SelectionHistory *history);
+    /// Case sensitive by default.
+    void setCaseSensitivity(Core::ItemFilter::CaseSensitivity caseSensitivity);
 
     void updateMenu();
     void updateStatusBar();
@@ -45,34 +56,98 @@ public:
     bool appendToFilter();
     bool chopFromFilter();
     bool clearFilter();
+    bool toggleFilterMode();
+    bool togglePatternMode();
+    bool toggleFrecencyOrder();
 
 protected:
     using KeyHandlerFunction = std::function<bool()>;
     using KeyMap = std::map<IKeyController::KeyPress, KeyHandlerFunction>;
     using KeyMapIterator = std::map<IKeyController::KeyPress, KeyHandlerFunction>::iterator;
 
-    Core::IModel &m_model;
+    enum ItemsChange { ReloadItems, TakeChangedItems };
+    bool updateItems(ItemsChange change);
+
+    Core::IModel &model() { return *m_model; }
+    /// Show the items of another model, unfiltered.
+    void setModel(Core::IModel &model);
+    /// Row of the selected item in the items of the model, InvalidRow if none.
+    uint32_t selectedItemRow() const;
+    void selectItem(uint32_t row);
+
+    Core::IModel *m_model;
     KeyMap m_map;
-    MenuItems m_allMenuItems;
-    MenuItems m_menuItems; // Currently filtered menu items
+    Core::ItemFilter m_filter; // Rows of the currently filtered items, see m_filterWorker
 
 private:
+    std::string filterName() const;
     void printInputSoFar();
+    int readKey();
+    int readTypeahead();
     bool handleKey(KeyPress keyPress);
+    static bool changesFilter(KeyPress keyPress);
+    void setFilterMode(Core::ItemFilter::Mode mode);
     void onFilterStringUpdated();
+    void startFiltering();
+    void runFilter();
+    void fireProbed();
+    void updateProbedRows();
+    bool isSearching();
+    bool cancelFiltering();
+    void finishFiltering();
+    void fetchMoreItems();
+    void skipEmptySelectedItem();
+    void ensureSelectedRowIsVisible();
+    void updateRowScores(uint32_t firstRow);
+    void invalidateMenu();
+    void updateDigitAccessors(unsigned lastIndex);
+    int digitAccessor(unsigned index) const;
+    void drawLine(int y, unsigned index, int digitAccessor);
 
     /// When true, jump to the first entry if pressing down arrow on last
     /// item and jump to the last entry if pressing up arrow on first item.
     bool m_optionWrapOnEntryNavigation;
 
     int m_key;
-    MenuItemPointer m_chosenItem;
+    uint32_t m_chosenRow;
+    uint32_t m_probingChosenRow; // Chosen before its path was probed, see fire()
     std::string m_filterInput;
     IKeyController *m_parentKeyHandler;
     ScrollView m_scrollView;
     unsigned m_selectedRow;
-    WINDOW *m_window;
+    IRenderer &m_renderer;
     StatusBar m_statusBar;
+    Core::FilterWorker m_filterWorker; // Filters in the background, owns m_filter while busy
+    bool m_isIndexing;
+    Core::ItemFilter::Mode m_filterMode; // Of m_filter, once the worker is done
+    Core::ItemFilter::CaseSensitivity m_caseSensitivity; // Likewise
+    const Core::SelectionHistory *m_selectionHistory;
+    bool m_isOrderedByFrecency;
+    bool m_isFilterPending; // Input or mode changed, see startFiltering()
+    std::chrono::steady_clock::time_point m_frameTime; // Last drawn by exec()
+    std::vector<double> m_rowScores; // Priorities and frecencies, see updateRowScores()
+
+    /// What a line of the menu shows, to redraw only the lines that changed.
+    struct DrawnLine
+    {
+        DrawnLine() : row(Core::ItemStore::InvalidRow), digitAccessor(-1), isSelected(false) {}
+        bool operator==(const DrawnLine &other) const
+        {
+            return row == other.row && digitAccessor == other.digitAccessor
+                && isSelected == other.isSelected;
+        }
+
+        uint32_t row;
+        int digitAccessor;
+        bool isSelected;
+    };
+    std::vector<DrawnLine> m_drawnLines;
+    bool m_isMenuDamaged; // All lines need to be redrawn, see invalidateMenu()
+    unsigned m_identifierColumnWidth; // Of the drawn lines
+    unsigned m_columnCount; // Of the drawn lines
+    std::vector<unsigned> m_digitAccessorIndexes; // Into m_filter.rows(), at most ten
+    unsigned m_digitAccessorScanEnd; // Rows before are looked at for digit accessors
+    std::string m_lineBuffer;
 };
 
 } // namespace NCurses
@@ -1,19 +1,24 @@
 LIBS += -lncurses
 
 SOURCES += \
+    $$PWD/ansirenderer.cpp \
     $$PWD/bookmarkmenu.cpp \
     $$PWD/filtermenu.cpp \
     $$PWD/ikeyhandler.cpp \
     $$PWD/menuitemvisualhints.cpp \
     $$PWD/ncursesapplication.cpp \
+    $$PWD/ncursesrenderer.cpp \
     $$PWD/scrollview.cpp \
     $$PWD/statusbar.cpp \
 
 HEADERS += \
+    $$PWD/ansirenderer.h \
     $$PWD/bookmarkmenu.h \
     $$PWD/filtermenu.h \
     $$PWD/ikeyhandler.h \
+    $$PWD/irenderer.h \
     $$PWD/menuitemvisualhints.h \
     $$PWD/ncursesapplication.h \
+    $$PWD/ncursesrenderer.h \
     $$PWD/scrollview.h \
     $$PWD/statusbar.h \
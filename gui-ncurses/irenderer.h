@@ -0,0 +1,65 @@
+#ifndef IRENDERER_H
+#define IRENDERER_H
+
+#include "utils/stringutils.h"
+
+namespace TUI {
+namespace NCurses {
+
+/// Draws on the terminal and reads its keys, either by ncurses or by writing
+/// ANSI escape sequences directly. Lines and columns count from the top left.
+///
+/// What is drawn stays until it is drawn over, and shows up on update().
+/// Keys are the ones of ncurses, e.g. KEY_UP or KEY_RESIZE.
+class IRenderer
+{
+public:
+    enum Color {
+        ColorDefault,
+        ColorRed,
+        ColorGreen,
+        ColorYellow,
+        ColorBlue,
+        ColorMagenta,
+        ColorCyan,
+        ColorWhite
+    };
+
+    enum Attribute {
+        Bold = 1,
+        Underline = 2,
+        Reverse = 4
+    };
+
+    virtual ~IRenderer() {}
+
+    virtual int lineCount() = 0;
+    virtual int columnCount() = 0;
+    virtual bool supportsColors() = 0;
+
+    /// Draws text from column on, cut off at the right edge.
+    virtual void drawText(int line, int column, Utils::StringUtils::StringRef text,
+                          int attributes = 0, Color color = ColorDefault) = 0;
+    /// Blanks the line from column on, e.g. Reverse highlights the rest of it.
+    virtual void clearLine(int line, int column, int attributes = 0) = 0;
+    virtual void drawHorizontalLine(int line, int column, int attributes = 0) = 0;
+    /// Adds attributes to a character drawn already, keeping its other ones.
+    virtual void addAttributes(int line, int column, int attributes) = 0;
+    /// Blanks all, and the next update() draws the whole terminal anew.
+    virtual void clear() = 0;
+    virtual void update() = 0;
+
+    /// Returns the next key without blocking, ERR if there is none.
+    virtual int readKey() = 0;
+    /// Readable if readKey() has a key besides the ones on stdin, -1 if none.
+    virtual int notificationDescriptor() = 0;
+
+    /// Gives the terminal back, e.g. to run an editor, until resume().
+    virtual void suspend() = 0;
+    virtual void resume() = 0;
+};
+
+} // namespace NCurses
+} // namespace TUI
+
+#endif // IRENDERER_H
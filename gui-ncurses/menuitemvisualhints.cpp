@@ -1,41 +1,57 @@
 #include "menuitemvisualhints.h"
 
 #include "utils/debugutils.h"
-#include "utils/fileutils.h"
+#include "utils/fileinfocache.h"
+
+#include <cerrno>
+#include <cstring>
 
 namespace TUI {
 namespace NCurses {
 
-MenuItemVisualHints::MenuItemVisualHints(const MenuItemPointer item)
-    : color(NCursesApplication::ColorDefault)
+MenuItemVisualHints::MenuItemVisualHints(Core::IModel &model, uint32_t row)
+    : color(IRenderer::ColorDefault)
     , attributes(0)
 {
-    assert(item);
+    const Core::ItemStore &items = model.items();
+    assert(row < items.size());
 
-    if (! item->isEmpty()) {
-        const std::string path = item->path();
-        Utils::FileUtils::FileInfo fileInfo(path);
+    if (! items.isEmpty(row)) {
+        Utils::FileUtils::FileInfo fileInfo;
+        if (! model.fileInfo(row, fileInfo)) {
+            fileInfo = Utils::FileUtils::FileInfoCache::globalInstance()
+                .fileInfo(items.path(row).toString());
+        }
 
-        if (fileInfo.exists) {
+        if (! fileInfo.isProbed) {
+            // Drawn as usual, but the status bar tells why nothing happens on RETURN.
+            hint = fileInfo.isTimedOut
+                ? " File system is not responding, still waiting... "
+                : " Probing file or directory... ";
+            if (fileInfo.isTimedOut && NCursesApplication::supportsColors())
+                color = IRenderer::ColorYellow;
+        } else if (fileInfo.exists) {
             if (fileInfo.isDirectory) {
                 hint = " Press RETURN to enter the directory ";
                 if (NCursesApplication::supportsColors())
-                    color = NCursesApplication::ColorBlue;
+                    color = IRenderer::ColorBlue;
                 else
-                    attributes |= A_BOLD;
+                    attributes |= IRenderer::Bold;
             } else {
                 if (fileInfo.isExecutable && NCursesApplication::supportsColors())
-                    color = NCursesApplication::ColorGreen;
+                    color = IRenderer::ColorGreen;
                 // TODO: Add a proper hint once we can nicely execute command lines
                 // in the outer shell function handler.
                 hint = " TODO: Proper hint ";
             }
         } else {
             if (NCursesApplication::supportsColors())
-                color = NCursesApplication::ColorRed;
+                color = IRenderer::ColorRed;
             else
-                attributes |= A_UNDERLINE;
-            hint = " Error: File or directory does not exist ";
+                attributes |= IRenderer::Underline;
+            hint = fileInfo.error == ENOENT
+                ? " Error: File or directory does not exist "
+                : std::string(" Error: ") + strerror(fileInfo.error) + ' ';
         }
     }
 }
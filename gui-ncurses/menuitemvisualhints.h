@@ -3,8 +3,9 @@
 
 #include "ncursesapplication.h"
 
-#include "core/imenuitem.h"
+#include "core/imodel.h"
 
+#include <cstdint>
 #include <string>
 
 namespace TUI {
@@ -13,10 +14,11 @@ namespace NCurses {
 class MenuItemVisualHints
 {
 public:
-    MenuItemVisualHints(const MenuItemPointer item);
+    /// Uses the file info validated by the model, if any.
+    MenuItemVisualHints(Core::IModel &model, uint32_t row);
 
-    NCursesApplication::Color color;
-    int attributes;
+    IRenderer::Color color;
+    int attributes; ///< See IRenderer::Attribute
     std::string hint;
 };
 
@@ -1,6 +1,8 @@
 #ifndef NCURSESAPPLICATION_H
 #define NCURSESAPPLICATION_H
 
+#include "irenderer.h"
+
 #include "ncurses.h"
 
 #include <cstdlib>
@@ -9,8 +11,14 @@
 namespace TUI {
 namespace NCurses {
 
+const int KEY_CTRL_B = 2;
 const int KEY_CTRL_C = 3;
 const int KEY_CTRL_D = 4;
+const int KEY_CTRL_F = 6;
+const int KEY_TAB = 9;
+const int KEY_CTRL_L = 12;
+const int KEY_CTRL_O = 15;
+const int KEY_CTRL_R = 18;
 const int KEY_ESC = 27;
 const int KEY_RETURN = 10;
 
@@ -18,29 +26,22 @@ const int KEY_RETURN = 10;
 class NCursesApplication
 {
 public:
-    NCursesApplication();
-    ~NCursesApplication();
+    /// The terminal is driven by AnsiRenderer if it is known to support it,
+    /// otherwise, or if asked for, by ncurses.
+    enum RendererChoice { ChooseRenderer, UseNCursesRenderer };
 
-    enum Color {
-        ColorDefault,
-        ColorRed,
-        ColorGreen,
-        ColorYellow,
-        ColorBlue,
-        ColorMagenta,
-        ColorCyan,
-        ColorWhite
-    };
+    explicit NCursesApplication(RendererChoice choice = ChooseRenderer);
+    ~NCursesApplication();
 
+    static IRenderer &renderer();
     static bool supportsColors();
-    static void useColor(WINDOW *window, Color color);
 
     static void runExternalCommand(const std::string &command);
 
     static void error(const std::string errorMessage);
     static void exit(int exitCode = EXIT_SUCCESS);
 
-    static void maybeChop(const WINDOW *window, int startPosition, std::string &text);
+    static void maybeChop(int columnCount, int startPosition, std::string &text);
 };
 
 } // namespace NCurses
@@ -0,0 +1,149 @@
+#include "ncursesrenderer.h"
+
+#include <algorithm>
+
+#include <ncurses.h>
+
+namespace TUI {
+namespace NCurses {
+
+namespace {
+
+int toCursesAttributes(int attributes)
+{
+    int cursesAttributes = 0;
+    if (attributes & IRenderer::Bold)
+        cursesAttributes |= A_BOLD;
+    if (attributes & IRenderer::Underline)
+        cursesAttributes |= A_UNDERLINE;
+    if (attributes & IRenderer::Reverse)
+        cursesAttributes |= A_REVERSE;
+    return cursesAttributes;
+}
+
+} // anonymous
+
+NCursesRenderer::NCursesRenderer()
+{
+    initscr();
+    start_color();
+    raw(); // Pass through all keys (interrupt, quit, suspend and flow control)
+    noecho();
+    keypad(stdscr, TRUE); // Enables us to catch arrow presses.
+    nodelay(stdscr, TRUE); // See readKey()
+    curs_set(0);
+
+    if (has_colors()) {
+        // Enable '-1' in the following lines for the default terminal color.
+        use_default_colors();
+
+        init_pair(ColorDefault, COLOR_BLACK, -1);
+        init_pair(ColorRed, COLOR_RED, -1);
+        init_pair(ColorGreen, COLOR_GREEN, -1);
+        init_pair(ColorYellow, COLOR_YELLOW, -1);
+        init_pair(ColorBlue, COLOR_BLUE, -1);
+        init_pair(ColorMagenta, COLOR_MAGENTA, -1);
+        init_pair(ColorCyan, COLOR_CYAN, -1);
+        init_pair(ColorWhite, COLOR_WHITE, -1);
+    }
+}
+
+NCursesRenderer::~NCursesRenderer()
+{
+    endwin();
+}
+
+int NCursesRenderer::lineCount()
+{
+    return getmaxy(stdscr);
+}
+
+int NCursesRenderer::columnCount()
+{
+    return getmaxx(stdscr);
+}
+
+bool NCursesRenderer::supportsColors()
+{
+    // The function can_change_color() returns false for
+    //   gnome-terminal 3.6.0
+    //   XTerm(278)
+    //   konsole 2.9.4
+    // Therefore we will have no colors on these terminal
+    // if we rely on that.
+    return has_colors() /*&& can_change_color()*/;
+}
+
+void NCursesRenderer::drawText(int line, int column, Utils::StringUtils::StringRef text,
+                               int attributes, Color color)
+{
+    // Text behind the right edge would wrap to the next line.
+    const int length = std::min<int>(text.size(), columnCount() - column);
+    if (length <= 0)
+        return;
+    setAttributes(attributes, color);
+    mvwaddnstr(stdscr, line, column, text.data(), length);
+    wattrset(stdscr, 0);
+}
+
+void NCursesRenderer::clearLine(int line, int column, int attributes)
+{
+    // With these extra spaces A_REVERSE will highlight the full line
+    setAttributes(attributes, ColorDefault);
+    mvwhline(stdscr, line, column, ' ', columnCount() - column);
+    wattrset(stdscr, 0);
+}
+
+void NCursesRenderer::drawHorizontalLine(int line, int column, int attributes)
+{
+    setAttributes(attributes, ColorDefault);
+    mvwhline(stdscr, line, column, ACS_HLINE, columnCount() - column);
+    wattrset(stdscr, 0);
+}
+
+void NCursesRenderer::addAttributes(int line, int column, int attributes)
+{
+    mvwaddch(stdscr, line, column, mvwinch(stdscr, line, column) | toCursesAttributes(attributes));
+}
+
+void NCursesRenderer::clear()
+{
+    // wclear() flickers with urxvt, but the screen might show anything.
+    wclear(stdscr);
+}
+
+void NCursesRenderer::update()
+{
+    wrefresh(stdscr);
+}
+
+/// ncurses decodes the escape sequences of the keys, and turns SIGWINCH into KEY_RESIZE.
+int NCursesRenderer::readKey()
+{
+    return wgetch(stdscr);
+}
+
+int NCursesRenderer::notificationDescriptor()
+{
+    return -1;
+}
+
+void NCursesRenderer::suspend()
+{
+    endwin();
+}
+
+void NCursesRenderer::resume()
+{
+    refresh();
+}
+
+void NCursesRenderer::setAttributes(int attributes, Color color)
+{
+    wattrset(stdscr, toCursesAttributes(attributes));
+    if (has_colors())
+        wcolor_set(stdscr, color, 0);
+}
+
+} // namespace NCurses
+} // namespace TUI
@@ -0,0 +1,43 @@
+#ifndef NCURSESRENDERER_H
+#define NCURSESRENDERER_H
+
+#include "irenderer.h"
+
+namespace TUI {
+namespace NCurses {
+
+/// Draws on the standard screen of ncurses, which finds out the capabilities
+/// of the terminal from terminfo. The fallback for terminals not known to
+/// understand the ANSI escape sequences of AnsiRenderer.
+class NCursesRenderer : public IRenderer
+{
+public:
+    NCursesRenderer();
+    ~NCursesRenderer();
+
+    int lineCount();
+    int columnCount();
+    bool supportsColors();
+
+    void drawText(int line, int column, Utils::StringUtils::StringRef text,
+                  int attributes = 0, Color color = ColorDefault);
+    void clearLine(int line, int column, int attributes = 0);
+    void drawHorizontalLine(int line, int column, int attributes = 0);
+    void addAttributes(int line, int column, int attributes);
+    void clear();
+    void update();
+
+    int readKey();
+    int notificationDescriptor();
+
+    void suspend();
+    void resume();
+
+private:
+    void setAttributes(int attributes, Color color);
+};
+
+} // namespace NCurses
+} // namespace TUI
+
+#endif // NCURSESRENDERER_H
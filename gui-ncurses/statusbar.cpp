@@ -3,18 +3,20 @@
 namespace TUI {
 namespace NCurses {
 
-StatusBar::StatusBar(int rows, int columns, int beginY, int beginX)
-    : m_textAttributes(0)
-    , m_window(newwin(rows, columns, beginY, beginX))
+StatusBar::StatusBar(IRenderer &renderer, int line)
+    : m_renderer(renderer)
+    , m_line(line)
+    , m_textAttributes(0)
+    , m_textColor(IRenderer::ColorDefault)
 {
 }
 
-StatusBar::~StatusBar()
+void StatusBar::setLine(int line)
 {
-    delwin(m_window);
+    m_line = line;
 }
 
-void StatusBar::setText(const std::string &text, int attributes, NCursesApplication::Color color)
+void StatusBar::setText(const std::string &text, int attributes, IRenderer::Color color)
 {
     m_text = text;
     m_textAttributes = attributes;
@@ -23,17 +25,9 @@ void StatusBar::setText(const std::string &text, int attributes, NCursesApplicat
 
 void StatusBar::update()
 {
-    wattrset(m_window, 0);
-    wattron(m_window, A_BOLD);
-    mvwhline(m_window, 0, 0, ACS_HLINE, 1000); // TODO: Is it OK to use NCURSES_ACS?
-
-    wattrset(m_window, 0);
-    NCursesApplication::useColor(m_window, m_textColor);
-    wattron(m_window, m_textAttributes);
-    mvwprintw(m_window, 0, 3, m_text.c_str());
-
-    wattrset(m_window, 0);
-    wrefresh(m_window);
+    m_renderer.drawHorizontalLine(m_line, 0, IRenderer::Bold);
+    m_renderer.drawText(m_line, 3, Utils::StringUtils::StringRef(m_text.data(), m_text.size()),
+                        m_textAttributes, m_textColor);
 }
 
 } // namespace NCurses
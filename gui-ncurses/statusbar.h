@@ -1,29 +1,31 @@
 #ifndef STATUSBAR_H
 #define STATUSBAR_H
 
-#include "ncursesapplication.h"
+#include "irenderer.h"
 
 #include <string>
 
-#include <ncurses.h>
-
 namespace TUI {
 namespace NCurses {
 
 class StatusBar
 {
 public:
-    StatusBar(int rows, int columns, int beginY, int beginX);
-    ~StatusBar();
+    StatusBar(IRenderer &renderer, int line);
+
+    /// Moves the bar, e.g. after the terminal was resized. Call update() then.
+    void setLine(int line);
 
-    void setText(const std::string &text, int attributes, NCursesApplication::Color color);
+    void setText(const std::string &text, int attributes, IRenderer::Color color);
+    /// Draws the bar, it shows up with the next IRenderer::update().
     void update();
 
 private:
+    IRenderer &m_renderer;
+    int m_line;
     std::string m_text;
     int m_textAttributes;
-    NCursesApplication::Color m_textColor;
-    WINDOW *m_window;
+    IRenderer::Color m_textColor;
 };
 
 } // namespace NCurses
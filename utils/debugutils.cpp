@@ -3,6 +3,12 @@
 namespace Utils {
 namespace DebugUtils {
 
+std::mutex &debugMutex()
+{
+    static std::mutex mutex;
+    return mutex;
+}
+
 DebugOutput debug()
 {
 #if DEBUG_OUTPUT
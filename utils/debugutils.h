@@ -2,6 +2,9 @@
 #define ASSERTDEBUG_H
 
 #include <fstream>
+#include <mutex>
+#include <sstream>
+#include <string>
 
 #define DEBUG_OUTPUT 1
 #define DEBUG_OUTPUT_FILEPATH "/tmp/goto_debug.log"
@@ -9,16 +12,24 @@
 namespace Utils {
 namespace DebugUtils {
 
+/// Serializes the output of several threads.
+std::mutex &debugMutex();
+
 /// Ncurses apps cannot just print to stdout/stderr, so print to a file
 class DebugOutput
 {
 #if DEBUG_OUTPUT
     std::ofstream *stream;
+    std::string line; // Written at once, so lines of several threads do not interleave
 #endif
 public:
 #if DEBUG_OUTPUT
     explicit DebugOutput(std::ofstream *stream = 0) : stream(stream) {}
-    ~DebugOutput() { *stream << std::endl << std::flush; }
+    ~DebugOutput()
+    {
+        std::lock_guard<std::mutex> locker(debugMutex());
+        *stream << line << std::endl << std::flush;
+    }
 #else
     explicit DebugOutput(std::ofstream * = 0) {}
 #endif
@@ -27,7 +38,9 @@ public:
 #define OUT_OPERATOR(type) \
     DebugOutput &operator<<(const type value) \
     { \
-        *stream << value << ' '; \
+        std::ostringstream out; \
+        out << value << ' '; \
+        line += out.str(); \
         return *this; \
     }
 #else
@@ -0,0 +1,299 @@
+#include "directorywalker.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace Utils {
+namespace FileUtils {
+
+namespace {
+
+/// Bytes read per getdents64()
+const std::size_t ReadSize = 64 * 1024;
+/// Entries found are handed out in batches of about this size, or more often
+/// if found slowly.
+const std::size_t PublishedEntryCount = 2048;
+const std::chrono::milliseconds PublishInterval(20);
+
+struct LinuxDirectoryEntry
+{
+    uint64_t inode;
+    int64_t offset;
+    unsigned short recordLength;
+    unsigned char type;
+    char name[1];
+};
+
+bool isVersionControlDirectory(const char *name, std::size_t nameLength)
+{
+    return (nameLength == 4 && (std::memcmp(name, ".git", 4) == 0 || std::memcmp(name, ".svn", 4) == 0))
+        || (nameLength == 3 && std::memcmp(name, ".hg", 3) == 0);
+}
+
+} // anonymous
+
+DirectoryWalker::DirectoryWalker(const std::string &root, unsigned maximumDepth,
+                                 uint32_t maximumEntryCount, unsigned threadCount)
+    throw(std::runtime_error)
+    : m_state(std::make_shared<State>(std::max(1u, threadCount)))
+{
+    State &state = *m_state;
+    state.maximumDepth = maximumDepth;
+    state.maximumEntryCount = maximumEntryCount;
+    state.pendingTaskCount = 0;
+    state.runningThreadCount = state.queues.size();
+    state.entryCount = 0;
+    state.isCanceled = false;
+    state.isTruncated = false;
+    state.isNotified = false;
+    state.isFinished = false;
+
+    std::string path = root;
+    while (path.size() > 1 && path[path.size() - 1] == '/')
+        path.resize(path.size() - 1);
+    addTask(state, 0, path, 0);
+
+    for (unsigned index = 0; index < state.queues.size(); ++index)
+        std::thread(&DirectoryWalker::work, m_state, index).detach();
+}
+
+DirectoryWalker::~DirectoryWalker()
+{
+    cancel();
+}
+
+int DirectoryWalker::notificationDescriptor() const
+{
+    return m_state->notifier.fileDescriptor();
+}
+
+std::vector<DirectoryWalker::Batch> DirectoryWalker::takeBatches()
+{
+    std::vector<Batch> batches;
+    std::lock_guard<std::mutex> locker(m_state->resultMutex);
+    m_state->notifier.clear();
+    m_state->isNotified = false;
+    batches.swap(m_state->batches);
+    return batches;
+}
+
+bool DirectoryWalker::isFinished() const
+{
+    std::lock_guard<std::mutex> locker(m_state->resultMutex);
+    return m_state->isFinished;
+}
+
+bool DirectoryWalker::isTruncated() const
+{
+    return m_state->isTruncated;
+}
+
+void DirectoryWalker::cancel()
+{
+    m_state->isCanceled = true;
+    m_state->taskAdded.notify_all();
+}
+
+/// Walking is mostly waiting for the file system on a cold cache, so use some
+/// threads even on few cores.
+unsigned DirectoryWalker::defaultThreadCount()
+{
+    return std::min(16u, std::max(4u, std::thread::hardware_concurrency()));
+}
+
+void DirectoryWalker::work(std::shared_ptr<State> state, unsigned index)
+{
+    std::vector<char> buffer(ReadSize);
+    Batch batch;
+    auto publishTime = std::chrono::steady_clock::now() + PublishInterval;
+
+    while (! state->isCanceled) {
+        Task task;
+        if (! takeTask(*state, index, task)) {
+            // Hand out what is found before idling.
+            publish(*state, batch, false);
+            if (state->pendingTaskCount == 0)
+                break;
+            std::unique_lock<std::mutex> locker(state->idleMutex);
+            state->taskAdded.wait_for(locker, std::chrono::milliseconds(10));
+            continue;
+        }
+
+        walkDirectory(*state, index, task, buffer, batch);
+        if (--state->pendingTaskCount == 0)
+            state->taskAdded.notify_all();
+
+        const auto now = std::chrono::steady_clock::now();
+        if (batch.entries.size() >= PublishedEntryCount || now >= publishTime) {
+            publish(*state, batch, false);
+            publishTime = now + PublishInterval;
+        }
+    }
+
+    // The last thread tells that the walk is finished, unless it was canceled.
+    const bool isComplete = ! state->isCanceled || state->isTruncated;
+    if (isComplete)
+        publish(*state, batch, false);
+    if (--state->runningThreadCount == 0 && isComplete)
+        publish(*state, batch, true);
+}
+
+/// Takes the newest task of the own queue, or else steals the oldest one of another queue.
+bool DirectoryWalker::takeTask(State &state, unsigned index, Task &task)
+{
+    {
+        TaskQueue &queue = state.queues[index];
+        std::lock_guard<std::mutex> locker(queue.mutex);
+        if (! queue.tasks.empty()) {
+            task = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+            return true;
+        }
+    }
+
+    const unsigned queueCount = state.queues.size();
+    for (unsigned i = 1; i < queueCount; ++i) {
+        TaskQueue &queue = state.queues[(index + i) % queueCount];
+        std::lock_guard<std::mutex> locker(queue.mutex);
+        if (! queue.tasks.empty()) {
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+void DirectoryWalker::addTask(State &state, unsigned index, const std::string &path, unsigned depth)
+{
+    // Counted before it can be taken, so the count cannot drop to zero meanwhile.
+    ++state.pendingTaskCount;
+    {
+        TaskQueue &queue = state.queues[index];
+        std::lock_guard<std::mutex> locker(queue.mutex);
+        Task task;
+        task.path = path;
+        task.depth = depth;
+        queue.tasks.push_back(std::move(task));
+    }
+    state.taskAdded.notify_one();
+}
+
+/// Returns false if the directory was visited already.
+bool DirectoryWalker::markVisited(State &state, uint64_t device, uint64_t inode)
+{
+    State::VisitedShard &shard = state.visited[inode % State::VisitedShardCount];
+    std::lock_guard<std::mutex> locker(shard.mutex);
+    return shard.directories.insert(DirectoryId(device, inode)).second;
+}
+
+void DirectoryWalker::walkDirectory(State &state, unsigned index, const Task &task,
+                                    std::vector<char> &buffer, Batch &batch)
+{
+    const int directoryDescriptor = open(task.path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (directoryDescriptor == -1)
+        return;
+    struct stat s;
+    if (fstat(directoryDescriptor, &s) == -1 || ! markVisited(state, s.st_dev, s.st_ino)) {
+        close(directoryDescriptor);
+        return;
+    }
+
+    const std::string directory = task.path == "/" ? std::string() : task.path;
+    const bool isWalkingSubdirectories = task.depth + 1 < state.maximumDepth;
+    long readSize;
+    while (! state.isCanceled
+           && (readSize = syscall(SYS_getdents64, directoryDescriptor, buffer.data(), buffer.size())) > 0) {
+        const std::size_t firstEntry = batch.entries.size();
+        for (long position = 0; position < readSize; ) {
+            const LinuxDirectoryEntry *entry
+                = reinterpret_cast<const LinuxDirectoryEntry *>(buffer.data() + position);
+            position += entry->recordLength;
+            const char *name = entry->name;
+            const std::size_t nameLength = std::strlen(name);
+            if (name[0] == '.' && (nameLength == 1 || (nameLength == 2 && name[1] == '.')))
+                continue;
+
+            uint8_t type = entry->type;
+            struct stat t;
+            if (type == DT_UNKNOWN && fstatat(directoryDescriptor, name, &t, AT_SYMLINK_NOFOLLOW) == 0)
+                type = IFTODT(t.st_mode);
+            if (type == DT_LNK && fstatat(directoryDescriptor, name, &t, 0) == 0 && S_ISDIR(t.st_mode))
+                type = DT_DIR;
+
+            appendEntry(batch, directory, name, nameLength, type);
+            if (type == DT_DIR && isWalkingSubdirectories && ! isVersionControlDirectory(name, nameLength)) {
+                const Entry &added = batch.entries.back();
+                addTask(state, index, batch.paths.substr(added.pathOffset, added.pathLength),
+                        task.depth + 1);
+            }
+        }
+
+        // Counted per read, the shared counter is contended otherwise.
+        const uint32_t addedCount = batch.entries.size() - firstEntry;
+        const uint32_t previousCount = state.entryCount.fetch_add(addedCount);
+        if (previousCount + addedCount >= state.maximumEntryCount) {
+            const uint32_t keptCount = previousCount < state.maximumEntryCount
+                ? state.maximumEntryCount - previousCount : 0;
+            batch.entries.resize(firstEntry + keptCount);
+            state.isTruncated = true;
+            state.isCanceled = true;
+            state.taskAdded.notify_all();
+        }
+
+        // Huge directories are handed out while reading them.
+        if (batch.entries.size() >= PublishedEntryCount)
+            publish(state, batch, false);
+    }
+    close(directoryDescriptor);
+}
+
+void DirectoryWalker::publish(State &state, Batch &batch, bool isFinished)
+{
+    if (batch.entries.empty() && ! isFinished)
+        return;
+
+    bool isNotifying;
+    {
+        std::lock_guard<std::mutex> locker(state.resultMutex);
+        if (! batch.entries.empty()) {
+            state.batches.push_back(Batch());
+            state.batches.back().paths.swap(batch.paths);
+            state.batches.back().entries.swap(batch.entries);
+        }
+        if (isFinished)
+            state.isFinished = true;
+        // One notification until taken, writing to it is a system call.
+        isNotifying = ! state.isNotified;
+        state.isNotified = true;
+    }
+    if (isNotifying)
+        state.notifier.notify();
+    batch.paths.clear();
+    batch.entries.clear();
+}
+
+void DirectoryWalker::appendEntry(Batch &batch, const std::string &directory, const char *name,
+                                  std::size_t nameLength, uint8_t type)
+{
+    Entry entry;
+    entry.pathOffset = batch.paths.size();
+    entry.pathLength = directory.size() + 1 + nameLength;
+    entry.nameLength = nameLength;
+    entry.type = type;
+    batch.paths.append(directory);
+    batch.paths.push_back('/');
+    batch.paths.append(name, nameLength);
+    batch.entries.push_back(entry);
+}
+
+} // namespace FileUtils
+} // namespace Utils
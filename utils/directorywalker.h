@@ -0,0 +1,145 @@
+#ifndef DIRECTORYWALKER_H
+#define DIRECTORYWALKER_H
+
+#include "notifier.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace Utils {
+namespace FileUtils {
+
+/// Walks a directory tree recursively in threads of its own and hands out the
+/// entries found so far, e.g. to list them while still walking.
+///
+/// Each directory is a task. A thread pushes the subdirectories it finds to a
+/// queue of its own and takes the next task from there, depth first. Idle
+/// threads steal the oldest tasks of the others, which are the biggest subtrees
+/// usually. So all threads keep busy without contending for one queue.
+///
+/// Symbolic links to directories are followed, but no directory is walked twice
+/// (identified by device and inode), so links cannot form loops. Metadata
+/// directories of version control systems are listed, but not walked.
+///
+/// Like the FileProber, the threads are detached, so destroying the walker
+/// cancels it without waiting for a thread stuck in a hung mount.
+class DirectoryWalker
+{
+public:
+    struct Entry
+    {
+        uint32_t pathOffset; ///< Into Batch::paths
+        uint32_t pathLength;
+        uint32_t nameLength; ///< The name ends the path
+        uint8_t type;        ///< DT_*, DT_DIR also for links to directories
+    };
+
+    struct Batch
+    {
+        std::string paths;
+        std::vector<Entry> entries;
+    };
+
+    /// Starts walking root right away. Subdirectories deeper than maximumDepth
+    /// are not walked, and the walk stops once maximumEntryCount entries are found.
+    DirectoryWalker(const std::string &root, unsigned maximumDepth, uint32_t maximumEntryCount,
+                    unsigned threadCount = defaultThreadCount()) throw(std::runtime_error);
+    ~DirectoryWalker();
+
+    /// Readable once entries are available or the walk is finished, see takeBatches().
+    int notificationDescriptor() const;
+
+    /// Returns the entries found since the last call and clears the notification.
+    std::vector<Batch> takeBatches();
+    /// All directories are walked, or the walk stopped at maximumEntryCount.
+    bool isFinished() const;
+    /// Stopped at maximumEntryCount.
+    bool isTruncated() const;
+    void cancel();
+
+    static unsigned defaultThreadCount();
+
+private:
+    DirectoryWalker(const DirectoryWalker &) = delete;
+    DirectoryWalker &operator=(const DirectoryWalker &) = delete;
+
+    struct Task
+    {
+        std::string path;
+        unsigned depth;
+    };
+
+    using DirectoryId = std::pair<uint64_t, uint64_t>; // Device and inode
+
+    struct DirectoryIdHash
+    {
+        std::size_t operator()(const DirectoryId &id) const
+        { return std::hash<uint64_t>()(id.first * 0x9e3779b97f4a7c15ull ^ id.second); }
+    };
+
+    struct TaskQueue
+    {
+        std::mutex mutex;
+        std::deque<Task> tasks; // Guarded by mutex
+    };
+
+    /// Shared with the threads, which might outlive the walker.
+    struct State
+    {
+        explicit State(unsigned threadCount) : queues(threadCount) {}
+
+        unsigned maximumDepth;
+        uint32_t maximumEntryCount;
+        std::vector<TaskQueue> queues; // One per thread
+        std::atomic<int> pendingTaskCount; // Queued or running
+        std::atomic<unsigned> runningThreadCount;
+        std::atomic<uint32_t> entryCount;
+        std::atomic<bool> isCanceled;
+        std::atomic<bool> isTruncated;
+
+        std::mutex idleMutex;
+        std::condition_variable taskAdded;
+
+        static const unsigned VisitedShardCount = 16;
+        struct VisitedShard
+        {
+            std::mutex mutex;
+            std::unordered_set<DirectoryId, DirectoryIdHash> directories; // Guarded by mutex
+        };
+        VisitedShard visited[VisitedShardCount];
+
+        Notifier notifier;
+        std::mutex resultMutex;
+        std::vector<Batch> batches; // Guarded by resultMutex
+        bool isNotified;            // Guarded by resultMutex
+        bool isFinished;            // Guarded by resultMutex
+    };
+
+    static void work(std::shared_ptr<State> state, unsigned index);
+    static bool takeTask(State &state, unsigned index, Task &task);
+    static void addTask(State &state, unsigned index, const std::string &path, unsigned depth);
+    static bool markVisited(State &state, uint64_t device, uint64_t inode);
+    static void walkDirectory(State &state, unsigned index, const Task &task,
+                              std::vector<char> &buffer, Batch &batch);
+    static void publish(State &state, Batch &batch, bool isFinished);
+    static void appendEntry(Batch &batch, const std::string &directory, const char *name,
+                            std::size_t nameLength, uint8_t type);
+
+    std::shared_ptr<State> m_state;
+};
+
+} // namespace FileUtils
+} // namespace Utils
+
+#endif // DIRECTORYWALKER_H
@@ -0,0 +1,104 @@
+#include "fileinfocache.h"
+
+#include <algorithm>
+
+namespace Utils {
+namespace FileUtils {
+
+namespace {
+const int NetworkTimeToLiveFactor = 15;
+} // anonymous
+
+FileInfoCache::FileInfoCache(std::chrono::milliseconds timeToLive,
+                             std::chrono::milliseconds probeTimeout)
+    : m_timeToLive(timeToLive)
+    , m_probeTimeout(probeTimeout)
+    , m_generation(0)
+    , m_probingCount(0)
+{
+}
+
+FileInfoCache &FileInfoCache::globalInstance()
+{
+    static FileInfoCache fileInfoCache;
+    return fileInfoCache;
+}
+
+FileInfo FileInfoCache::fileInfo(const std::string &filePath)
+{
+    const Clock::time_point now = Clock::now();
+    auto it = m_entries.find(filePath);
+    if (it == m_entries.end()) {
+        // Only the paths of the recently shown items matter, so simply start
+        // over. Pending results are still taken over.
+        if (m_entries.size() == MaximumEntryCount) {
+            m_entries.clear();
+            m_probingCount = 0;
+        }
+        it = m_entries.insert(std::make_pair(filePath, Entry())).first;
+    }
+
+    Entry &entry = it->second;
+    if (entry.isProbing) {
+        if (! entry.info.isProbed && now - entry.time >= m_probeTimeout)
+            entry.info.isTimedOut = true;
+    } else if (! isUpToDate(entry, now)) {
+        m_prober.probe(filePath);
+        entry.isProbing = true;
+        entry.time = now;
+        ++m_probingCount;
+    }
+    return entry.info;
+}
+
+bool FileInfoCache::takeResults()
+{
+    const std::vector<FileProber::Result> results = m_prober.takeResults();
+    const Clock::time_point now = Clock::now();
+    for (const FileProber::Result &result : results) {
+        Entry &entry = m_entries[result.filePath];
+        if (entry.isProbing)
+            --m_probingCount;
+        entry.info = result.info;
+        entry.generation = m_generation;
+        entry.time = now;
+        entry.isProbing = false;
+    }
+    return ! results.empty();
+}
+
+int FileInfoCache::timeUntilNextTimeout() const
+{
+    if (m_probingCount == 0)
+        return -1;
+
+    const Clock::time_point now = Clock::now();
+    Clock::duration next = Clock::duration::max();
+    for (const auto &pathAndEntry : m_entries) {
+        const Entry &entry = pathAndEntry.second;
+        if (! entry.isProbing || entry.info.isProbed)
+            continue;
+        const Clock::duration remaining = entry.time + m_probeTimeout - now;
+        if (remaining > Clock::duration::zero())
+            next = std::min(next, remaining);
+    }
+    if (next == Clock::duration::max())
+        return -1;
+    // Round up, so the timeout is over once waited for. Entries are marked as
+    // timed out on their next lookup.
+    const auto milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(
+        next + std::chrono::milliseconds(1) - Clock::duration(1));
+    return milliseconds.count();
+}
+
+bool FileInfoCache::isUpToDate(const Entry &entry, Clock::time_point now) const
+{
+    if (! entry.info.isProbed || entry.generation != m_generation)
+        return false;
+    const Clock::duration timeToLive = entry.info.isOnNetworkFileSystem
+        ? m_timeToLive * NetworkTimeToLiveFactor : m_timeToLive;
+    return now - entry.time < timeToLive;
+}
+
+} // namespace FileUtils
+} // namespace Utils
@@ -0,0 +1,80 @@
+#ifndef FILEINFOCACHE_H
+#define FILEINFOCACHE_H
+
+#include "fileprober.h"
+#include "fileutils.h"
+
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include <unordered_map>
+
+namespace Utils {
+namespace FileUtils {
+
+/// Remembers the FileInfo of paths, so redrawing the menu, firing an item and
+/// handling it do not stat() the same paths over and over.
+///
+/// An entry is valid until invalidate() starts a new generation, e.g. after
+/// running an external command, or until it is older than the time to live,
+/// which picks up changes made from elsewhere. Paths on network file systems
+/// live longer, probing them is slow.
+///
+/// fileInfo() never blocks: Unknown and outdated paths are probed in the
+/// background, see FileProber. Until the result is taken over with
+/// takeResults(), the outdated FileInfo or one that is not probed is returned.
+/// Use from one thread only.
+class FileInfoCache
+{
+public:
+    explicit FileInfoCache(std::chrono::milliseconds timeToLive = std::chrono::milliseconds(2000),
+                           std::chrono::milliseconds probeTimeout = std::chrono::milliseconds(1000));
+
+    /// Shared by the whole application.
+    static FileInfoCache &globalInstance();
+
+    FileInfo fileInfo(const std::string &filePath);
+
+    void invalidate() { ++m_generation; }
+    unsigned generation() const { return m_generation; }
+
+    /// Readable once probes are done, then call takeResults().
+    int notificationDescriptor() const { return m_prober.notificationDescriptor(); }
+    /// Returns false if nothing changed.
+    bool takeResults();
+    /// Milliseconds until the next pending probe times out, -1 if none will.
+    /// Once it did, fileInfo() returns a FileInfo that isTimedOut.
+    int timeUntilNextTimeout() const;
+
+private:
+    FileInfoCache(const FileInfoCache &) = delete;
+    FileInfoCache &operator=(const FileInfoCache &) = delete;
+
+    using Clock = std::chrono::steady_clock;
+
+    struct Entry
+    {
+        Entry() : generation(0), isProbing(false) {}
+
+        FileInfo info;
+        unsigned generation;
+        Clock::time_point time; ///< Of the result, or of the start of probing
+        bool isProbing;
+    };
+
+    bool isUpToDate(const Entry &entry, Clock::time_point now) const;
+
+    static const std::size_t MaximumEntryCount = 4096;
+
+    FileProber m_prober;
+    std::unordered_map<std::string, Entry> m_entries;
+    Clock::duration m_timeToLive;
+    Clock::duration m_probeTimeout;
+    unsigned m_generation;
+    unsigned m_probingCount;
+};
+
+} // namespace FileUtils
+} // namespace Utils
+
+#endif // FILEINFOCACHE_H
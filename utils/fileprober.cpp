@@ -0,0 +1,86 @@
+#include "fileprober.h"
+
+#include <thread>
+
+namespace Utils {
+namespace FileUtils {
+
+FileProber::FileProber(unsigned threadCount) throw(std::runtime_error)
+    : m_state(std::make_shared<State>())
+    , m_threadCount(threadCount)
+    , m_startedThreadCount(0)
+{
+    m_state->isStopping = false;
+}
+
+FileProber::~FileProber()
+{
+    {
+        std::lock_guard<std::mutex> locker(m_state->mutex);
+        m_state->isStopping = true;
+        m_state->filePaths.clear();
+    }
+    m_state->probeAdded.notify_all();
+}
+
+int FileProber::notificationDescriptor() const
+{
+    return m_state->notifier.fileDescriptor();
+}
+
+void FileProber::probe(const std::string &filePath)
+{
+    // Start the threads on demand, most probes are answered right away.
+    std::unique_lock<std::mutex> locker(m_state->mutex);
+    const bool needsThread = m_startedThreadCount < m_threadCount
+        && m_state->filePaths.size() >= m_startedThreadCount;
+    m_state->filePaths.push_back(filePath);
+    locker.unlock();
+
+    if (needsThread) {
+        std::thread(&FileProber::work, m_state).detach();
+        ++m_startedThreadCount;
+    }
+    m_state->probeAdded.notify_one();
+}
+
+std::vector<FileProber::Result> FileProber::takeResults()
+{
+    m_state->notifier.clear();
+    std::vector<Result> results;
+    std::lock_guard<std::mutex> locker(m_state->mutex);
+    results.swap(m_state->results);
+    return results;
+}
+
+void FileProber::work(std::shared_ptr<State> state)
+{
+    for (;;) {
+        Result result;
+        {
+            std::unique_lock<std::mutex> locker(state->mutex);
+            state->probeAdded.wait(locker, [&state]() {
+                return state->isStopping || ! state->filePaths.empty();
+            });
+            if (state->isStopping)
+                return;
+            result.filePath = state->filePaths.front();
+            state->filePaths.pop_front();
+        }
+
+        result.info = FileInfo(result.filePath);
+        if (result.info.exists)
+            result.info.isOnNetworkFileSystem = isOnNetworkFileSystem(result.filePath);
+
+        {
+            std::lock_guard<std::mutex> locker(state->mutex);
+            if (state->isStopping)
+                return;
+            state->results.push_back(result);
+        }
+        state->notifier.notify();
+    }
+}
+
+} // namespace FileUtils
+} // namespace Utils
@@ -0,0 +1,66 @@
+#ifndef FILEPROBER_H
+#define FILEPROBER_H
+
+#include "fileutils.h"
+#include "notifier.h"
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace Utils {
+namespace FileUtils {
+
+/// Gets the FileInfo of paths in threads of its own, so a slow or hung network
+/// mount cannot freeze the calling thread. A probe hung in stat() cannot be
+/// interrupted, it keeps its thread. So the threads are detached and never
+/// waited for, not even on destruction.
+class FileProber
+{
+public:
+    struct Result
+    {
+        std::string filePath;
+        FileInfo info;
+    };
+
+    explicit FileProber(unsigned threadCount = 4) throw(std::runtime_error);
+    ~FileProber();
+
+    /// Readable once results are available, see takeResults().
+    int notificationDescriptor() const;
+
+    void probe(const std::string &filePath);
+    /// Returns the results so far and clears the notification.
+    std::vector<Result> takeResults();
+
+private:
+    FileProber(const FileProber &) = delete;
+    FileProber &operator=(const FileProber &) = delete;
+
+    /// Shared with the threads, which might outlive the prober.
+    struct State
+    {
+        Notifier notifier;
+        std::mutex mutex;
+        std::condition_variable probeAdded;
+        std::deque<std::string> filePaths; // Guarded by mutex
+        std::vector<Result> results;       // Guarded by mutex
+        bool isStopping;                   // Guarded by mutex
+    };
+
+    static void work(std::shared_ptr<State> state);
+
+    std::shared_ptr<State> m_state;
+    unsigned m_threadCount;
+    unsigned m_startedThreadCount;
+};
+
+} // namespace FileUtils
+} // namespace Utils
+
+#endif // FILEPROBER_H
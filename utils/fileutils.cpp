@@ -1,6 +1,16 @@
 #include "fileutils.h"
 
+#include <algorithm>
+#include <cerrno>
+#include <cstdio> // rename()
+#include <cstdlib> // mkstemp()
 #include <fstream>
+#include <iterator>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/vfs.h>
 
 namespace Utils {
 namespace FileUtils {
@@ -15,16 +25,95 @@ void writeFile(const std::string filePath, const std::string fileContents) throw
         throw std::runtime_error("Failed to write file  \"" + filePath + "\"");
 }
 
+void writeFileAtomically(const std::string filePath, const std::string fileContents)
+    throw(std::runtime_error)
+{
+    // A file of its own per call, as several threads might replace the same file.
+    std::string temporaryFilePath = filePath + ".XXXXXX";
+    const int fd = mkstemp(&temporaryFilePath[0]);
+    if (fd == -1)
+        throw std::runtime_error("Could not open file \"" + temporaryFilePath + "\" for writing");
+    fchmod(fd, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH); // As created by writeFile() with the usual umask
+
+    std::size_t written = 0;
+    while (written < fileContents.size()) {
+        const ssize_t count = write(fd, fileContents.data() + written, fileContents.size() - written);
+        if (count == -1 && errno != EINTR)
+            break;
+        if (count > 0)
+            written += count;
+    }
+    if (close(fd) == -1 || written != fileContents.size()) {
+        unlink(temporaryFilePath.c_str());
+        throw std::runtime_error("Failed to write file \"" + temporaryFilePath + "\"");
+    }
+    if (rename(temporaryFilePath.c_str(), filePath.c_str()) == -1) {
+        unlink(temporaryFilePath.c_str());
+        throw std::runtime_error("Failed to replace file \"" + filePath + "\"");
+    }
+}
+
+FileStamp::FileStamp(const struct stat &s)
+    : device(s.st_dev)
+    , inode(s.st_ino)
+    , size(s.st_size)
+    , modificationSeconds(s.st_mtim.tv_sec)
+    , modificationNanoseconds(s.st_mtim.tv_nsec)
+{
+}
+
+bool operator==(const FileStamp &lhs, const FileStamp &rhs)
+{
+    return lhs.device == rhs.device
+        && lhs.inode == rhs.inode
+        && lhs.size == rhs.size
+        && lhs.modificationSeconds == rhs.modificationSeconds
+        && lhs.modificationNanoseconds == rhs.modificationNanoseconds;
+}
+
+bool operator!=(const FileStamp &lhs, const FileStamp &rhs)
+{
+    return !(lhs == rhs);
+}
+
+bool fileStamp(const std::string &filePath, FileStamp &stamp)
+{
+    struct stat s;
+    if (stat(filePath.c_str(), &s) == -1)
+        return false;
+    stamp = FileStamp(s);
+    return true;
+}
+
+bool appendPathDisplayed(std::string &out, StringUtils::StringRef path, const std::string &homePath)
+{
+    const std::size_t homePathLength = homePath.size();
+    if (path.size() >= homePathLength
+            && ! homePath.compare(0, homePathLength, path.data(), homePathLength)) {
+        out.push_back('~');
+        out.append(path.begin() + homePathLength, path.end());
+        return true;
+    }
+    out.append(path.begin(), path.end());
+    return false;
+}
+
+FileInfo::FileInfo()
+    : isProbed(false), isTimedOut(false), isOnNetworkFileSystem(false)
+    , exists(false), isRegularFile(false), isDirectory(false), isExecutable(false)
+    , error(0)
+{
+}
+
 FileInfo::FileInfo(const std::string &filePath)
-    : exists(false), isRegularFile(false), isDirectory(false), isExecutable(false)
+    : isProbed(true), isTimedOut(false), isOnNetworkFileSystem(false)
+    , exists(false), isRegularFile(false), isDirectory(false), isExecutable(false)
+    , error(0)
 {
     struct stat s;
     const int err = stat(filePath.c_str(), &s);
     if (err == -1) {
-        if (ENOENT != errno) {
-            perror("stat");
-            exit(1);
-        }
+        error = errno;
     } else {
         exists = true;
         if (s.st_mode & S_IXUSR) // TODO: This is not enough if we are not the owner.
@@ -36,6 +125,93 @@ FileInfo::FileInfo(const std::string &filePath)
     }
 }
 
+bool isOnNetworkFileSystem(const std::string &filePath)
+{
+    // Magic numbers from linux/magic.h and the file system sources
+    static const unsigned long networkFileSystemTypes[] = {
+        0x6969,     // NFS
+        0x517B,     // SMB
+        0xFE534D42, // SMB2
+        0xFF534D42, // CIFS
+        0x564C,     // NCP
+        0x5346414F, // AFS
+        0x6B414653, // kAFS
+        0x00C36400, // Ceph
+        0x01021997, // 9P
+        0x65735546, // FUSE, e.g. sshfs
+        0x47504653, // GPFS
+        0x0BD00BD0, // Lustre
+    };
+
+    struct statfs s;
+    if (statfs(filePath.c_str(), &s) == -1)
+        return false;
+    const unsigned long type = static_cast<unsigned long>(s.f_type) & 0xFFFFFFFF;
+    return std::find(std::begin(networkFileSystemTypes), std::end(networkFileSystemTypes), type)
+        != std::end(networkFileSystemTypes);
+}
+
+MappedFile::MappedFile(const std::string &filePath) throw(std::runtime_error)
+    : m_data(0), m_size(0)
+{
+    const int fd = open(filePath.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+        throw std::runtime_error("Could not open file \"" + filePath + "\"");
+
+    struct stat s;
+    if (fstat(fd, &s) == -1) {
+        close(fd);
+        throw std::runtime_error("Could not stat file \"" + filePath + "\"");
+    }
+    m_stamp = FileStamp(s);
+
+    // mmap() refuses zero length mappings, an empty file is just empty data.
+    if (s.st_size > 0) {
+        void *data = mmap(0, s.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            close(fd);
+            throw std::runtime_error("Could not map file \"" + filePath + "\"");
+        }
+        madvise(data, s.st_size, MADV_SEQUENTIAL);
+        m_data = static_cast<const char *>(data);
+        m_size = s.st_size;
+    }
+    close(fd); // The mapping stays valid.
+}
+
+MappedFile::MappedFile(MappedFile &&other)
+    : m_data(other.m_data), m_size(other.m_size), m_stamp(other.m_stamp)
+{
+    other.m_data = 0;
+    other.m_size = 0;
+}
+
+MappedFile &MappedFile::operator=(MappedFile &&other)
+{
+    if (this != &other) {
+        unmap();
+        m_data = other.m_data;
+        m_size = other.m_size;
+        m_stamp = other.m_stamp;
+        other.m_data = 0;
+        other.m_size = 0;
+    }
+    return *this;
+}
+
+MappedFile::~MappedFile()
+{
+    unmap();
+}
+
+void MappedFile::unmap()
+{
+    if (m_data)
+        munmap(const_cast<char *>(m_data), m_size);
+    m_data = 0;
+    m_size = 0;
+}
+
 } // namespace FileUtils
 } // namespace Utils
 
@@ -2,9 +2,13 @@
 #define FILEUTILS_H
 
 #include <algorithm> // find_if
+#include <cstddef>
+#include <cstdint>
 #include <stdexcept>
 #include <string>
 
+#include "stringutils.h"
+
 // For stat():
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -15,16 +19,80 @@ namespace FileUtils {
 
 void writeFile(const std::string filePath, const std::string fileContents) throw(std::runtime_error);
 
+/// Write to a temporary file next to filePath and rename it, so readers
+/// either see the old or the new contents, but never a partial file.
+void writeFileAtomically(const std::string filePath, const std::string fileContents)
+    throw(std::runtime_error);
+
+/// Identifies a version of a file, e.g. to validate caches derived from it.
+struct FileStamp
+{
+    FileStamp()
+        : device(0), inode(0), size(0), modificationSeconds(0), modificationNanoseconds(0) {}
+    explicit FileStamp(const struct stat &s);
+
+    uint64_t device;
+    uint64_t inode;
+    uint64_t size;
+    int64_t modificationSeconds;
+    int64_t modificationNanoseconds;
+};
+
+bool operator==(const FileStamp &lhs, const FileStamp &rhs);
+bool operator!=(const FileStamp &lhs, const FileStamp &rhs);
+
+/// Returns false if the file cannot be stat'ed.
+bool fileStamp(const std::string &filePath, FileStamp &stamp);
+
+/// Append path with the home directory abbreviated by '~'.
+/// Returns false if there was nothing to abbreviate.
+bool appendPathDisplayed(std::string &out, StringUtils::StringRef path, const std::string &homePath);
+
 // TODO: Make this portable.
 class FileInfo
 {
 public:
+    /// Not probed yet
+    FileInfo();
+    /// Blocks as long as stat() does, see FileProber for the UI.
     FileInfo(const std::string &filePath);
 
+    bool isProbed : 1;
+    bool isTimedOut : 1;      ///< Not probed, the file system did not answer in time.
+    bool isOnNetworkFileSystem : 1; ///< Only set by FileProber
     bool exists : 1;
     bool isRegularFile : 1;
     bool isDirectory : 1;
     bool isExecutable : 1;
+    int error;                ///< errno of a failed stat(), e.g. ENOENT or EACCES
+};
+
+/// Whether filePath is on e.g. NFS, SMB or a FUSE file system like sshfs, as
+/// opposed to a local disk. Blocks as long as statfs() does.
+bool isOnNetworkFileSystem(const std::string &filePath);
+
+/// Read-only, private memory mapping of a whole file.
+class MappedFile
+{
+public:
+    MappedFile() : m_data(0), m_size(0) {}
+    explicit MappedFile(const std::string &filePath) throw(std::runtime_error);
+    MappedFile(MappedFile &&other);
+    MappedFile &operator=(MappedFile &&other);
+    ~MappedFile();
+
+    const char *data() const { return m_data; }
+    std::size_t size() const { return m_size; }
+    const FileStamp &stamp() const { return m_stamp; }
+
+private:
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    void unmap();
+
+    const char *m_data;
+    std::size_t m_size;
+    FileStamp m_stamp;
 };
 
 } // namespace FileUtils
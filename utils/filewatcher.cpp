@@ -0,0 +1,54 @@
+#include "filewatcher.h"
+
+#include <cerrno>
+#include <cstring>
+
+#include <sys/inotify.h>
+#include <unistd.h>
+
+namespace Utils {
+
+FileWatcher::FileWatcher(const std::string &filePath) throw(std::runtime_error)
+    : m_fileDescriptor(inotify_init1(IN_NONBLOCK | IN_CLOEXEC))
+{
+    if (m_fileDescriptor == -1)
+        throw std::runtime_error("Could not initialize inotify");
+
+    const std::string::size_type slash = filePath.rfind('/');
+    const std::string directoryPath = slash == std::string::npos ? "." : filePath.substr(0, slash + 1);
+    m_fileName = slash == std::string::npos ? filePath : filePath.substr(slash + 1);
+
+    const uint32_t mask = IN_MODIFY | IN_CLOSE_WRITE | IN_CREATE | IN_DELETE
+        | IN_MOVED_FROM | IN_MOVED_TO;
+    if (inotify_add_watch(m_fileDescriptor, directoryPath.c_str(), mask) == -1) {
+        close(m_fileDescriptor);
+        throw std::runtime_error("Could not watch directory \"" + directoryPath + "\"");
+    }
+}
+
+FileWatcher::~FileWatcher()
+{
+    close(m_fileDescriptor);
+}
+
+bool FileWatcher::readEvents()
+{
+    bool isFileConcerned = false;
+    alignas(struct inotify_event) char buffer[4096];
+    for (;;) {
+        const ssize_t size = read(m_fileDescriptor, buffer, sizeof(buffer));
+        if (size == -1 && errno == EINTR)
+            continue;
+        if (size <= 0)
+            return isFileConcerned; // EAGAIN, all events are read.
+
+        for (const char *position = buffer; position < buffer + size; ) {
+            const struct inotify_event *event = reinterpret_cast<const struct inotify_event *>(position);
+            if (event->len && m_fileName == event->name)
+                isFileConcerned = true;
+            position += sizeof(struct inotify_event) + event->len;
+        }
+    }
+}
+
+} // namespace Utils
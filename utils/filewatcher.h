@@ -0,0 +1,34 @@
+#ifndef FILEWATCHER_H
+#define FILEWATCHER_H
+
+#include <stdexcept>
+#include <string>
+
+namespace Utils {
+
+/// Watches a file with inotify. The parent directory is watched, so replacing
+/// the file (as editors do on save) is noticed, too.
+class FileWatcher
+{
+public:
+    explicit FileWatcher(const std::string &filePath) throw(std::runtime_error);
+    ~FileWatcher();
+
+    /// Becomes readable on events, see readEvents().
+    int fileDescriptor() const { return m_fileDescriptor; }
+
+    /// Reads all pending events without blocking. Returns true if any of them
+    /// concerned the watched file.
+    bool readEvents();
+
+private:
+    FileWatcher(const FileWatcher &) = delete;
+    FileWatcher &operator=(const FileWatcher &) = delete;
+
+    int m_fileDescriptor;
+    std::string m_fileName;
+};
+
+} // namespace Utils
+
+#endif // FILEWATCHER_H
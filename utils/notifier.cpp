@@ -0,0 +1,36 @@
+#include "notifier.h"
+
+#include <cstdint>
+
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+namespace Utils {
+
+Notifier::Notifier() throw(std::runtime_error)
+    : m_fileDescriptor(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC))
+{
+    if (m_fileDescriptor == -1)
+        throw std::runtime_error("Could not create eventfd");
+}
+
+Notifier::~Notifier()
+{
+    close(m_fileDescriptor);
+}
+
+void Notifier::notify()
+{
+    const uint64_t one = 1;
+    const ssize_t written = write(m_fileDescriptor, &one, sizeof(one));
+    (void) written; // Can only fail if the counter overflows, then it's readable anyway.
+}
+
+void Notifier::clear()
+{
+    uint64_t counter;
+    const ssize_t bytesRead = read(m_fileDescriptor, &counter, sizeof(counter));
+    (void) bytesRead; // EAGAIN if there was nothing to clear.
+}
+
+} // namespace Utils
@@ -0,0 +1,32 @@
+#ifndef NOTIFIER_H
+#define NOTIFIER_H
+
+#include <stdexcept>
+
+namespace Utils {
+
+/// Wakes up a poll()ing thread, e.g. to tell the UI thread that a background
+/// job has a result. Notifications do not queue up, any number of notify()
+/// calls is cleared by one clear().
+class Notifier
+{
+public:
+    Notifier() throw(std::runtime_error);
+    ~Notifier();
+
+    /// Becomes readable after notify()
+    int fileDescriptor() const { return m_fileDescriptor; }
+
+    void notify();
+    void clear();
+
+private:
+    Notifier(const Notifier &) = delete;
+    Notifier &operator=(const Notifier &) = delete;
+
+    int m_fileDescriptor;
+};
+
+} // namespace Utils
+
+#endif // NOTIFIER_H
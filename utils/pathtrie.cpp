@@ -0,0 +1,83 @@
+#include "pathtrie.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace Utils {
+
+namespace {
+
+/// Returns the next component at or after position, advancing position behind it.
+StringUtils::StringRef nextComponent(StringUtils::StringRef path, std::size_t &position)
+{
+    while (position < path.size() && path.data()[position] == '/')
+        ++position;
+    const char *begin = path.data() + position;
+    const char *slash = static_cast<const char *>(std::memchr(begin, '/', path.size() - position));
+    const std::size_t length = slash ? slash - begin : path.size() - position;
+    position += length;
+    return StringUtils::StringRef(begin, length);
+}
+
+} // anonymous
+
+PathTrie::PathTrie()
+    : m_nodes(1)
+{
+}
+
+void PathTrie::insert(StringUtils::StringRef path, uint32_t value)
+{
+    uint32_t node = 0;
+    std::size_t position = 0;
+    for (;;) {
+        const StringUtils::StringRef component = nextComponent(path, position);
+        if (component.empty())
+            break;
+        const std::string key(component.data(), component.size());
+        const auto it = m_nodes[node].children.find(key);
+        if (it != m_nodes[node].children.end()) {
+            node = it->second;
+        } else {
+            const uint32_t child = m_nodes.size();
+            m_nodes[node].children[key] = child;
+            m_nodes.emplace_back(); // Invalidates references into m_nodes
+            node = child;
+        }
+    }
+    m_nodes[node].values.push_back(value);
+}
+
+void PathTrie::clear()
+{
+    m_nodes.assign(1, Node());
+}
+
+void PathTrie::find(StringUtils::StringRef path, std::vector<Match> &matches) const
+{
+    const std::size_t firstMatch = matches.size();
+    uint32_t node = 0;
+    unsigned depth = 0;
+    std::size_t position = 0;
+    std::string key;
+    for (;;) {
+        for (const uint32_t value : m_nodes[node].values) {
+            Match match;
+            match.value = value;
+            match.depth = depth;
+            matches.push_back(match);
+        }
+        const StringUtils::StringRef component = nextComponent(path, position);
+        if (component.empty())
+            break;
+        key.assign(component.data(), component.size());
+        const auto it = m_nodes[node].children.find(key);
+        if (it == m_nodes[node].children.end())
+            break;
+        node = it->second;
+        ++depth;
+    }
+    std::reverse(matches.begin() + firstMatch, matches.end());
+}
+
+} // namespace Utils
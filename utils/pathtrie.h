@@ -0,0 +1,48 @@
+#ifndef PATHTRIE_H
+#define PATHTRIE_H
+
+#include "stringutils.h"
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Utils {
+
+/// Maps directories to values by their path components, so the values of all
+/// parents of a path are found in time proportional to its depth, not to the
+/// number of directories mapped.
+///
+/// Paths are absolute. Empty components, as of "//" or a trailing '/', are
+/// ignored, "." and ".." are not resolved.
+class PathTrie
+{
+public:
+    PathTrie();
+
+    void insert(StringUtils::StringRef path, uint32_t value);
+    void clear();
+
+    struct Match
+    {
+        uint32_t value;
+        unsigned depth; ///< Components of the directory mapped to value, 0 for "/"
+    };
+
+    /// Appends the values of path and of its parents, the deepest first.
+    void find(StringUtils::StringRef path, std::vector<Match> &matches) const;
+
+private:
+    struct Node
+    {
+        std::unordered_map<std::string, uint32_t> children; ///< Index into m_nodes by component
+        std::vector<uint32_t> values;
+    };
+
+    std::vector<Node> m_nodes; // The first one is the root
+};
+
+} // namespace Utils
+
+#endif // PATHTRIE_H
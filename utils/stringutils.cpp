@@ -1,10 +1,19 @@
 #include "stringutils.h"
 
 #include <algorithm> // find_if
+#include <cctype>
+#include <cstring> // memmem
 
 namespace Utils {
 namespace StringUtils {
 
+bool contains(StringRef haystack, const std::string &needle)
+{
+    if (needle.empty())
+        return true;
+    return memmem(haystack.data(), haystack.size(), needle.data(), needle.size()) != 0;
+}
+
 std::string &ltrim(std::string &s)
 {
     s.erase(s.begin(), std::find_if(
@@ -30,5 +39,31 @@ std::string &trim(std::string &s)
     return ltrim(rtrim(s));
 }
 
+static bool isSpace(char c)
+{
+    return std::isspace(static_cast<unsigned char>(c));
+}
+
+StringRef ltrim(StringRef s)
+{
+    const char *begin = s.begin();
+    while (begin != s.end() && isSpace(*begin))
+        ++begin;
+    return StringRef(begin, s.end() - begin);
+}
+
+StringRef rtrim(StringRef s)
+{
+    const char *end = s.end();
+    while (end != s.begin() && isSpace(*(end - 1)))
+        --end;
+    return StringRef(s.begin(), end - s.begin());
+}
+
+StringRef trim(StringRef s)
+{
+    return ltrim(rtrim(s));
+}
+
 } // namespace StringUtils
 } // namespace Utils
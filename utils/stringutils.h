@@ -1,15 +1,44 @@
 #ifndef STRINGUTILS_H
 #define STRINGUTILS_H
 
+#include <cstddef>
 #include <string>
 
 namespace Utils {
 namespace StringUtils {
 
+/// Non-owning reference to a character range, e.g. into a memory mapped file.
+/// The referenced memory must outlive the StringRef.
+class StringRef
+{
+public:
+    StringRef() : m_data(0), m_size(0) {}
+    StringRef(const char *data, std::size_t size) : m_data(data), m_size(size) {}
+
+    const char *data() const { return m_data; }
+    const char *begin() const { return m_data; }
+    const char *end() const { return m_data + m_size; }
+    std::size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+
+    std::string toString() const { return std::string(m_data, m_size); }
+
+private:
+    const char *m_data;
+    std::size_t m_size;
+};
+
+/// Whether needle occurs in haystack. The empty needle occurs everywhere.
+bool contains(StringRef haystack, const std::string &needle);
+
 std::string &ltrim(std::string &s);
 std::string &rtrim(std::string &s);
 std::string &trim(std::string &s);
 
+StringRef ltrim(StringRef s);
+StringRef rtrim(StringRef s);
+StringRef trim(StringRef s);
+
 } // namespace StringUtils
 } // namespace Utils
 
@@ -0,0 +1,127 @@
+#include "substringfinder.h"
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__)))
+#  define SUBSTRINGFINDER_X86
+#  include <immintrin.h>
+#endif
+
+namespace Utils {
+
+namespace {
+
+typedef const char *(*FindFunction)(const char *needle, std::size_t needleSize,
+                                    const char *haystack, std::size_t size);
+
+const char *findGeneric(const char *needle, std::size_t needleSize,
+                        const char *haystack, std::size_t size)
+{
+    return static_cast<const char *>(memmem(haystack, size, needle, needleSize));
+}
+
+#ifdef SUBSTRINGFINDER_X86
+
+const char *findSse2(const char *needle, std::size_t needleSize,
+                     const char *haystack, std::size_t size)
+{
+    const __m128i first = _mm_set1_epi8(needle[0]);
+    const __m128i last = _mm_set1_epi8(needle[needleSize - 1]);
+    const std::size_t positionCount = size - needleSize + 1;
+
+    for (std::size_t i = 0; i < positionCount; i += 16) {
+        const __m128i blockFirst = _mm_loadu_si128(reinterpret_cast<const __m128i *>(haystack + i));
+        const __m128i blockLast = _mm_loadu_si128(
+            reinterpret_cast<const __m128i *>(haystack + i + needleSize - 1));
+        uint32_t mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(first, blockFirst),
+                                                        _mm_cmpeq_epi8(last, blockLast)));
+        if (positionCount - i < 16)
+            mask &= (uint32_t(1) << (positionCount - i)) - 1; // Positions in the padding
+
+        for (; mask; mask &= mask - 1) {
+            const char *candidate = haystack + i + __builtin_ctz(mask);
+            if (std::memcmp(candidate, needle, needleSize) == 0)
+                return candidate;
+        }
+    }
+    return 0;
+}
+
+__attribute__((target("avx2")))
+const char *findAvx2(const char *needle, std::size_t needleSize,
+                     const char *haystack, std::size_t size)
+{
+    const __m256i first = _mm256_set1_epi8(needle[0]);
+    const __m256i last = _mm256_set1_epi8(needle[needleSize - 1]);
+    const std::size_t positionCount = size - needleSize + 1;
+
+    for (std::size_t i = 0; i < positionCount; i += 32) {
+        const __m256i blockFirst = _mm256_loadu_si256(
+            reinterpret_cast<const __m256i *>(haystack + i));
+        const __m256i blockLast = _mm256_loadu_si256(
+            reinterpret_cast<const __m256i *>(haystack + i + needleSize - 1));
+        uint32_t mask = _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(first, blockFirst),
+                                                              _mm256_cmpeq_epi8(last, blockLast)));
+        if (positionCount - i < 32)
+            mask &= (uint32_t(1) << (positionCount - i)) - 1; // Positions in the padding
+
+        for (; mask; mask &= mask - 1) {
+            const char *candidate = haystack + i + __builtin_ctz(mask);
+            if (std::memcmp(candidate, needle, needleSize) == 0)
+                return candidate;
+        }
+    }
+    return 0;
+}
+
+#endif // SUBSTRINGFINDER_X86
+
+FindFunction selectFindFunction()
+{
+#ifdef SUBSTRINGFINDER_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return findAvx2;
+    return findSse2;
+#else
+    return findGeneric;
+#endif
+}
+
+FindFunction findFunction()
+{
+    static const FindFunction function = selectFindFunction();
+    return function;
+}
+
+} // anonymous
+
+SubstringFinder::SubstringFinder(const std::string &needle)
+    : m_needle(needle)
+{
+}
+
+const char *SubstringFinder::find(const char *begin, const char *end) const
+{
+    const std::size_t size = end - begin;
+    if (m_needle.empty())
+        return begin;
+    if (size < m_needle.size())
+        return 0;
+    return findFunction()(m_needle.data(), m_needle.size(), begin, size);
+}
+
+const char *SubstringFinder::instructionSet()
+{
+    const FindFunction function = findFunction();
+#ifdef SUBSTRINGFINDER_X86
+    if (function == findAvx2)
+        return "AVX2";
+    if (function == findSse2)
+        return "SSE2";
+#endif
+    return function == findGeneric ? "generic" : "unknown";
+}
+
+} // namespace Utils
@@ -0,0 +1,38 @@
+#ifndef SUBSTRINGFINDER_H
+#define SUBSTRINGFINDER_H
+
+#include <cstddef>
+#include <string>
+
+namespace Utils {
+
+/// Finds a needle in a haystack with SSE2 instructions, or with AVX2 ones if the
+/// CPU supports them (checked once at runtime).
+///
+/// 16 or 32 positions are tested at once by comparing the first and the last byte
+/// of the needle. Only positions where both match are compared completely.
+///
+/// The haystack must be padded: Up to PaddingSize bytes after its end are read,
+/// though never matched.
+class SubstringFinder
+{
+public:
+    enum { PaddingSize = 32 };
+
+    explicit SubstringFinder(const std::string &needle);
+
+    const std::string &needle() const { return m_needle; }
+
+    /// Returns the first occurrence in [begin, end) or 0.
+    const char *find(const char *begin, const char *end) const;
+
+    /// Name of the instruction set in use, e.g. for benchmarks.
+    static const char *instructionSet();
+
+private:
+    std::string m_needle;
+};
+
+} // namespace Utils
+
+#endif // SUBSTRINGFINDER_H
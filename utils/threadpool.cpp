@@ -0,0 +1,98 @@
+#include "threadpool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+namespace Utils {
+
+ThreadPool::ThreadPool(unsigned threadCount)
+    : m_isStopping(false)
+{
+    for (unsigned i = 0; i < threadCount; ++i)
+        m_threads.push_back(std::thread(&ThreadPool::work, this));
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> locker(m_mutex);
+        m_isStopping = true;
+    }
+    m_condition.notify_all();
+    for (std::thread &thread : m_threads)
+        thread.join();
+}
+
+ThreadPool &ThreadPool::globalInstance()
+{
+    static ThreadPool threadPool;
+    return threadPool;
+}
+
+unsigned ThreadPool::defaultThreadCount()
+{
+    const unsigned coreCount = std::thread::hardware_concurrency();
+    return coreCount > 1 ? coreCount - 1 : 0;
+}
+
+void ThreadPool::run(const std::function<void()> &job)
+{
+    {
+        std::lock_guard<std::mutex> locker(m_mutex);
+        m_jobs.push_back(job);
+    }
+    m_condition.notify_one();
+}
+
+void ThreadPool::parallelFor(unsigned count, const std::function<void(unsigned)> &job)
+{
+    // The indices are handed out one by one, so fast threads take more of them.
+    struct Batch
+    {
+        std::atomic<unsigned> nextIndex;
+        unsigned runningHelperCount; // Guarded by mutex
+        std::mutex mutex;
+        std::condition_variable finished;
+    };
+    const std::shared_ptr<Batch> batch(new Batch);
+    batch->nextIndex = 0;
+    batch->runningHelperCount = 0;
+
+    const unsigned helperCount = count > 1 ? std::min<unsigned>(threadCount(), count - 1) : 0;
+    batch->runningHelperCount = helperCount;
+    for (unsigned i = 0; i < helperCount; ++i) {
+        run([batch, count, &job]() {
+            for (unsigned index; (index = batch->nextIndex++) < count; )
+                job(index);
+            std::lock_guard<std::mutex> locker(batch->mutex);
+            if (--batch->runningHelperCount == 0)
+                batch->finished.notify_one();
+        });
+    }
+
+    for (unsigned index; (index = batch->nextIndex++) < count; )
+        job(index);
+
+    std::unique_lock<std::mutex> locker(batch->mutex);
+    batch->finished.wait(locker, [&batch]() { return batch->runningHelperCount == 0; });
+}
+
+void ThreadPool::work()
+{
+    for (;;) {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> locker(m_mutex);
+            m_condition.wait(locker, [this]() { return m_isStopping || ! m_jobs.empty(); });
+            // Run the jobs queued before stopping, parallelFor() waits for them.
+            if (m_jobs.empty())
+                return;
+            job = m_jobs.front();
+            m_jobs.pop_front();
+        }
+        job();
+    }
+}
+
+} // namespace Utils
@@ -0,0 +1,50 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Utils {
+
+/// A fixed set of threads running jobs.
+class ThreadPool
+{
+public:
+    /// Use threadCount threads, by default one less than the CPU has cores,
+    /// since the calling thread works in parallelFor(), too.
+    explicit ThreadPool(unsigned threadCount = defaultThreadCount());
+    /// Runs the jobs queued already, then stops the threads.
+    ~ThreadPool();
+
+    /// Shared by the whole application, started on first use.
+    static ThreadPool &globalInstance();
+    static unsigned defaultThreadCount();
+
+    unsigned threadCount() const { return m_threads.size(); }
+
+    void run(const std::function<void()> &job);
+
+    /// Calls job(0) to job(count - 1), in the pool threads and in the calling
+    /// thread, and returns once all calls are done.
+    void parallelFor(unsigned count, const std::function<void(unsigned)> &job);
+
+private:
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    void work();
+
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    std::deque<std::function<void()>> m_jobs; // Guarded by m_mutex
+    bool m_isStopping;                        // Guarded by m_mutex
+    std::vector<std::thread> m_threads;
+};
+
+} // namespace Utils
+
+#endif // THREADPOOL_H
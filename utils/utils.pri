@@ -1,9 +1,25 @@
 SOURCES += \
     $$PWD/debugutils.cpp \
+    $$PWD/directorywalker.cpp \
+    $$PWD/fileinfocache.cpp \
+    $$PWD/fileprober.cpp \
     $$PWD/fileutils.cpp \
-    $$PWD/stringutils.cpp
+    $$PWD/filewatcher.cpp \
+    $$PWD/notifier.cpp \
+    $$PWD/pathtrie.cpp \
+    $$PWD/stringutils.cpp \
+    $$PWD/substringfinder.cpp \
+    $$PWD/threadpool.cpp
 
 HEADERS += \
     $$PWD/debugutils.h \
+    $$PWD/directorywalker.h \
+    $$PWD/fileinfocache.h \
+    $$PWD/fileprober.h \
     $$PWD/fileutils.h \
-    $$PWD/stringutils.h
+    $$PWD/filewatcher.h \
+    $$PWD/notifier.h \
+    $$PWD/pathtrie.h \
+    $$PWD/stringutils.h \
+    $$PWD/substringfinder.h \
+    $$PWD/threadpool.h